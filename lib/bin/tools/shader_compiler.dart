@@ -86,6 +86,8 @@ class ShaderCompiler {
       return 'vertex';
     } else if (fileName.contains('fragment')) {
       return 'fragment';
+    } else if (fileName.contains('compute')) {
+      return 'compute';
     }
     return null;
   }
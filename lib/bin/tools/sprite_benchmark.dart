@@ -0,0 +1,67 @@
+import 'dart:math';
+
+import '../../src/engine_bindings.dart';
+import '../../src/graphics/sprite_batch.dart';
+import 'shader_compiler.dart';
+
+// Usage: dart run lib/bin/tools/sprite_benchmark.dart [quads] [frames]
+Future<void> main(List<String> args) async {
+  final quadCount = args.isNotEmpty ? int.parse(args[0]) : 50000;
+  final frameCount = args.length > 1 ? int.parse(args[1]) : 600;
+  const warmupFrames = 60;
+
+  await ShaderCompiler('shaders', '.shaders').compileAll();
+
+  final engine = GameEngine();
+  engine.initialize(1280, 720, "Sprite Benchmark");
+  engine.setClearColor(0.05, 0.05, 0.05, 1.0);
+
+  final random = Random(42);
+  final batch = SpriteBatch(capacity: quadCount);
+  final baseX = List<double>.generate(quadCount, (_) => random.nextDouble() * 1280);
+  final baseY = List<double>.generate(quadCount, (_) => random.nextDouble() * 720);
+  final colors = List<int>.generate(quadCount,
+      (_) => SpriteBatch.rgba(random.nextDouble(), random.nextDouble(), random.nextDouble(), 0.8));
+  final layers = List<int>.generate(quadCount, (_) => random.nextInt(8));
+
+  final submitWatch = Stopwatch();
+  final frameWatch = Stopwatch();
+  var frame = 0;
+  var time = 0.0;
+
+  engine.run((deltaTime) {
+    if (frame == warmupFrames) {
+      frameWatch.start();
+    }
+    time += deltaTime;
+
+    batch.clear();
+    final wobble = sin(time) * 8.0;
+    for (var i = 0; i < quadCount; i++) {
+      batch.add(baseX[i] + wobble, baseY[i], 6.0, 6.0, color: colors[i], layer: layers[i]);
+    }
+
+    if (frame >= warmupFrames) submitWatch.start();
+    engine.setSprites(batch);
+    submitWatch.stop();
+
+    frame++;
+    if (frame == warmupFrames + frameCount) {
+      frameWatch.stop();
+      engine.requestClose();
+    }
+  });
+
+  final measured = frame - warmupFrames;
+  if (measured > 0) {
+    final frameMs = frameWatch.elapsedMicroseconds / 1000.0 / measured;
+    final submitMs = submitWatch.elapsedMicroseconds / 1000.0 / measured;
+    final quadsPerSecond = quadCount * measured / (frameWatch.elapsedMicroseconds / 1e6);
+    print('quads/frame: $quadCount, frames: $measured');
+    print('frame: ${frameMs.toStringAsFixed(3)} ms, sort+upload: ${submitMs.toStringAsFixed(3)} ms');
+    print('throughput: ${(quadsPerSecond / 1e6).toStringAsFixed(2)} M quads/s');
+  }
+
+  batch.dispose();
+  engine.dispose();
+}
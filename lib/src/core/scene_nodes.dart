@@ -0,0 +1,83 @@
+import 'dart:ffi';
+
+import 'package:df_engine/src/structs/engine.dart';
+
+const int nodeNone = 0xFFFFFFFF;
+
+// Transforms live in the native node store; Dart only keeps integer handles.
+class SceneNodes {
+  final DynamicLibrary _lib;
+  final Pointer<Engine> _engine;
+
+  SceneNodes(this._lib, this._engine);
+
+  late final _createFunc = _lib.lookupFunction<
+      Uint32 Function(Pointer<Engine>, Uint32),
+      int Function(Pointer<Engine>, int)>('engine_node_create', isLeaf: true);
+  late final _destroyFunc = _lib.lookupFunction<
+      Void Function(Pointer<Engine>, Uint32),
+      void Function(Pointer<Engine>, int)>('engine_node_destroy', isLeaf: true);
+  late final _setParentFunc = _lib.lookupFunction<
+      Int32 Function(Pointer<Engine>, Uint32, Uint32),
+      int Function(Pointer<Engine>, int, int)>('engine_node_set_parent', isLeaf: true);
+  late final _setTranslationFunc = _lib.lookupFunction<
+      Void Function(Pointer<Engine>, Uint32, Float, Float, Float),
+      void Function(Pointer<Engine>, int, double, double, double)>(
+      'engine_node_set_translation', isLeaf: true);
+  late final _setRotationFunc = _lib.lookupFunction<
+      Void Function(Pointer<Engine>, Uint32, Float, Float, Float, Float),
+      void Function(Pointer<Engine>, int, double, double, double, double)>(
+      'engine_node_set_rotation', isLeaf: true);
+  late final _setScaleFunc = _lib.lookupFunction<
+      Void Function(Pointer<Engine>, Uint32, Float, Float, Float),
+      void Function(Pointer<Engine>, int, double, double, double)>(
+      'engine_node_set_scale', isLeaf: true);
+  late final _setTranslationsFunc = _lib.lookupFunction<
+      Void Function(Pointer<Engine>, Pointer<Uint32>, Pointer<Float>, Uint32),
+      void Function(Pointer<Engine>, Pointer<Uint32>, Pointer<Float>, int)>(
+      'engine_nodes_set_translations', isLeaf: true);
+  late final _updateFunc = _lib.lookupFunction<
+      Void Function(Pointer<Engine>),
+      void Function(Pointer<Engine>)>('engine_nodes_update', isLeaf: true);
+  late final _worldMatrixFunc = _lib.lookupFunction<
+      Int32 Function(Pointer<Engine>, Uint32, Pointer<Float>),
+      int Function(Pointer<Engine>, int, Pointer<Float>)>('engine_node_world_matrix', isLeaf: true);
+  late final _countFunc = _lib.lookupFunction<
+      Uint32 Function(Pointer<Engine>),
+      int Function(Pointer<Engine>)>('engine_node_count', isLeaf: true);
+
+  int create({int parent = nodeNone}) {
+    final node = _createFunc(_engine, parent);
+    if (node == nodeNone) {
+      throw StateError('Failed to create scene node');
+    }
+    return node;
+  }
+
+  void destroy(int node) => _destroyFunc(_engine, node);
+
+  bool setParent(int node, int parent) => _setParentFunc(_engine, node, parent) != 0;
+
+  void setTranslation(int node, double x, double y, double z) {
+    _setTranslationFunc(_engine, node, x, y, z);
+  }
+
+  void setRotation(int node, double x, double y, double z, double w) {
+    _setRotationFunc(_engine, node, x, y, z, w);
+  }
+
+  void setScale(int node, double x, double y, double z) {
+    _setScaleFunc(_engine, node, x, y, z);
+  }
+
+  void setTranslations(Pointer<Uint32> nodes, Pointer<Float> translations, int count) {
+    _setTranslationsFunc(_engine, nodes, translations, count);
+  }
+
+  // The engine updates once per frame after the frame callback; call this to read fresh matrices earlier.
+  void update() => _updateFunc(_engine);
+
+  bool worldMatrix(int node, Pointer<Float> out) => _worldMatrixFunc(_engine, node, out) != 0;
+
+  int get length => _countFunc(_engine);
+}
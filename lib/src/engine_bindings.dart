@@ -1,10 +1,14 @@
 import 'dart:ffi';
 import 'dart:io' show Platform;
 import 'package:df_engine/src/structs/engine.dart';
+import 'package:df_engine/src/structs/sprite_instance.dart';
 import 'package:df_engine/src/structs/vertex_3d.dart';
 import 'package:ffi/ffi.dart';
 
+import 'core/scene_nodes.dart';
 import 'graphics/camera_3d.dart';
+import 'graphics/sprite_batch.dart';
+import 'math/native_math.dart';
 
 typedef FrameCallbackC = Void Function(Float deltaTime);
 typedef FrameCallbackDart = void Function(double deltaTime);
@@ -12,6 +16,9 @@ typedef FrameCallbackDart = void Function(double deltaTime);
 class GameEngine {
   late DynamicLibrary _lib;
   late Pointer<Engine> _engine;
+  late final NativeMath math = NativeMath(_lib);
+  late final SceneNodes nodes = SceneNodes(_lib, _engine);
+  final Pointer<Float> _viewMatrix = malloc<Float>(16);
 
   late final _createFunc = _lib.lookupFunction<
       Pointer<Engine> Function(Int32, Int32, Pointer<Utf8>),
@@ -30,7 +37,94 @@ class GameEngine {
       void Function(Pointer<Engine>, Pointer<Vertex3D>, int)>('engine_set_vertices');
   late final _setViewMatrixFunc = _lib.lookupFunction<
       Void Function(Pointer<Engine>, Pointer<Float>),
-      void Function(Pointer<Engine>, Pointer<Float>)>('engine_set_view_matrix');
+      void Function(Pointer<Engine>, Pointer<Float>)>('engine_set_view_matrix', isLeaf: true);
+  late final _texturePackOpenFunc = _lib.lookupFunction<
+      Int32 Function(Pointer<Engine>, Pointer<Utf8>, Pointer<Uint32>),
+      int Function(Pointer<Engine>, Pointer<Utf8>, Pointer<Uint32>)>('engine_texture_pack_open');
+  late final _textureTouchFunc = _lib.lookupFunction<
+      Void Function(Pointer<Engine>, Uint32),
+      void Function(Pointer<Engine>, int)>('engine_texture_touch', isLeaf: true);
+  late final _textureSetBudgetFunc = _lib.lookupFunction<
+      Void Function(Pointer<Engine>, Uint64),
+      void Function(Pointer<Engine>, int)>('engine_texture_set_budget');
+  late final _textureResidentBytesFunc = _lib.lookupFunction<
+      Uint64 Function(Pointer<Engine>),
+      int Function(Pointer<Engine>)>('engine_texture_resident_bytes');
+  late final _setSpritesFunc = _lib.lookupFunction<
+      Void Function(Pointer<Engine>, Pointer<SpriteInstance>, Uint32),
+      void Function(Pointer<Engine>, Pointer<SpriteInstance>, int)>('engine_set_sprites');
+  late final _requestCloseFunc = _lib.lookupFunction<
+      Void Function(Pointer<Engine>),
+      void Function(Pointer<Engine>)>('engine_request_close');
+  late final _meshCreateFunc = _lib.lookupFunction<
+      Int32 Function(Pointer<Engine>, Pointer<Vertex3D>, Uint32, Pointer<Uint32>, Uint32, Float, Uint32),
+      int Function(Pointer<Engine>, Pointer<Vertex3D>, int, Pointer<Uint32>, int, double, int)>('engine_mesh_create_layout');
+  late final _meshPackOpenFunc = _lib.lookupFunction<
+      Int32 Function(Pointer<Engine>, Pointer<Utf8>, Pointer<Uint32>),
+      int Function(Pointer<Engine>, Pointer<Utf8>, Pointer<Uint32>)>('engine_mesh_pack_open');
+  late final _meshLodCountFunc = _lib.lookupFunction<
+      Uint32 Function(Pointer<Engine>, Int32),
+      int Function(Pointer<Engine>, int)>('engine_mesh_lod_count', isLeaf: true);
+  late final _meshInstanceCreateFunc = _lib.lookupFunction<
+      Int32 Function(Pointer<Engine>, Int32, Uint32),
+      int Function(Pointer<Engine>, int, int)>('engine_mesh_instance_create', isLeaf: true);
+  late final _meshInstanceDestroyFunc = _lib.lookupFunction<
+      Void Function(Pointer<Engine>, Int32),
+      void Function(Pointer<Engine>, int)>('engine_mesh_instance_destroy', isLeaf: true);
+  late final _setLodThresholdFunc = _lib.lookupFunction<
+      Void Function(Pointer<Engine>, Float),
+      void Function(Pointer<Engine>, double)>('engine_set_lod_threshold', isLeaf: true);
+  late final _meshDrawnTrianglesFunc = _lib.lookupFunction<
+      Uint64 Function(Pointer<Engine>),
+      int Function(Pointer<Engine>)>('engine_mesh_drawn_triangles', isLeaf: true);
+  late final _setOcclusionCullingFunc = _lib.lookupFunction<
+      Void Function(Pointer<Engine>, Int32),
+      void Function(Pointer<Engine>, int)>('engine_set_occlusion_culling');
+  late final _occlusionStatsFunc = _lib.lookupFunction<
+      Void Function(Pointer<Engine>, Pointer<Uint32>),
+      void Function(Pointer<Engine>, Pointer<Uint32>)>('engine_occlusion_stats', isLeaf: true);
+  late final _renderGraphStatsFunc = _lib.lookupFunction<
+      Void Function(Pointer<Engine>, Pointer<Uint64>),
+      void Function(Pointer<Engine>, Pointer<Uint64>)>('engine_render_graph_stats', isLeaf: true);
+  late final _captureBeginFunc = _lib.lookupFunction<
+      Int32 Function(Pointer<Engine>, Pointer<Utf8>),
+      int Function(Pointer<Engine>, Pointer<Utf8>)>('engine_capture_begin');
+  late final _captureEndFunc = _lib.lookupFunction<
+      Int64 Function(Pointer<Engine>),
+      int Function(Pointer<Engine>)>('engine_capture_end');
+  late final _initStageFunc = _lib.lookupFunction<
+      Pointer<Utf8> Function(Pointer<Engine>, Uint32, Pointer<Uint64>),
+      Pointer<Utf8> Function(Pointer<Engine>, int, Pointer<Uint64>)>('engine_init_stage', isLeaf: true);
+  late final _timeToFirstFrameFunc = _lib.lookupFunction<
+      Uint64 Function(Pointer<Engine>),
+      int Function(Pointer<Engine>)>('engine_time_to_first_frame', isLeaf: true);
+  late final _setDynamicResolutionFunc = _lib.lookupFunction<
+      Void Function(Pointer<Engine>, Float, Float),
+      void Function(Pointer<Engine>, double, double)>('engine_set_dynamic_resolution');
+  late final _renderScaleFunc = _lib.lookupFunction<
+      Float Function(Pointer<Engine>),
+      double Function(Pointer<Engine>)>('engine_render_scale', isLeaf: true);
+  late final _gpuFrameTimeFunc = _lib.lookupFunction<
+      Float Function(Pointer<Engine>),
+      double Function(Pointer<Engine>)>('engine_gpu_frame_time', isLeaf: true);
+  late final _traceBeginFunc = _lib.lookupFunction<
+      Int32 Function(Pointer<Utf8>),
+      int Function(Pointer<Utf8>)>('engine_trace_begin');
+  late final _traceEndFunc = _lib.lookupFunction<
+      Int64 Function(),
+      int Function()>('engine_trace_end');
+  late final _windowCreateFunc = _lib.lookupFunction<
+      Int32 Function(Pointer<Engine>, Int32, Int32, Pointer<Utf8>),
+      int Function(Pointer<Engine>, int, int, Pointer<Utf8>)>('engine_window_create');
+  late final _windowDestroyFunc = _lib.lookupFunction<
+      Void Function(Pointer<Engine>, Int32),
+      void Function(Pointer<Engine>, int)>('engine_window_destroy');
+  late final _windowIsOpenFunc = _lib.lookupFunction<
+      Int32 Function(Pointer<Engine>, Int32),
+      int Function(Pointer<Engine>, int)>('engine_window_is_open', isLeaf: true);
+  late final _windowSetViewMatrixFunc = _lib.lookupFunction<
+      Void Function(Pointer<Engine>, Int32, Pointer<Float>),
+      void Function(Pointer<Engine>, int, Pointer<Float>)>('engine_window_set_view_matrix', isLeaf: true);
 
   GameEngine() {
     _lib = DynamicLibrary.open(Platform.isWindows
@@ -39,6 +133,18 @@ class GameEngine {
     print("Dynamic library loaded");
   }
 
+  // Records a Chrome trace (open in ui.perfetto.dev). May be started before initialize to
+  // capture engine creation.
+  bool traceBegin(String path) {
+    final pathPtr = path.toNativeUtf8();
+    final started = _traceBeginFunc(pathPtr) != 0;
+    malloc.free(pathPtr);
+    return started;
+  }
+
+  // Writes the trace file and returns the number of events, or -1 if no trace was running.
+  int traceEnd() => _traceEndFunc();
+
   void initialize(int width, int height, String title) {
     print("Calling engine.initialize with width=$width, height=$height, title=$title");
     final titlePtr = title.toNativeUtf8();
@@ -64,13 +170,177 @@ class GameEngine {
     malloc.free(vertexPtr);
   }
 
+  void setSprites(SpriteBatch batch) {
+    _setSpritesFunc(_engine, batch.instances, batch.length);
+  }
+
+  void requestClose() {
+    _requestCloseFunc(_engine);
+  }
+
   void setViewMatrix(Camera3D camera) {
-    final matrixPtr = malloc<Float>(16);
-    camera.update(matrixPtr);
-    _setViewMatrixFunc(_engine, matrixPtr);
-    malloc.free(matrixPtr);
+    camera.update(math, _viewMatrix);
+    _setViewMatrixFunc(_engine, _viewMatrix);
   }
 
+  // Opens another window showing the same scene from its own camera. It is rendered by run()
+  // together with the main window and closes itself when the user closes it.
+  int createWindow(int width, int height, String title) {
+    final titlePtr = title.toNativeUtf8();
+    final window = _windowCreateFunc(_engine, width, height, titlePtr);
+    malloc.free(titlePtr);
+    if (window < 0) {
+      throw Exception("Failed to create window: $title");
+    }
+    return window;
+  }
+
+  void destroyWindow(int window) {
+    _windowDestroyFunc(_engine, window);
+  }
+
+  bool isWindowOpen(int window) => _windowIsOpenFunc(_engine, window) != 0;
+
+  void setWindowViewMatrix(int window, Camera3D camera) {
+    camera.update(math, _viewMatrix);
+    _windowSetViewMatrixFunc(_engine, window, _viewMatrix);
+  }
+
+  List<int> openTexturePack(String path) {
+    final pathPtr = path.toNativeUtf8();
+    final countPtr = malloc<Uint32>();
+    final first = _texturePackOpenFunc(_engine, pathPtr, countPtr);
+    final count = countPtr.value;
+    malloc.free(pathPtr);
+    malloc.free(countPtr);
+    if (first < 0) {
+      throw Exception("Failed to open texture pack: $path");
+    }
+    return List<int>.generate(count, (i) => first + i);
+  }
+
+  // lodMaxError is relative to the mesh bounding radius; 0 keeps only the full-detail level.
+  int createMesh(List<Vertex3D> vertices, List<int> indices,
+      {double lodMaxError = 0.01, VertexLayout layout = VertexLayout.float32}) {
+    final vertexPtr = malloc<Vertex3D>(vertices.length);
+    final indexPtr = malloc<Uint32>(indices.length);
+    for (int i = 0; i < vertices.length; i++) {
+      vertexPtr[i] = vertices[i];
+    }
+    for (int i = 0; i < indices.length; i++) {
+      indexPtr[i] = indices[i];
+    }
+    final mesh =
+        _meshCreateFunc(_engine, vertexPtr, vertices.length, indexPtr, indices.length, lodMaxError, layout.index);
+    malloc.free(vertexPtr);
+    malloc.free(indexPtr);
+    if (mesh < 0) {
+      throw Exception("Failed to create mesh");
+    }
+    return mesh;
+  }
+
+  List<int> openMeshPack(String path) {
+    final pathPtr = path.toNativeUtf8();
+    final countPtr = malloc<Uint32>();
+    final first = _meshPackOpenFunc(_engine, pathPtr, countPtr);
+    final count = countPtr.value;
+    malloc.free(pathPtr);
+    malloc.free(countPtr);
+    if (first < 0) {
+      throw Exception("Failed to open mesh pack: $path");
+    }
+    return List<int>.generate(count, (i) => first + i);
+  }
+
+  int meshLodCount(int mesh) => _meshLodCountFunc(_engine, mesh);
+
+  int createMeshInstance(int mesh, int node) {
+    final instance = _meshInstanceCreateFunc(_engine, mesh, node);
+    if (instance < 0) {
+      throw Exception("Failed to create instance of mesh $mesh");
+    }
+    return instance;
+  }
+
+  void destroyMeshInstance(int instance) {
+    _meshInstanceDestroyFunc(_engine, instance);
+  }
+
+  set lodThreshold(double pixels) => _setLodThresholdFunc(_engine, pixels);
+
+  int get drawnTriangles => _meshDrawnTrianglesFunc(_engine);
+
+  set occlusionCulling(bool enabled) => _setOcclusionCullingFunc(_engine, enabled ? 1 : 0);
+
+  // [first pass drawn, second pass drawn, occluded] for the last rendered frame.
+  List<int> get occlusionStats {
+    final statsPtr = malloc<Uint32>(3);
+    _occlusionStatsFunc(_engine, statsPtr);
+    final stats = statsPtr.asTypedList(3).toList();
+    malloc.free(statsPtr);
+    return stats;
+  }
+
+  // [passes executed, passes culled, barrier batches, transient bytes, allocated bytes,
+  // lazily allocated bytes] for the last rendered frame.
+  List<int> get renderGraphStats {
+    final statsPtr = malloc<Uint64>(6);
+    _renderGraphStatsFunc(_engine, statsPtr);
+    final stats = statsPtr.asTypedList(6).toList();
+    malloc.free(statsPtr);
+    return stats;
+  }
+
+  // Records every API call and frame boundary for the replay tool. Must be called right after
+  // initialize, before any content is created; setting DF_ENGINE_CAPTURE does the same.
+  bool captureBegin(String path) {
+    final pathPtr = path.toNativeUtf8();
+    final started = _captureBeginFunc(_engine, pathPtr) != 0;
+    malloc.free(pathPtr);
+    return started;
+  }
+
+  // Closes the capture and returns the number of frames recorded, or -1.
+  int captureEnd() => _captureEndFunc(_engine);
+
+  // Engine creation stages and resources created on first use, in nanoseconds since initialize
+  // was called; thread 0 is the calling thread, the others are init workers.
+  List<({String name, int start, int duration, int thread})> get initStages {
+    final stages = <({String name, int start, int duration, int thread})>[];
+    final timingsPtr = malloc<Uint64>(3);
+    for (var i = 0;; i++) {
+      final name = _initStageFunc(_engine, i, timingsPtr);
+      if (name == nullptr) break;
+      final timings = timingsPtr.asTypedList(3);
+      stages.add((name: name.toDartString(), start: timings[0], duration: timings[1], thread: timings[2]));
+    }
+    malloc.free(timingsPtr);
+    return stages;
+  }
+
+  // Nanoseconds from initialize to the first presented frame, 0 until it has been presented.
+  int get timeToFirstFrame => _timeToFirstFrameFunc(_engine);
+
+  // Renders the scene at a resolution adjusted to keep GPU frame time near targetMilliseconds,
+  // never below minScale of the window size; sprites stay sharp. A target of 0 turns it off.
+  void setDynamicResolution(double targetMilliseconds, {double minScale = 0.5}) {
+    _setDynamicResolutionFunc(_engine, targetMilliseconds, minScale);
+  }
+
+  double get renderScale => _renderScaleFunc(_engine);
+
+  // Milliseconds, measured only while dynamic resolution is on.
+  double get gpuFrameTime => _gpuFrameTimeFunc(_engine);
+
+  void touchTexture(int texture) {
+    _textureTouchFunc(_engine, texture);
+  }
+
+  set textureBudget(int bytes) => _textureSetBudgetFunc(_engine, bytes);
+
+  int get textureResidentBytes => _textureResidentBytesFunc(_engine);
+
   void run(void Function(double deltaTime) callback) {
     final nativeCallback = NativeCallable<FrameCallbackC>.isolateLocal(callback);
     _runFunc(_engine, nativeCallback.nativeFunction);
@@ -79,5 +349,6 @@ class GameEngine {
 
   void dispose() {
     _destroyFunc(_engine);
+    malloc.free(_viewMatrix);
   }
 }
\ No newline at end of file
@@ -1,13 +1,22 @@
 import 'dart:ffi';
 import 'dart:math';
 
-class Camera3D {
+import 'package:ffi/ffi.dart';
+
+import '../math/native_math.dart';
+
+class Camera3D implements Finalizable {
+  static final _finalizer = NativeFinalizer(malloc.nativeFree);
+
   double x, y, z;
   double yaw, pitch;
   double fov;
   double aspect;
   double near, far;
 
+  // eye, target, up (4 floats each), then view, projection and view-projection matrices.
+  final Pointer<Float> _scratch = malloc<Float>(12 + 48);
+
   Camera3D({
     this.x = 0.0,
     this.y = 0.0,
@@ -18,69 +27,43 @@ class Camera3D {
     this.aspect = 800.0 / 600.0,
     this.near = 0.1,
     this.far = 100.0,
-  });
-
-  List<double> _getProjectionMatrix() {
-    final f = 1.0 / tan(fov * pi / 360.0);
-    return [
-      f / aspect, 0.0, 0.0, 0.0,
-      0.0, f, 0.0, 0.0,
-      0.0, 0.0, (far + near) / (near - far), -1.0,
-      0.0, 0.0, (2.0 * far * near) / (near - far), 0.0,
-    ];
+  }) {
+    _finalizer.attach(this, _scratch.cast(), detach: this);
   }
 
-  List<double> _getViewMatrix() {
+  Pointer<Float> get _eye => _scratch;
+  Pointer<Float> get _target => _scratch + 4;
+  Pointer<Float> get _up => _scratch + 8;
+  Pointer<Float> get _view => _scratch + 12;
+  Pointer<Float> get _projection => _scratch + 28;
+  Pointer<Float> get _viewProjection => _scratch + 44;
+
+  // Writes projection * view into [matrixPtr] (16 floats, column-major).
+  // Yaw 0 and pitch 0 look down -Z.
+  void update(NativeMath math, Pointer<Float> matrixPtr) {
     final cosPitch = cos(pitch * pi / 180.0);
     final sinPitch = sin(pitch * pi / 180.0);
     final cosYaw = cos(yaw * pi / 180.0);
     final sinYaw = sin(yaw * pi / 180.0);
 
-    final forwardX = cosPitch * sinYaw;
-    final forwardY = sinPitch;
-    final forwardZ = cosPitch * cosYaw;
-
-    final rightX = cosYaw;
-    final rightY = 0.0;
-    final rightZ = -sinYaw;
-
-    final upX = -sinPitch * sinYaw;
-    final upY = cosPitch;
-    final upZ = -sinPitch * cosYaw;
-
-    return [
-      rightX, upX, -forwardX, 0.0,
-      rightY, upY, -forwardY, 0.0,
-      rightZ, upZ, -forwardZ, 0.0,
-      -(rightX * x + rightY * y + rightZ * z),
-      -(upX * x + upY * y + upZ * z),
-      -(forwardX * x + forwardY * y + forwardZ * z),
-      1.0,
-    ];
-  }
-
-  List<double> getViewProjMatrix() {
-    final proj = _getProjectionMatrix();
-    final view = _getViewMatrix();
-    return _multiplyMatrices(proj, view);
-  }
+    _eye[0] = x;
+    _eye[1] = y;
+    _eye[2] = z;
+    _target[0] = x + cosPitch * sinYaw;
+    _target[1] = y + sinPitch;
+    _target[2] = z - cosPitch * cosYaw;
+    _up[0] = 0.0;
+    _up[1] = 1.0;
+    _up[2] = 0.0;
 
-  void update(Pointer<Float> matrixPtr) {
-    final matrix = getViewProjMatrix();
-    for (int i = 0; i < 16; i++) {
-      matrixPtr[i] = matrix[i];
-    }
+    math.lookAt(_view, _eye, _target, _up);
+    math.perspective(_projection, fov * pi / 180.0, aspect, near, far);
+    math.multiply(matrixPtr, _projection, _view);
   }
 
-  List<double> _multiplyMatrices(List<double> a, List<double> b) {
-    final result = List<double>.filled(16, 0.0);
-    for (int i = 0; i < 4; i++) {
-      for (int j = 0; j < 4; j++) {
-        for (int k = 0; k < 4; k++) {
-          result[i * 4 + j] += a[i * 4 + k] * b[k * 4 + j];
-        }
-      }
-    }
-    return result;
+  // Six normalized planes (24 floats) of the current view frustum.
+  void frustumPlanes(NativeMath math, Pointer<Float> planesPtr) {
+    update(math, _viewProjection);
+    math.frustumPlanes(planesPtr, _viewProjection);
   }
-}
\ No newline at end of file
+}
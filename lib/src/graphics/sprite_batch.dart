@@ -0,0 +1,58 @@
+import 'dart:ffi';
+
+import 'package:ffi/ffi.dart';
+
+import '../structs/sprite_instance.dart';
+
+const int spriteNoTexture = 0xFFFF;
+
+class SpriteBatch {
+  final int capacity;
+  final Pointer<SpriteInstance> instances;
+  int length = 0;
+
+  SpriteBatch({this.capacity = 131072})
+      : instances = malloc<SpriteInstance>(capacity);
+
+  void clear() {
+    length = 0;
+  }
+
+  void add(double x, double y, double width, double height,
+      {int color = 0xFFFFFFFF,
+      int layer = 0,
+      int texture = spriteNoTexture,
+      double u0 = 0.0,
+      double v0 = 0.0,
+      double u1 = 1.0,
+      double v1 = 1.0}) {
+    if (length == capacity) {
+      throw StateError('SpriteBatch is full ($capacity sprites)');
+    }
+    final sprite = (instances + length).ref;
+    sprite.x = x;
+    sprite.y = y;
+    sprite.width = width;
+    sprite.height = height;
+    sprite.u0 = u0;
+    sprite.v0 = v0;
+    sprite.u1 = u1;
+    sprite.v1 = v1;
+    sprite.color = color;
+    sprite.layer = layer;
+    sprite.texture = texture;
+    length++;
+  }
+
+  static int rgba(double r, double g, double b, [double a = 1.0]) {
+    int channel(double v) => (v.clamp(0.0, 1.0) * 255.0).round();
+    return channel(r) |
+        (channel(g) << 8) |
+        (channel(b) << 16) |
+        (channel(a) << 24);
+  }
+
+  void dispose() {
+    malloc.free(instances);
+  }
+}
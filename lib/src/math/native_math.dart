@@ -0,0 +1,46 @@
+import 'dart:ffi';
+
+typedef _Mat4BinaryC = Void Function(Pointer<Float>, Pointer<Float>, Pointer<Float>);
+typedef _Mat4BinaryDart = void Function(Pointer<Float>, Pointer<Float>, Pointer<Float>);
+
+class NativeMath {
+  final DynamicLibrary _lib;
+
+  NativeMath(this._lib);
+
+  late final identity = _lib.lookupFunction<
+      Void Function(Pointer<Float>),
+      void Function(Pointer<Float>)>('engine_mat4_identity', isLeaf: true);
+  late final multiply = _lib.lookupFunction<_Mat4BinaryC, _Mat4BinaryDart>(
+      'engine_mat4_multiply', isLeaf: true);
+  late final inverse = _lib.lookupFunction<
+      Int32 Function(Pointer<Float>, Pointer<Float>),
+      int Function(Pointer<Float>, Pointer<Float>)>('engine_mat4_inverse', isLeaf: true);
+  late final lookAt = _lib.lookupFunction<
+      Void Function(Pointer<Float>, Pointer<Float>, Pointer<Float>, Pointer<Float>),
+      void Function(Pointer<Float>, Pointer<Float>, Pointer<Float>, Pointer<Float>)>(
+      'engine_mat4_look_at', isLeaf: true);
+  late final perspective = _lib.lookupFunction<
+      Void Function(Pointer<Float>, Float, Float, Float, Float),
+      void Function(Pointer<Float>, double, double, double, double)>(
+      'engine_mat4_perspective', isLeaf: true);
+  late final ortho = _lib.lookupFunction<
+      Void Function(Pointer<Float>, Float, Float, Float, Float, Float, Float),
+      void Function(Pointer<Float>, double, double, double, double, double, double)>(
+      'engine_mat4_ortho', isLeaf: true);
+  late final fromTrs = _lib.lookupFunction<
+      Void Function(Pointer<Float>, Pointer<Float>, Pointer<Float>, Pointer<Float>),
+      void Function(Pointer<Float>, Pointer<Float>, Pointer<Float>, Pointer<Float>)>(
+      'engine_mat4_from_trs', isLeaf: true);
+  late final frustumPlanes = _lib.lookupFunction<
+      Void Function(Pointer<Float>, Pointer<Float>),
+      void Function(Pointer<Float>, Pointer<Float>)>('engine_frustum_planes', isLeaf: true);
+  late final transformPoints = _lib.lookupFunction<
+      Void Function(Pointer<Float>, Pointer<Float>, Pointer<Float>, Uint32),
+      void Function(Pointer<Float>, Pointer<Float>, Pointer<Float>, int)>(
+      'engine_transform_points', isLeaf: true);
+  late final multiplyBatch = _lib.lookupFunction<
+      Void Function(Pointer<Float>, Pointer<Float>, Pointer<Float>, Uint32),
+      void Function(Pointer<Float>, Pointer<Float>, Pointer<Float>, int)>(
+      'engine_mat4_multiply_batch', isLeaf: true);
+}
@@ -0,0 +1,26 @@
+import 'dart:ffi';
+
+final class SpriteInstance extends Struct {
+  @Float()
+  external double x;
+  @Float()
+  external double y;
+  @Float()
+  external double width;
+  @Float()
+  external double height;
+  @Float()
+  external double u0;
+  @Float()
+  external double v0;
+  @Float()
+  external double u1;
+  @Float()
+  external double v1;
+  @Uint32()
+  external int color;
+  @Uint16()
+  external int layer;
+  @Uint16()
+  external int texture;
+}
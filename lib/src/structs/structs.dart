@@ -1,2 +1,3 @@
 export 'engine.dart';
-export 'vk_extend_2d.dart';
\ No newline at end of file
+export 'sprite_instance.dart';
+export 'vk_extend_2d.dart';
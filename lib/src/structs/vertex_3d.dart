@@ -26,4 +26,7 @@ final class Vertex3D extends Struct {
     vertex.b = b;
     return vertex;
   }
-}
\ No newline at end of file
+}
+// How a mesh keeps its vertices on the GPU; indices match MESH_LAYOUT_* in the engine. The
+// quantized layouts take 12 bytes per vertex instead of 24, with colours in 8 bits per channel.
+enum VertexLayout { float32, half, snorm16 }
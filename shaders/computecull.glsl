@@ -0,0 +1,80 @@
+#version 450
+layout(local_size_x = 64) in;
+
+struct Candidate {
+    vec4 sphere;
+    uvec4 command;
+};
+
+struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(binding = 0) uniform sampler2D hiz;
+layout(std430, binding = 1) readonly buffer Candidates { Candidate candidates[]; };
+layout(std430, binding = 2) readonly buffer Matrices { mat4 matrices[]; };
+layout(std430, binding = 3) buffer Commands { DrawCommand commands[]; };
+layout(std430, binding = 4) writeonly buffer Visible { mat4 visible[]; };
+layout(std430, binding = 5) buffer Pending { uint pending[]; };
+layout(std430, binding = 6) buffer Stats { uint stats[]; };
+
+layout(push_constant) uniform PushConstants {
+    mat4 viewProj;
+    ivec2 hizSize;
+    uint candidateCount;
+    uint phase;
+    uint hizLevels;
+    uint commandOffset;
+} pc;
+
+// Projects the sphere's bounding box and compares its nearest depth with the farthest depth of
+// the pyramid texels under it. The level is chosen so the rectangle spans at most 2x2 texels.
+bool occluded(vec4 sphere) {
+    if (pc.hizLevels == 0) return false;
+
+    vec2 low = vec2(1.0);
+    vec2 high = vec2(0.0);
+    float nearest = 1.0;
+    for (int i = 0; i < 8; i++) {
+        vec3 corner = vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = pc.viewProj * vec4(sphere.xyz + corner * sphere.w, 1.0);
+        if (clip.w <= 1e-5) return false;
+        vec3 ndc = clip.xyz / clip.w;
+        low = min(low, ndc.xy * 0.5 + 0.5);
+        high = max(high, ndc.xy * 0.5 + 0.5);
+        nearest = min(nearest, ndc.z);
+    }
+    low = clamp(low, 0.0, 1.0);
+    high = clamp(high, 0.0, 1.0);
+
+    vec2 size = (high - low) * vec2(pc.hizSize);
+    int level = clamp(int(ceil(log2(max(max(size.x, size.y), 1.0)))), 0, int(pc.hizLevels) - 1);
+    ivec2 levelSize = textureSize(hiz, level);
+    ivec2 a = clamp(ivec2(low * vec2(levelSize)), ivec2(0), levelSize - 1);
+    ivec2 b = clamp(ivec2(high * vec2(levelSize)), ivec2(0), levelSize - 1);
+    float farthest = max(max(texelFetch(hiz, a, level).r, texelFetch(hiz, ivec2(b.x, a.y), level).r),
+                         max(texelFetch(hiz, ivec2(a.x, b.y), level).r, texelFetch(hiz, b, level).r));
+    return nearest > farthest;
+}
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= pc.candidateCount) return;
+    if (pc.phase == 1 && pending[i] == 0) return;
+
+    bool hidden = occluded(candidates[i].sphere);
+    if (pc.phase == 0) pending[i] = hidden ? 1 : 0;
+    if (hidden) {
+        if (pc.phase == 1) atomicAdd(stats[2], 1);
+        return;
+    }
+
+    uint command = pc.commandOffset + candidates[i].command.x;
+    uint slot = atomicAdd(commands[command].instanceCount, 1);
+    visible[commands[command].firstInstance + slot] = matrices[i];
+    atomicAdd(stats[pc.phase], 1);
+}
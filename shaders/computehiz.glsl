@@ -0,0 +1,27 @@
+#version 450
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = 0) uniform sampler2D source;
+layout(binding = 1, r32f) uniform writeonly image2D destination;
+
+layout(push_constant) uniform PushConstants {
+    ivec2 sourceSize;
+    ivec2 destinationSize;
+} pc;
+
+// Each texel keeps the farthest depth it covers, so the pyramid never reports a surface closer
+// than the scene. Level 0 is smaller than the depth buffer, so its footprints are up to 3 wide.
+void main() {
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(p, pc.destinationSize))) return;
+
+    ivec2 begin = p * pc.sourceSize / pc.destinationSize;
+    ivec2 end = min(((p + 1) * pc.sourceSize + pc.destinationSize - 1) / pc.destinationSize, pc.sourceSize);
+    float depth = 0.0;
+    for (int y = begin.y; y < end.y; y++) {
+        for (int x = begin.x; x < end.x; x++) {
+            depth = max(depth, texelFetch(source, ivec2(x, y), 0).r);
+        }
+    }
+    imageStore(destination, p, vec4(depth));
+}
@@ -1,7 +1,22 @@
 #version 450
-layout(location = 0) in vec3 fragColor;
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in vec2 fragUV;
 layout(location = 0) out vec4 outColor;
 
+layout(binding = 1) uniform sampler textureSampler;
+layout(binding = 2) uniform texture2D textures[256];
+
+layout(push_constant) uniform SpritePushConstants {
+    vec2 scale;
+    vec2 offset;
+    uint textureIndex;
+    uint textured;
+} pc;
+
 void main() {
-    outColor = vec4(fragColor, 1.0);
-}
\ No newline at end of file
+    vec4 texel = vec4(1.0);
+    if (pc.textured != 0u) {
+        texel = texture(sampler2D(textures[pc.textureIndex], textureSampler), fragUV);
+    }
+    outColor = fragColor * texel;
+}
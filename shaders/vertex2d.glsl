@@ -1,9 +1,24 @@
 #version 450
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inColor;
-layout(location = 0) out vec3 fragColor;
+layout(location = 0) in vec4 inRect;
+layout(location = 1) in vec4 inUV;
+layout(location = 2) in vec4 inColor;
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragUV;
+
+layout(push_constant) uniform SpritePushConstants {
+    vec2 scale;
+    vec2 offset;
+    uint textureIndex;
+    uint textured;
+} pc;
 
 void main() {
-    gl_Position = vec4(inPosition, 1.0);
+    // Corners of two triangles: (0,0) (1,0) (0,1) (1,0) (1,1) (0,1)
+    uint i = uint(gl_VertexIndex);
+    vec2 corner = vec2(float((0x1Au >> i) & 1u), float((0x34u >> i) & 1u));
+    vec2 position = inRect.xy + corner * inRect.zw;
+    gl_Position = vec4(position * pc.scale + pc.offset, 0.0, 1.0);
+    fragUV = mix(inUV.xy, inUV.zw, corner);
     fragColor = inColor;
-}
\ No newline at end of file
+}
@@ -58,32 +58,58 @@ void createVertexBuffer(Engine* engine) {
 }
 
 void createUniformBuffer(Engine* engine) {
-    VkBufferCreateInfo bufferInfo = {
-        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-        .size = sizeof(float) * 16,
-        .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
-    };
-
-    if (vkCreateBuffer(engine->device, &bufferInfo, NULL, &engine->uniformBuffer) != VK_SUCCESS) {
+    if (createBuffer(engine, sizeof(float) * 16, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     &engine->uniformBuffer, &engine->uniformBufferMemory) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create uniform buffer\n");
         return;
     }
 
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(engine->device, engine->uniformBuffer, &memRequirements);
+    // Mapped for the engine's lifetime so per-frame matrix updates are a plain copy.
+    if (vkMapMemory(engine->device, engine->uniformBufferMemory, 0, sizeof(float) * 16, 0, &engine->uniformBufferMapped) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to map uniform buffer memory\n");
+        engine->uniformBufferMapped = NULL;
+    }
+}
+
 
+uint32_t findMemoryType(Engine* engine, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
     VkPhysicalDeviceMemoryProperties memProperties;
     vkGetPhysicalDeviceMemoryProperties(engine->physicalDevice, &memProperties);
 
-    uint32_t memoryTypeIndex = 0;
     for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((memRequirements.memoryTypeBits & (1 << i)) &&
-            (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
-            memoryTypeIndex = i;
-            break;
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
         }
     }
+    return UINT32_MAX;
+}
+
+VkResult createBuffer(Engine* engine, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                      VkBuffer* buffer, VkDeviceMemory* memory) {
+    VkBufferCreateInfo bufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+    };
+
+    VkResult result = vkCreateBuffer(engine->device, &bufferInfo, NULL, buffer);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create buffer: %d\n", result);
+        return result;
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(engine->device, *buffer, &memRequirements);
+
+    uint32_t memoryTypeIndex = findMemoryType(engine, memRequirements.memoryTypeBits, properties);
+    if (memoryTypeIndex == UINT32_MAX) {
+        fprintf(stderr, "Failed to find suitable memory type for buffer\n");
+        vkDestroyBuffer(engine->device, *buffer, NULL);
+        *buffer = VK_NULL_HANDLE;
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
 
     VkMemoryAllocateInfo allocInfo = {
         .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
@@ -91,12 +117,21 @@ void createUniformBuffer(Engine* engine) {
         .memoryTypeIndex = memoryTypeIndex
     };
 
-    if (vkAllocateMemory(engine->device, &allocInfo, NULL, &engine->uniformBufferMemory) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to allocate uniform buffer memory\n");
-        return;
+    result = vkAllocateMemory(engine->device, &allocInfo, NULL, memory);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate buffer memory: %d\n", result);
+        vkDestroyBuffer(engine->device, *buffer, NULL);
+        *buffer = VK_NULL_HANDLE;
+        return result;
     }
 
-    if (vkBindBufferMemory(engine->device, engine->uniformBuffer, engine->uniformBufferMemory, 0) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to bind uniform buffer memory\n");
+    result = vkBindBufferMemory(engine->device, *buffer, *memory, 0);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "Failed to bind buffer memory: %d\n", result);
+        vkFreeMemory(engine->device, *memory, NULL);
+        vkDestroyBuffer(engine->device, *buffer, NULL);
+        *memory = VK_NULL_HANDLE;
+        *buffer = VK_NULL_HANDLE;
     }
-}
\ No newline at end of file
+    return result;
+}
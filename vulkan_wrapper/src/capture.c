@@ -0,0 +1,288 @@
+#include "engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CAPTURE_BUFFER_SIZE (1u << 20)
+
+struct Capture {
+    FILE* file;
+    char* buffer;
+    uint32_t frameCount;
+    int failed;
+};
+
+// Arguments each call is recorded with; payload sizes are checked per call on replay.
+static const uint8_t callWords[CAPTURE_CALL_COUNT] = {
+    [CAPTURE_FRAME] = 1,
+    [CAPTURE_SET_CLEAR_COLOR] = 4,
+    [CAPTURE_SET_VERTICES] = 1,
+    [CAPTURE_SET_VIEW_MATRIX] = 0,
+    [CAPTURE_SET_SPRITES] = 1,
+    [CAPTURE_NODE_CREATE] = 1,
+    [CAPTURE_NODE_DESTROY] = 1,
+    [CAPTURE_NODE_SET_PARENT] = 2,
+    [CAPTURE_NODE_SET_TRANSLATION] = 4,
+    [CAPTURE_NODE_SET_ROTATION] = 5,
+    [CAPTURE_NODE_SET_SCALE] = 4,
+    [CAPTURE_NODES_SET_TRANSLATIONS] = 1,
+    [CAPTURE_MESH_CREATE] = 3,
+    [CAPTURE_MESH_PACK_OPEN] = 0,
+    [CAPTURE_MESH_INSTANCE_CREATE] = 2,
+    [CAPTURE_MESH_INSTANCE_DESTROY] = 1,
+    [CAPTURE_SET_LOD_THRESHOLD] = 1,
+    [CAPTURE_SET_OCCLUSION_CULLING] = 1,
+    [CAPTURE_TEXTURE_PACK_OPEN] = 0,
+    [CAPTURE_TEXTURE_TOUCH] = 1,
+    [CAPTURE_TEXTURE_SET_BUDGET] = 2,
+    [CAPTURE_MESH_CREATE_LAYOUT] = 4,
+    [CAPTURE_SET_DYNAMIC_RESOLUTION] = 2
+};
+
+static void writeCapture(Capture* capture, const void* data, size_t size) {
+    if (size > 0 && fwrite(data, 1, size, capture->file) != size) capture->failed = 1;
+}
+
+// Calls are recorded as issued, before validation, so a replay runs into the same errors.
+void captureCall(Engine* engine, uint32_t call, const CaptureWord* words, uint32_t wordCount,
+                 const CaptureData* data, uint32_t dataCount) {
+    Capture* capture = engine->capture;
+    if (!capture || capture->failed) return;
+
+    CaptureRecord record = {call, wordCount, 0};
+    for (uint32_t i = 0; i < dataCount; i++) record.dataSize += data[i].size;
+
+    static const uint8_t padding[4] = {0};
+    writeCapture(capture, &record, sizeof(record));
+    writeCapture(capture, words, sizeof(CaptureWord) * wordCount);
+    for (uint32_t i = 0; i < dataCount; i++) writeCapture(capture, data[i].bytes, data[i].size);
+    writeCapture(capture, padding, (4 - record.dataSize % 4) % 4);
+    if (capture->failed) fprintf(stderr, "Failed to write capture, recording stopped\n");
+}
+
+void captureFrame(Engine* engine, float deltaTime) {
+    if (!engine->capture) return;
+    captureCall(engine, CAPTURE_FRAME, (CaptureWord[]){{.f = deltaTime}}, 1, NULL, 0);
+    engine->capture->frameCount++;
+}
+
+// Records every state-changing API call into `path` until engine_capture_end. A replay starts
+// from a fresh engine, so this has to be called before anything is created; calls made earlier
+// are missing from the capture. Extra windows are not recorded.
+EXPORT int engine_capture_begin(Engine* engine, const char* path) {
+    if (engine->capture) {
+        fprintf(stderr, "engine_capture_begin: a capture is already being recorded\n");
+        return 0;
+    }
+    if (engine->frameIndex > 0) {
+        fprintf(stderr, "engine_capture_begin: must be called before the first frame\n");
+        return 0;
+    }
+
+    Capture* capture = (Capture*)calloc(1, sizeof(Capture));
+    if (!capture) {
+        fprintf(stderr, "Failed to allocate memory for capture\n");
+        return 0;
+    }
+
+    capture->file = fopen(path, "wb");
+    if (!capture->file) {
+        fprintf(stderr, "Failed to open capture file: %s\n", path);
+        free(capture);
+        return 0;
+    }
+    capture->buffer = (char*)malloc(CAPTURE_BUFFER_SIZE);
+    if (capture->buffer) setvbuf(capture->file, capture->buffer, _IOFBF, CAPTURE_BUFFER_SIZE);
+
+    CaptureHeader header = {{'D', 'F', 'C', 'P'}, CAPTURE_VERSION, engine->swapchainExtent.width, engine->swapchainExtent.height};
+    writeCapture(capture, &header, sizeof(header));
+    engine->capture = capture;
+    return 1;
+}
+
+// Closes the capture. Returns the number of frames recorded, or -1 if writing failed.
+EXPORT int64_t engine_capture_end(Engine* engine) {
+    Capture* capture = engine->capture;
+    if (!capture) return -1;
+    engine->capture = NULL;
+
+    if (fclose(capture->file) != 0) capture->failed = 1;
+    int64_t frames = capture->failed ? -1 : (int64_t)capture->frameCount;
+    free(capture->buffer);
+    free(capture);
+    return frames;
+}
+
+static int validPayload(const CaptureRecord* record, const CaptureWord* words, const uint8_t* data) {
+    switch (record->call) {
+        case CAPTURE_SET_VERTICES:
+            return record->dataSize == (uint64_t)words[0].u * sizeof(Vertex3D);
+        case CAPTURE_SET_VIEW_MATRIX:
+            return record->dataSize == sizeof(float) * 16;
+        case CAPTURE_SET_SPRITES:
+            return record->dataSize == (uint64_t)words[0].u * sizeof(SpriteInstance);
+        case CAPTURE_NODES_SET_TRANSLATIONS:
+            return record->dataSize == (uint64_t)words[0].u * sizeof(float) * 4;
+        case CAPTURE_MESH_CREATE:
+        case CAPTURE_MESH_CREATE_LAYOUT:
+            return record->dataSize == (uint64_t)words[0].u * sizeof(Vertex3D) + (uint64_t)words[1].u * sizeof(uint32_t);
+        case CAPTURE_MESH_PACK_OPEN:
+        case CAPTURE_TEXTURE_PACK_OPEN:
+            return record->dataSize > 0 && data[record->dataSize - 1] == '\0';
+        default:
+            return record->dataSize == 0;
+    }
+}
+
+static void replayCall(Engine* engine, const CaptureRecord* record, const CaptureWord* w, const uint8_t* data) {
+    uint32_t count;
+    switch (record->call) {
+        case CAPTURE_SET_CLEAR_COLOR:
+            engine_set_clear_color(engine, w[0].f, w[1].f, w[2].f, w[3].f);
+            break;
+        case CAPTURE_SET_VERTICES:
+            engine_set_vertices(engine, (Vertex3D*)data, w[0].u);
+            break;
+        case CAPTURE_SET_VIEW_MATRIX:
+            engine_set_view_matrix(engine, (float*)data);
+            break;
+        case CAPTURE_SET_SPRITES:
+            engine_set_sprites(engine, (const SpriteInstance*)data, w[0].u);
+            break;
+        case CAPTURE_NODE_CREATE:
+            engine_node_create(engine, w[0].u);
+            break;
+        case CAPTURE_NODE_DESTROY:
+            engine_node_destroy(engine, w[0].u);
+            break;
+        case CAPTURE_NODE_SET_PARENT:
+            engine_node_set_parent(engine, w[0].u, w[1].u);
+            break;
+        case CAPTURE_NODE_SET_TRANSLATION:
+            engine_node_set_translation(engine, w[0].u, w[1].f, w[2].f, w[3].f);
+            break;
+        case CAPTURE_NODE_SET_ROTATION:
+            engine_node_set_rotation(engine, w[0].u, w[1].f, w[2].f, w[3].f, w[4].f);
+            break;
+        case CAPTURE_NODE_SET_SCALE:
+            engine_node_set_scale(engine, w[0].u, w[1].f, w[2].f, w[3].f);
+            break;
+        case CAPTURE_NODES_SET_TRANSLATIONS:
+            count = w[0].u;
+            engine_nodes_set_translations(engine, (const uint32_t*)data, (const float*)(data + sizeof(uint32_t) * count), count);
+            break;
+        case CAPTURE_MESH_CREATE:
+            engine_mesh_create(engine, (const Vertex3D*)data, w[0].u, (const uint32_t*)(data + sizeof(Vertex3D) * w[0].u),
+                               w[1].u, w[2].f);
+            break;
+        case CAPTURE_MESH_PACK_OPEN:
+            engine_mesh_pack_open(engine, (const char*)data, &count);
+            break;
+        case CAPTURE_MESH_INSTANCE_CREATE:
+            engine_mesh_instance_create(engine, w[0].i, w[1].u);
+            break;
+        case CAPTURE_MESH_INSTANCE_DESTROY:
+            engine_mesh_instance_destroy(engine, w[0].i);
+            break;
+        case CAPTURE_SET_LOD_THRESHOLD:
+            engine_set_lod_threshold(engine, w[0].f);
+            break;
+        case CAPTURE_SET_OCCLUSION_CULLING:
+            engine_set_occlusion_culling(engine, w[0].i);
+            break;
+        case CAPTURE_TEXTURE_PACK_OPEN:
+            engine_texture_pack_open(engine, (const char*)data, &count);
+            break;
+        case CAPTURE_TEXTURE_TOUCH:
+            engine_texture_touch(engine, w[0].u);
+            break;
+        case CAPTURE_TEXTURE_SET_BUDGET:
+            engine_texture_set_budget(engine, (uint64_t)w[0].u | (uint64_t)w[1].u << 32);
+            break;
+        case CAPTURE_MESH_CREATE_LAYOUT:
+            engine_mesh_create_layout(engine, (const Vertex3D*)data, w[0].u,
+                                      (const uint32_t*)(data + sizeof(Vertex3D) * w[0].u), w[1].u, w[2].f, w[3].u);
+            break;
+        case CAPTURE_SET_DYNAMIC_RESOLUTION:
+            engine_set_dynamic_resolution(engine, w[0].f, w[1].f);
+            break;
+    }
+}
+
+// Re-issues a capture against a headless engine of the captured size, rendering a frame at every
+// frame marker without waiting for any clock. Returns the number of frames replayed, or -1.
+EXPORT int64_t engine_replay(const char* path, ReplayFrameCallback callback, void* userData) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open capture file: %s\n", path);
+        return -1;
+    }
+
+    CaptureHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, "DFCP", 4) != 0 ||
+        header.version != CAPTURE_VERSION || header.width == 0 || header.height == 0) {
+        fprintf(stderr, "Invalid capture file: %s\n", path);
+        fclose(file);
+        return -1;
+    }
+
+    Engine* engine = engine_create_headless((int)header.width, (int)header.height);
+    if (!engine) {
+        fclose(file);
+        return -1;
+    }
+
+    CaptureWord words[16];
+    uint8_t* data = NULL;
+    uint32_t dataCapacity = 0;
+    int64_t frames = 0;
+    uint64_t frameStart = traceNow();
+    CaptureRecord record;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        uint32_t paddedSize = record.dataSize + (4 - record.dataSize % 4) % 4;
+        if (record.call >= CAPTURE_CALL_COUNT || record.wordCount != callWords[record.call] || paddedSize < record.dataSize) {
+            fprintf(stderr, "Corrupt capture record at frame %lld\n", (long long)frames);
+            frames = -1;
+            break;
+        }
+        if (paddedSize > dataCapacity) {
+            uint8_t* grown = (uint8_t*)realloc(data, paddedSize);
+            if (!grown) {
+                fprintf(stderr, "Failed to allocate memory for capture payload\n");
+                frames = -1;
+                break;
+            }
+            data = grown;
+            dataCapacity = paddedSize;
+        }
+        if (fread(words, sizeof(CaptureWord), record.wordCount, file) != record.wordCount ||
+            fread(data, 1, paddedSize, file) != paddedSize) {
+            fprintf(stderr, "Capture ends inside a record, stopping\n");
+            break;
+        }
+        if (!validPayload(&record, words, data)) {
+            fprintf(stderr, "Capture record %u has an unexpected payload size, skipped\n", record.call);
+            continue;
+        }
+
+        if (record.call != CAPTURE_FRAME) {
+            replayCall(engine, &record, words, data);
+            continue;
+        }
+
+        uint64_t submitted = 0;
+        if (!renderHeadlessFrame(engine, &submitted)) {
+            frames = -1;
+            break;
+        }
+        uint64_t frameEnd = traceNow();
+        if (callback) callback((uint32_t)frames, submitted - frameStart, frameEnd - frameStart, userData);
+        frames++;
+        frameStart = traceNow();
+    }
+
+    free(data);
+    fclose(file);
+    engine_destroy(engine);
+    return frames;
+}
@@ -0,0 +1,68 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+
+// API capture container: header, then one record per exported call and one CAPTURE_FRAME
+// record at the end of every frame. A record is a CaptureRecord, wordCount 32-bit arguments,
+// then dataSize bytes of payload padded to a multiple of 4. Replays start from a freshly created
+// engine, so handles returned during the capture come out the same.
+#define CAPTURE_VERSION 1
+
+// Values are part of the file format: append only.
+enum {
+    CAPTURE_FRAME,                    // f deltaTime
+    CAPTURE_SET_CLEAR_COLOR,          // f r, g, b, a
+    CAPTURE_SET_VERTICES,             // u vertexCount; Vertex3D[vertexCount]
+    CAPTURE_SET_VIEW_MATRIX,          // float[16]
+    CAPTURE_SET_SPRITES,              // u spriteCount; SpriteInstance[spriteCount]
+    CAPTURE_NODE_CREATE,              // u parent
+    CAPTURE_NODE_DESTROY,             // u node
+    CAPTURE_NODE_SET_PARENT,          // u node, parent
+    CAPTURE_NODE_SET_TRANSLATION,     // u node; f x, y, z
+    CAPTURE_NODE_SET_ROTATION,        // u node; f x, y, z, w
+    CAPTURE_NODE_SET_SCALE,           // u node; f x, y, z
+    CAPTURE_NODES_SET_TRANSLATIONS,   // u count; uint32[count] nodes, float[count * 3]
+    CAPTURE_MESH_CREATE,              // u vertexCount, indexCount; f lodMaxError; Vertex3D[], uint32[]
+    CAPTURE_MESH_PACK_OPEN,           // path, NUL terminated
+    CAPTURE_MESH_INSTANCE_CREATE,     // i mesh; u node
+    CAPTURE_MESH_INSTANCE_DESTROY,    // i instance
+    CAPTURE_SET_LOD_THRESHOLD,        // f pixels
+    CAPTURE_SET_OCCLUSION_CULLING,    // i enabled
+    CAPTURE_TEXTURE_PACK_OPEN,        // path, NUL terminated
+    CAPTURE_TEXTURE_TOUCH,            // u texture
+    CAPTURE_TEXTURE_SET_BUDGET,       // u low, high
+    CAPTURE_MESH_CREATE_LAYOUT,       // u vertexCount, indexCount; f lodMaxError; u layout; Vertex3D[], uint32[]
+    CAPTURE_SET_DYNAMIC_RESOLUTION,   // f targetMilliseconds, minScale
+    CAPTURE_CALL_COUNT
+};
+
+typedef struct {
+    char magic[4];  // "DFCP"
+    uint32_t version;
+    uint32_t width;   // main window framebuffer when the capture started
+    uint32_t height;
+} CaptureHeader;
+
+typedef struct {
+    uint32_t call;
+    uint32_t wordCount;
+    uint32_t dataSize;
+} CaptureRecord;
+
+typedef union {
+    uint32_t u;
+    int32_t i;
+    float f;
+} CaptureWord;
+
+typedef struct {
+    const void* bytes;
+    uint32_t size;
+} CaptureData;
+
+// Called after every replayed frame with the time spent issuing its calls, recording and
+// submitting it (cpu), and until the GPU had finished it (total), in nanoseconds.
+typedef void (*ReplayFrameCallback)(uint32_t frame, uint64_t cpuNanoseconds, uint64_t totalNanoseconds, void* userData);
+
+#endif
@@ -0,0 +1,228 @@
+#include "engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PIPELINE_CACHE_PATH ".shaders/pipeline.cache"
+
+// GLFW, the Vulkan instance and the device are process-wide: every engine created while another
+// one is alive reuses them, and the last engine destroyed tears them down. Engines are created
+// and destroyed on the main thread, as GLFW requires, so the reference count needs no lock.
+// A headless context (capture replay) never initialises GLFW and enables no surface extensions.
+struct DeviceContext {
+    uint32_t refCount;
+    int headless;
+    VkInstance instance;
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    VkQueue graphicsQueue;
+    VkPipelineCache pipelineCache;
+};
+
+static DeviceContext* sharedContext = NULL;
+
+static void error_callback(int error, const char* description) {
+    fprintf(stderr, "GLFW Error %d: %s\n", error, description);
+}
+
+// The driver validates the header and ignores data written by another device or driver version.
+static void createPipelineCache(DeviceContext* context) {
+    void* data = NULL;
+    size_t size = 0;
+    FILE* file = fopen(PIPELINE_CACHE_PATH, "rb");
+    if (file) {
+        fseek(file, 0, SEEK_END);
+        long length = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        if (length > 0 && (data = malloc((size_t)length)) != NULL) {
+            size = fread(data, 1, (size_t)length, file);
+        }
+        fclose(file);
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = size,
+        .pInitialData = data
+    };
+
+    if (vkCreatePipelineCache(context->device, &cacheInfo, NULL, &context->pipelineCache) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create pipeline cache\n");
+        context->pipelineCache = VK_NULL_HANDLE;
+    }
+    free(data);
+}
+
+static void savePipelineCache(DeviceContext* context) {
+    size_t size = 0;
+    if (vkGetPipelineCacheData(context->device, context->pipelineCache, &size, NULL) != VK_SUCCESS || size == 0) return;
+
+    void* data = malloc(size);
+    if (!data) return;
+    if (vkGetPipelineCacheData(context->device, context->pipelineCache, &size, data) == VK_SUCCESS) {
+        FILE* file = fopen(PIPELINE_CACHE_PATH, "wb");
+        if (file) {
+            fwrite(data, 1, size, file);
+            fclose(file);
+        }
+    }
+    free(data);
+}
+
+static int createInstance(DeviceContext* context, const char* applicationName) {
+    uint32_t glfwExtensionCount = 0;
+    const char** glfwExtensions = context->headless ? NULL : glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    if (!glfwExtensions && !context->headless) {
+        fprintf(stderr, "Failed to get GLFW required extensions\n");
+        return 0;
+    }
+
+    VkApplicationInfo appInfo = {
+        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .pApplicationName = applicationName,
+        .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
+        .pEngineName = "Game Engine",
+        .engineVersion = VK_MAKE_VERSION(1, 0, 0),
+        .apiVersion = VK_API_VERSION_1_0
+    };
+
+    VkInstanceCreateInfo instanceInfo = {
+        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+        .pApplicationInfo = &appInfo,
+        .enabledExtensionCount = glfwExtensionCount,
+        .ppEnabledExtensionNames = glfwExtensions,
+        .enabledLayerCount = 0
+    };
+
+    TRACE_ZONE_BEGIN(instanceZone, "vkCreateInstance");
+    VkResult result = vkCreateInstance(&instanceInfo, NULL, &context->instance);
+    TRACE_ZONE_END(instanceZone);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create Vulkan instance: %d\n", result);
+        return 0;
+    }
+    return 1;
+}
+
+static int createDevice(DeviceContext* context) {
+    uint32_t deviceCount = 0;
+    VkResult result = vkEnumeratePhysicalDevices(context->instance, &deviceCount, NULL);
+    if (result != VK_SUCCESS || deviceCount == 0) {
+        fprintf(stderr, "Failed to enumerate physical devices: %d, count=%d\n", result, deviceCount);
+        return 0;
+    }
+
+    VkPhysicalDevice* devices = (VkPhysicalDevice*)malloc(deviceCount * sizeof(VkPhysicalDevice));
+    result = vkEnumeratePhysicalDevices(context->instance, &deviceCount, devices);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "Failed to get physical devices: %d\n", result);
+        free(devices);
+        return 0;
+    }
+    context->physicalDevice = devices[0];
+    free(devices);
+
+    VkDeviceQueueCreateInfo queueInfo = {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .queueFamilyIndex = 0,
+        .queueCount = 1,
+        .pQueuePriorities = &(float){1.0f}
+    };
+
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(context->physicalDevice, &supportedFeatures);
+    VkPhysicalDeviceFeatures enabledFeatures = {
+        .textureCompressionBC = supportedFeatures.textureCompressionBC,
+        .shaderSampledImageArrayDynamicIndexing = supportedFeatures.shaderSampledImageArrayDynamicIndexing,
+        .multiDrawIndirect = supportedFeatures.multiDrawIndirect
+    };
+
+    const char* deviceExtensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    VkDeviceCreateInfo deviceInfo = {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .queueCreateInfoCount = 1,
+        .pQueueCreateInfos = &queueInfo,
+        .enabledExtensionCount = context->headless ? 0 : 1,
+        .ppEnabledExtensionNames = deviceExtensions,
+        .pEnabledFeatures = &enabledFeatures
+    };
+
+    TRACE_ZONE_BEGIN(deviceZone, "vkCreateDevice");
+    result = vkCreateDevice(context->physicalDevice, &deviceInfo, NULL, &context->device);
+    TRACE_ZONE_END(deviceZone);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create Vulkan device: %d\n", result);
+        return 0;
+    }
+
+    vkGetDeviceQueue(context->device, 0, 0, &context->graphicsQueue);
+    return 1;
+}
+
+static DeviceContext* createDeviceContext(const char* applicationName, int headless) {
+    DeviceContext* context = (DeviceContext*)calloc(1, sizeof(DeviceContext));
+    if (!context) {
+        fprintf(stderr, "Failed to allocate memory for device context\n");
+        return NULL;
+    }
+    context->headless = headless;
+
+    glfwSetErrorCallback(error_callback);
+    if (!headless && !glfwInit()) {
+        fprintf(stderr, "Failed to initialize GLFW\n");
+        free(context);
+        return NULL;
+    }
+
+    if (!createInstance(context, applicationName)) {
+        if (!headless) glfwTerminate();
+        free(context);
+        return NULL;
+    }
+
+    if (!createDevice(context)) {
+        vkDestroyInstance(context->instance, NULL);
+        if (!headless) glfwTerminate();
+        free(context);
+        return NULL;
+    }
+
+    TRACE_CALL(createPipelineCache(context));
+    return context;
+}
+
+// Fills the engine's instance, device, queue and pipeline cache handles.
+int acquireDeviceContext(Engine* engine, const char* applicationName, int headless) {
+    if (!sharedContext) sharedContext = createDeviceContext(applicationName, headless);
+    if (!sharedContext) return 0;
+    if (sharedContext->headless && !headless) {
+        fprintf(stderr, "Cannot create a window while a headless engine is alive\n");
+        return 0;
+    }
+
+    DeviceContext* context = sharedContext;
+    context->refCount++;
+    engine->context = context;
+    engine->instance = context->instance;
+    engine->physicalDevice = context->physicalDevice;
+    engine->device = context->device;
+    engine->graphicsQueue = context->graphicsQueue;
+    engine->pipelineCache = context->pipelineCache;
+    return 1;
+}
+
+void releaseDeviceContext(Engine* engine) {
+    DeviceContext* context = engine->context;
+    engine->context = NULL;
+    if (!context || --context->refCount > 0) return;
+
+    vkDeviceWaitIdle(context->device);
+    if (context->pipelineCache) {
+        savePipelineCache(context);
+        vkDestroyPipelineCache(context->device, context->pipelineCache, NULL);
+    }
+    vkDestroyDevice(context->device, NULL);
+    vkDestroyInstance(context->instance, NULL);
+    if (!context->headless) glfwTerminate();
+    free(context);
+    sharedContext = NULL;
+}
@@ -3,192 +3,217 @@
 #include <stdlib.h>
 #include <string.h>
 
-static void error_callback(int error, const char* description) {
-    fprintf(stderr, "GLFW Error %d: %s\n", error, description);
-}
-
 void recreateSwapChain(Engine* engine) {
     // Ждём завершения всех операций
     vkDeviceWaitIdle(engine->device);
 
     // Очищаем старые ресурсы
+    graphInvalidate(engine);
     for (uint32_t i = 0; i < engine->swapchainImageCount; i++) {
-        vkDestroyFramebuffer(engine->device, engine->framebuffers[i], NULL);
         vkDestroyImageView(engine->device, engine->swapchainImageViews[i], NULL);
     }
-    free(engine->framebuffers);
     free(engine->swapchainImageViews);
     free(engine->swapchainImages);
+    invalidateHiZ(engine);
+    vkDestroyRenderPass(engine->device, engine->renderPass, NULL);
     vkDestroySwapchainKHR(engine->device, engine->swapchain, NULL);
 
     // Пересоздаём swapchain и связанные ресурсы
     createSwapChain(engine);
     createRenderPass(engine); // Можно оптимизировать, если render pass не зависит от размера
-    createFramebuffers(engine);
     createCommandPoolAndBuffers(engine); // Пересоздаём command buffer
 }
 
-EXPORT Engine* engine_create(int width, int height, const char* title) {
-    Engine* engine = (Engine*)calloc(1, sizeof(Engine));
-    if (!engine) {
-        fprintf(stderr, "Failed to allocate memory for Engine\n");
-        return NULL;
-    }
-
-    engine->clearColor[0] = 0.0f;
-    engine->clearColor[1] = 0.0f;
-    engine->clearColor[2] = 1.0f;
-    engine->clearColor[3] = 1.0f;
-
-    glfwSetErrorCallback(error_callback);
-    if (!glfwInit()) {
-        fprintf(stderr, "Failed to initialize GLFW\n");
-        free(engine);
-        return NULL;
-    }
-
+static int createSurface(Engine* engine, int width, int height, const char* title) {
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     engine->window = glfwCreateWindow(width, height, title, NULL, NULL);
     if (!engine->window) {
         fprintf(stderr, "Failed to create GLFW window\n");
-        glfwTerminate();
-        free(engine);
-        return NULL;
+        return 0;
     }
 
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-    if (!glfwExtensions) {
-        fprintf(stderr, "Failed to get GLFW required extensions\n");
+    VkResult result = glfwCreateWindowSurface(engine->instance, engine->window, NULL, &engine->surface);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create window surface: %d\n", result);
         glfwDestroyWindow(engine->window);
-        glfwTerminate();
-        free(engine);
-        return NULL;
+        engine->window = NULL;
+        return 0;
     }
+    return 1;
+}
 
-    VkApplicationInfo appInfo = {
-        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
-        .pApplicationName = title,
-        .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
-        .pEngineName = "Game Engine",
-        .engineVersion = VK_MAKE_VERSION(1, 0, 0),
-        .apiVersion = VK_API_VERSION_1_0
-    };
+static void createDescriptors(Engine* engine) {
+    createDescriptorPool(engine);
+    createDescriptorSet(engine);
+}
 
-    VkInstanceCreateInfo instanceInfo = {
-        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
-        .pApplicationInfo = &appInfo,
-        .enabledExtensionCount = glfwExtensionCount,
-        .ppEnabledExtensionNames = glfwExtensions,
-        .enabledLayerCount = 0
-    };
+enum {
+    INIT_WINDOW,
+    INIT_SWAPCHAIN,
+    INIT_RENDER_PASS,
+    INIT_RENDER_GRAPH,
+    INIT_COMMANDS,
+    INIT_SYNC,
+    INIT_VERTEX_BUFFER,
+    INIT_UNIFORM_BUFFER,
+    INIT_LAYOUTS,
+    INIT_DESCRIPTORS,
+    INIT_GRAPHICS_PIPELINE,
+    INIT_SPRITE_PIPELINE,
+    INIT_MESH_PIPELINE,
+    INIT_NODES,
+    INIT_GPU_TRACE,
+    INIT_TASK_COUNT
+};
+
+#define AFTER(task) (1u << (task))
+
+// Only the swapchain waits for the window: the render pass and every pipeline are built for the
+// expected surface format while it is created. Textures, sprites, meshes and occlusion culling
+// are created on first use.
+static const InitTask initTasks[INIT_TASK_COUNT] = {
+    [INIT_WINDOW] = {"window", NULL, 0, 1},
+    [INIT_SWAPCHAIN] = {"swapchain", createSwapChain, AFTER(INIT_WINDOW), 1},
+    [INIT_RENDER_PASS] = {"render pass", createRenderPass, 0, 0},
+    [INIT_RENDER_GRAPH] = {"render graph", createRenderGraph, 0, 0},
+    [INIT_COMMANDS] = {"command pool", createCommandPoolAndBuffers, 0, 0},
+    [INIT_SYNC] = {"sync objects", createSyncObjects, 0, 0},
+    [INIT_VERTEX_BUFFER] = {"vertex buffer", createVertexBuffer, 0, 0},
+    [INIT_UNIFORM_BUFFER] = {"uniform buffer", createUniformBuffer, 0, 0},
+    [INIT_LAYOUTS] = {"pipeline layout", createPipelineLayout, 0, 0},
+    [INIT_DESCRIPTORS] = {"descriptors", createDescriptors, AFTER(INIT_LAYOUTS) | AFTER(INIT_UNIFORM_BUFFER), 0},
+    [INIT_GRAPHICS_PIPELINE] = {"graphics pipeline", createGraphicsPipeline, AFTER(INIT_LAYOUTS) | AFTER(INIT_RENDER_PASS), 0},
+    [INIT_SPRITE_PIPELINE] = {"sprite pipeline", createSpritePipeline, AFTER(INIT_LAYOUTS) | AFTER(INIT_RENDER_PASS), 0},
+    [INIT_MESH_PIPELINE] = {"mesh pipelines", createMeshPipelines, AFTER(INIT_LAYOUTS) | AFTER(INIT_RENDER_PASS), 0},
+    [INIT_NODES] = {"node store", createNodeStore, 0, 0},
+    [INIT_GPU_TRACE] = {"gpu trace", createGpuTrace, 0, 0}
+};
+
+// The surface did not offer the expected format, so the pipelines have to be built again.
+static void rebuildPipelines(Engine* engine) {
+    if (engine->graphicsPipeline) vkDestroyPipeline(engine->device, engine->graphicsPipeline, NULL);
+    if (engine->spritePipeline) vkDestroyPipeline(engine->device, engine->spritePipeline, NULL);
+    if (engine->spritePipelineLayout) vkDestroyPipelineLayout(engine->device, engine->spritePipelineLayout, NULL);
+    for (uint32_t i = 0; i < MESH_LAYOUT_COUNT; i++) {
+        if (engine->meshPipelines[i]) vkDestroyPipeline(engine->device, engine->meshPipelines[i], NULL);
+        engine->meshPipelines[i] = VK_NULL_HANDLE;
+    }
+    vkDestroyRenderPass(engine->device, engine->renderPass, NULL);
+    engine->graphicsPipeline = VK_NULL_HANDLE;
+    engine->spritePipeline = VK_NULL_HANDLE;
+    engine->spritePipelineLayout = VK_NULL_HANDLE;
+    engine->renderPass = VK_NULL_HANDLE;
+
+    engine->renderPassFormat = engine->swapchainImageFormat;
+    TRACE_CALL(createRenderPass(engine));
+    TRACE_CALL(createGraphicsPipeline(engine));
+    TRACE_CALL(createSpritePipeline(engine));
+    TRACE_CALL(createMeshPipelines(engine));
+}
 
-    VkResult result = vkCreateInstance(&instanceInfo, NULL, &engine->instance);
-    if (result != VK_SUCCESS) {
-        fprintf(stderr, "Failed to create Vulkan instance: %d\n", result);
-        glfwDestroyWindow(engine->window);
-        glfwTerminate();
-        free(engine);
+static Engine* createEngine(int width, int height, const char* title, int headless) {
+    traceThreadName("main");
+    TRACE_ZONE_BEGIN(createZone, "engine_create");
+    Engine* engine = (Engine*)calloc(1, sizeof(Engine));
+    if (!engine) {
+        fprintf(stderr, "Failed to allocate memory for Engine\n");
         return NULL;
     }
+    engine->createStart = traceNow();
 
-    result = glfwCreateWindowSurface(engine->instance, engine->window, NULL, &engine->surface);
-    if (result != VK_SUCCESS) {
-        fprintf(stderr, "Failed to create window surface: %d\n", result);
-        vkDestroyInstance(engine->instance, NULL);
-        glfwDestroyWindow(engine->window);
-        glfwTerminate();
+    engine->clearColor[0] = 0.0f;
+    engine->clearColor[1] = 0.0f;
+    engine->clearColor[2] = 1.0f;
+    engine->clearColor[3] = 1.0f;
+    engine->lodThreshold = DEFAULT_LOD_THRESHOLD;
+
+    // Instance and device are shared with every other engine alive in the process.
+    uint64_t stageStart = traceNow();
+    if (!acquireDeviceContext(engine, title, headless)) {
         free(engine);
         return NULL;
     }
+    recordInitStage(engine, "device context", stageStart);
 
-    uint32_t deviceCount = 0;
-    result = vkEnumeratePhysicalDevices(engine->instance, &deviceCount, NULL);
-    if (result != VK_SUCCESS || deviceCount == 0) {
-        fprintf(stderr, "Failed to enumerate physical devices: %d, count=%d\n", result, deviceCount);
-        vkDestroySurfaceKHR(engine->instance, engine->surface, NULL);
-        vkDestroyInstance(engine->instance, NULL);
-        glfwDestroyWindow(engine->window);
-        glfwTerminate();
+    engine->swapchainExtent = (VkExtent2D){(uint32_t)width, (uint32_t)height};
+    engine->renderPassFormat = PREFERRED_SURFACE_FORMAT;
+    InitGraph* graph = beginInitGraph(engine, initTasks, INIT_TASK_COUNT);
+    if (!graph) {
+        releaseDeviceContext(engine);
         free(engine);
         return NULL;
     }
 
-    VkPhysicalDevice* devices = (VkPhysicalDevice*)malloc(deviceCount * sizeof(VkPhysicalDevice));
-    result = vkEnumeratePhysicalDevices(engine->instance, &deviceCount, devices);
-    if (result != VK_SUCCESS) {
-        fprintf(stderr, "Failed to get physical devices: %d\n", result);
-        free(devices);
-        vkDestroySurfaceKHR(engine->instance, engine->surface, NULL);
-        vkDestroyInstance(engine->instance, NULL);
-        glfwDestroyWindow(engine->window);
-        glfwTerminate();
-        free(engine);
+    // The window must be created on this thread; the workers are already busy meanwhile.
+    stageStart = traceNow();
+    TRACE_ZONE_BEGIN(windowZone, "window");
+    int windowCreated = headless || createSurface(engine, width, height, title);
+    TRACE_ZONE_END(windowZone);
+    completeInitTask(graph, INIT_WINDOW, stageStart, windowCreated);
+    endInitGraph(graph);
+    if (!windowCreated) {
+        engine_destroy(engine);
         return NULL;
     }
-    engine->physicalDevice = devices[0];
-    free(devices);
-
-    VkDeviceQueueCreateInfo queueInfo = {
-        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-        .queueFamilyIndex = 0,
-        .queueCount = 1,
-        .pQueuePriorities = &(float){1.0f}
-    };
 
-    const char* deviceExtensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
-    VkDeviceCreateInfo deviceInfo = {
-        .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-        .queueCreateInfoCount = 1,
-        .pQueueCreateInfos = &queueInfo,
-        .enabledExtensionCount = 1,
-        .ppEnabledExtensionNames = deviceExtensions
-    };
-
-    result = vkCreateDevice(engine->physicalDevice, &deviceInfo, NULL, &engine->device);
-    if (result != VK_SUCCESS) {
-        fprintf(stderr, "Failed to create Vulkan device: %d\n", result);
-        vkDestroySurfaceKHR(engine->instance, engine->surface, NULL);
-        vkDestroyInstance(engine->instance, NULL);
-        glfwDestroyWindow(engine->window);
-        glfwTerminate();
-        free(engine);
-        return NULL;
+    if (engine->renderPass && engine->swapchainImageFormat != VK_FORMAT_UNDEFINED &&
+        engine->swapchainImageFormat != engine->renderPassFormat) {
+        stageStart = traceNow();
+        rebuildPipelines(engine);
+        recordInitStage(engine, "pipeline rebuild", stageStart);
     }
 
-    vkGetDeviceQueue(engine->device, 0, 0, &engine->graphicsQueue);
-    createSwapChain(engine);
-    createRenderPass(engine);
-    createFramebuffers(engine);
-    createCommandPoolAndBuffers(engine);
-    createSyncObjects(engine);
-    createVertexBuffer(engine);
-    createUniformBuffer(engine);
-    createGraphicsPipeline(engine);
-    createDescriptorPool(engine);
-    createDescriptorSet(engine);
+    TRACE_ZONE_END(createZone);
+    return engine;
+}
+
+EXPORT Engine* engine_create(int width, int height, const char* title) {
+    Engine* engine = createEngine(width, height, title, 0);
+    if (!engine) return NULL;
 
+    // Lets a capture be taken from an unmodified application.
+    const char* capturePath = getenv("DF_ENGINE_CAPTURE");
+    if (capturePath && capturePath[0]) engine_capture_begin(engine, capturePath);
     return engine;
 }
 
+// An engine without a window, rendering into an offscreen image; used to replay captures.
+EXPORT Engine* engine_create_headless(int width, int height) {
+    if (width <= 0 || height <= 0) {
+        fprintf(stderr, "Invalid headless engine size %dx%d\n", width, height);
+        return NULL;
+    }
+    return createEngine(width, height, "df_engine replay", 1);
+}
+
 EXPORT void engine_destroy(Engine* engine) {
+    engine_capture_end(engine);
+    destroyWindowSystem(engine);
+    destroyGpuTrace(engine);
+    destroyDynamicResolution(engine);
+    destroyOcclusionSystem(engine);
+    destroyMeshSystem(engine);
+    destroyNodeStore(engine);
+    destroySpriteBatch(engine);
+    destroyTextureSystem(engine);
     if (engine->descriptorPool) vkDestroyDescriptorPool(engine->device, engine->descriptorPool, NULL);
     if (engine->descriptorSetLayout) vkDestroyDescriptorSetLayout(engine->device, engine->descriptorSetLayout, NULL);
+    if (engine->uniformBufferMapped) vkUnmapMemory(engine->device, engine->uniformBufferMemory);
     if (engine->uniformBufferMemory) vkFreeMemory(engine->device, engine->uniformBufferMemory, NULL);
     if (engine->uniformBuffer) vkDestroyBuffer(engine->device, engine->uniformBuffer, NULL);
     if (engine->vertexBufferMemory) vkFreeMemory(engine->device, engine->vertexBufferMemory, NULL);
     if (engine->vertexBuffer) vkDestroyBuffer(engine->device, engine->vertexBuffer, NULL);
     if (engine->graphicsPipeline) vkDestroyPipeline(engine->device, engine->graphicsPipeline, NULL);
     if (engine->pipelineLayout) vkDestroyPipelineLayout(engine->device, engine->pipelineLayout, NULL);
+    for (uint32_t i = 0; i < MESH_LAYOUT_COUNT; i++) {
+        if (engine->meshPipelines[i]) vkDestroyPipeline(engine->device, engine->meshPipelines[i], NULL);
+    }
+    if (engine->spritePipeline) vkDestroyPipeline(engine->device, engine->spritePipeline, NULL);
+    if (engine->spritePipelineLayout) vkDestroyPipelineLayout(engine->device, engine->spritePipelineLayout, NULL);
     if (engine->imageAvailableSemaphore) vkDestroySemaphore(engine->device, engine->imageAvailableSemaphore, NULL);
     if (engine->renderFinishedSemaphore) vkDestroySemaphore(engine->device, engine->renderFinishedSemaphore, NULL);
     if (engine->commandPool) vkDestroyCommandPool(engine->device, engine->commandPool, NULL);
-    if (engine->framebuffers) {
-        for (uint32_t i = 0; i < engine->swapchainImageCount; i++) {
-            vkDestroyFramebuffer(engine->device, engine->framebuffers[i], NULL);
-        }
-        free(engine->framebuffers);
-    }
+    destroyRenderGraph(engine);
     if (engine->renderPass) vkDestroyRenderPass(engine->device, engine->renderPass, NULL);
     if (engine->swapchainImageViews) {
         for (uint32_t i = 0; i < engine->swapchainImageCount; i++) {
@@ -196,24 +221,231 @@ EXPORT void engine_destroy(Engine* engine) {
         }
         free(engine->swapchainImageViews);
     }
+    if (engine->offscreenMemory) {
+        vkDestroyImage(engine->device, engine->swapchainImages[0], NULL);
+        vkFreeMemory(engine->device, engine->offscreenMemory, NULL);
+    }
     if (engine->swapchainImages) free(engine->swapchainImages);
     if (engine->swapchain) vkDestroySwapchainKHR(engine->device, engine->swapchain, NULL);
-    if (engine->device) vkDestroyDevice(engine->device, NULL);
     if (engine->surface) vkDestroySurfaceKHR(engine->instance, engine->surface, NULL);
-    if (engine->instance) vkDestroyInstance(engine->instance, NULL);
     if (engine->window) glfwDestroyWindow(engine->window);
-    glfwTerminate();
+    releaseDeviceContext(engine);
     free(engine);
 }
 
+static void recordStreaming(Engine* engine, VkCommandBuffer commandBuffer, void* userData) {
+    (void)userData;
+    updateTextureStreaming(engine, commandBuffer);
+}
+
+static void recordCull(Engine* engine, VkCommandBuffer commandBuffer, void* userData) {
+    cullMeshes(engine, commandBuffer, (uint32_t)(uintptr_t)userData);
+}
+
+static void recordHiZ(Engine* engine, VkCommandBuffer commandBuffer, void* userData) {
+    (void)userData;
+    buildHiZ(engine, commandBuffer);
+}
+
+static void recordFirstPass(Engine* engine, VkCommandBuffer commandBuffer, void* userData) {
+    (void)userData;
+    recordVertices(engine, commandBuffer, engine->renderExtent, engine->descriptorSet);
+    recordMeshes(engine, commandBuffer, 0);
+}
+
+// A non-NULL userData means the scene is upscaled and sprites are drawn in the overlay pass.
+static void recordSecondPass(Engine* engine, VkCommandBuffer commandBuffer, void* userData) {
+    recordMeshes(engine, commandBuffer, 1);
+    if (!userData) recordSprites(engine, commandBuffer);
+}
+
+static void recordMainPass(Engine* engine, VkCommandBuffer commandBuffer, void* userData) {
+    recordFirstPass(engine, commandBuffer, userData);
+    if (!userData) recordSprites(engine, commandBuffer);
+}
+
+static void recordOverlay(Engine* engine, VkCommandBuffer commandBuffer, void* userData) {
+    (void)userData;
+    recordSprites(engine, commandBuffer);
+}
+
+// Declares the frame; the graph works out barriers, layouts and load/store ops from it, and
+// places the depth buffers in transient memory. With `upscale` the scene is drawn into the
+// render extent of a swapchain-sized transient and blitted to the swapchain.
+static int buildFrameGraph(Engine* engine, uint32_t imageIndex, int upscale) {
+    RenderGraph* graph = engine->graph;
+    if (!graph) return 0;
+
+    VkClearValue clearColor = {.color = {{engine->clearColor[0], engine->clearColor[1], engine->clearColor[2], engine->clearColor[3]}}};
+    VkClearValue clearDepth = {.depthStencil = {1.0f, 0}};
+
+    graphBegin(graph);
+    uint32_t color = graphImportImage(graph, "swapchain", engine->swapchainImages[imageIndex],
+                                      engine->swapchainImageViews[imageIndex], engine->swapchainImageFormat,
+                                      engine->swapchainExtent, GRAPH_ACCESS_NONE,
+                                      engine->swapchain ? GRAPH_ACCESS_PRESENT : GRAPH_ACCESS_COLOR_ATTACHMENT);
+    uint32_t depth = graphCreateImage(graph, "depth", engine->depthFormat, engine->swapchainExtent);
+    uint32_t scene = upscale ? graphCreateImage(graph, "scene color", engine->swapchainImageFormat, engine->swapchainExtent)
+                             : color;
+    void* upscaled = (void*)(uintptr_t)upscale;
+
+    // Uploads carry their own barriers into the sampling stages; the graph only has to keep the pass.
+    uint32_t pass = graphAddPass(graph, "texture streaming", GRAPH_PASS_TRANSFER, recordStreaming, NULL);
+    graphSideEffects(graph, pass);
+
+    uint32_t hiz = importHiZ(engine, graph);
+    if (hiz == GRAPH_NONE) {
+        pass = graphAddPass(graph, "main pass", GRAPH_PASS_GRAPHICS, recordMainPass, upscaled);
+        graphClear(graph, pass, scene, GRAPH_ACCESS_COLOR_ATTACHMENT, clearColor);
+        graphClear(graph, pass, depth, GRAPH_ACCESS_DEPTH_ATTACHMENT, clearDepth);
+        graphRenderArea(graph, pass, engine->renderExtent);
+    } else {
+        // Indirect commands, culled matrices and the rejected list, written by both culls.
+        uint32_t cull = graphImportBuffer(graph, "cull results", GRAPH_ACCESS_NONE, GRAPH_ACCESS_NONE);
+
+        pass = graphAddPass(graph, "first pass cull", GRAPH_PASS_COMPUTE, recordCull, (void*)(uintptr_t)0);
+        graphUse(graph, pass, hiz, GRAPH_ACCESS_COMPUTE_READ);
+        graphUse(graph, pass, cull, GRAPH_ACCESS_COMPUTE_WRITE);
+
+        pass = graphAddPass(graph, "first pass", GRAPH_PASS_GRAPHICS, recordFirstPass, NULL);
+        graphClear(graph, pass, scene, GRAPH_ACCESS_COLOR_ATTACHMENT, clearColor);
+        graphClear(graph, pass, depth, GRAPH_ACCESS_DEPTH_ATTACHMENT, clearDepth);
+        graphRenderArea(graph, pass, engine->renderExtent);
+        graphUse(graph, pass, cull, GRAPH_ACCESS_INDIRECT_READ);
+
+        pass = graphAddPass(graph, "hi-z (first pass)", GRAPH_PASS_COMPUTE, recordHiZ, NULL);
+        graphUse(graph, pass, depth, GRAPH_ACCESS_DEPTH_SAMPLED);
+        graphUse(graph, pass, hiz, GRAPH_ACCESS_COMPUTE_WRITE);
+
+        pass = graphAddPass(graph, "second pass cull", GRAPH_PASS_COMPUTE, recordCull, (void*)(uintptr_t)1);
+        graphUse(graph, pass, hiz, GRAPH_ACCESS_COMPUTE_READ);
+        graphUse(graph, pass, cull, GRAPH_ACCESS_COMPUTE_WRITE);
+
+        pass = graphAddPass(graph, "second pass", GRAPH_PASS_GRAPHICS, recordSecondPass, upscaled);
+        graphUse(graph, pass, scene, GRAPH_ACCESS_COLOR_ATTACHMENT);
+        graphUse(graph, pass, depth, GRAPH_ACCESS_DEPTH_ATTACHMENT);
+        graphRenderArea(graph, pass, engine->renderExtent);
+        graphUse(graph, pass, cull, GRAPH_ACCESS_INDIRECT_READ);
+
+        // The next frame's first pass is tested against the complete depth of this one.
+        pass = graphAddPass(graph, "hi-z", GRAPH_PASS_COMPUTE, recordHiZ, NULL);
+        graphUse(graph, pass, depth, GRAPH_ACCESS_DEPTH_SAMPLED);
+        graphUse(graph, pass, hiz, GRAPH_ACCESS_COMPUTE_WRITE);
+    }
+
+    if (upscale) {
+        addUpscalePass(engine, graph, scene, color);
+
+        // Sprites at full resolution over the upscaled scene. The depth attachment only keeps the
+        // render pass compatible with the sprite pipeline.
+        pass = graphAddPass(graph, "overlay", GRAPH_PASS_GRAPHICS, recordOverlay, NULL);
+        graphUse(graph, pass, color, GRAPH_ACCESS_COLOR_ATTACHMENT);
+        graphClear(graph, pass, depth, GRAPH_ACCESS_DEPTH_ATTACHMENT, clearDepth);
+    }
+
+    addWindowPasses(engine, graph);
+    if (!graphCompile(engine, graph)) return 0;
+    if (hiz != GRAPH_NONE) bindOcclusionDepth(engine, graphImageView(graph, depth));
+    return 1;
+}
+
+// Startup is measured up to here, including whatever the application did between engine_create
+// and its first frame.
+static void firstFrameDone(Engine* engine) {
+    engine->firstFrameTime = traceNow() - engine->createStart;
+    if (traceEnabled) traceEmit("time to first frame", engine->createStart, engine->firstFrameTime, TRACE_TRACK_THREAD);
+}
+
+// Builds the frame graph and records it into the engine's command buffer.
+static int recordFrame(Engine* engine, uint32_t imageIndex) {
+    int upscale = updateRenderExtent(engine);
+    TRACE_CALL(prepareMeshes(engine));
+    TRACE_ZONE_BEGIN(graphZone, "render graph");
+    int built = buildFrameGraph(engine, imageIndex, upscale);
+    TRACE_ZONE_END(graphZone);
+    if (!built) {
+        fprintf(stderr, "Failed to build the frame graph\n");
+        return 0;
+    }
+
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+
+    TRACE_ZONE_BEGIN(recordZone, "record");
+    if (vkBeginCommandBuffer(engine->commandBuffer, &beginInfo) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to begin command buffer\n");
+        return 0;
+    }
+    resolutionFrameBegin(engine, engine->commandBuffer);
+    gpuTraceFrameBegin(engine, engine->commandBuffer);
+    graphExecute(engine, engine->graph, engine->commandBuffer);
+    gpuTraceFrameEnd(engine, engine->commandBuffer);
+    resolutionFrameEnd(engine, engine->commandBuffer);
+    if (vkEndCommandBuffer(engine->commandBuffer) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to end command buffer\n");
+        return 0;
+    }
+    TRACE_ZONE_END(recordZone);
+    return 1;
+}
+
+// Headless frames wait on nothing and have nothing to present, so they signal nothing either.
+static int submitFrame(Engine* engine, uint32_t waitCount, const VkSemaphore* waitSemaphores,
+                       const VkPipelineStageFlags* waitStages) {
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .waitSemaphoreCount = waitCount,
+        .pWaitSemaphores = waitSemaphores,
+        .pWaitDstStageMask = waitStages,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &engine->commandBuffer,
+        .signalSemaphoreCount = engine->swapchain ? 1 : 0,
+        .pSignalSemaphores = &engine->renderFinishedSemaphore
+    };
+
+    TRACE_ZONE_BEGIN(submitZone, "submit");
+    if (vkQueueSubmit(engine->graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to submit queue\n");
+        return 0;
+    }
+    TRACE_ZONE_END(submitZone);
+    return 1;
+}
+
+// A frame that failed after its images were acquired still has to consume their semaphores. The
+// images cannot be handed back without presenting them, so every swapchain involved is rebuilt.
+static void abandonFrame(Engine* engine, uint32_t waitCount, const VkSemaphore* waitSemaphores,
+                         const VkPipelineStageFlags* waitStages) {
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .waitSemaphoreCount = waitCount,
+        .pWaitSemaphores = waitSemaphores,
+        .pWaitDstStageMask = waitStages
+    };
+    if (vkQueueSubmit(engine->graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to submit semaphore waits of an abandoned frame\n");
+    }
+    windowsAbandoned(engine);
+    recreateSwapChain(engine);
+}
+
 EXPORT void engine_run(Engine* engine, FrameCallback callback) {
+    if (!engine->window) {
+        fprintf(stderr, "engine_run: headless engines are driven by engine_replay\n");
+        return;
+    }
+
     double lastTime = glfwGetTime();
     while (!glfwWindowShouldClose(engine->window)) {
         double currentTime = glfwGetTime();
         float deltaTime = (float)(currentTime - lastTime);
         lastTime = currentTime;
 
-        if (callback) callback(deltaTime);
+        TRACE_ZONE_BEGIN(frameZone, "frame");
+        if (callback) TRACE_CALL(callback(deltaTime));
+        TRACE_CALL(engine_nodes_update(engine));
 
         glfwPollEvents();
 
@@ -222,8 +454,10 @@ EXPORT void engine_run(Engine* engine, FrameCallback callback) {
         if (width <= 0 || height <= 0) continue; // Игнорируем нулевые размеры
 
         uint32_t imageIndex;
+        TRACE_ZONE_BEGIN(acquireZone, "acquire");
         VkResult result = vkAcquireNextImageKHR(engine->device, engine->swapchain, UINT64_MAX,
                                                 engine->imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+        TRACE_ZONE_END(acquireZone);
         if (result == VK_ERROR_OUT_OF_DATE_KHR) {
             recreateSwapChain(engine);
             continue;
@@ -232,83 +466,98 @@ EXPORT void engine_run(Engine* engine, FrameCallback callback) {
             continue;
         }
 
-        VkCommandBufferBeginInfo beginInfo = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
-        };
-
-        if (vkBeginCommandBuffer(engine->commandBuffer, &beginInfo) != VK_SUCCESS) {
-            fprintf(stderr, "Failed to begin command buffer\n");
-            continue;
-        }
-
-        VkClearValue clearColor = {{{engine->clearColor[0], engine->clearColor[1], engine->clearColor[2], engine->clearColor[3]}}};
-        VkRenderPassBeginInfo renderPassInfo = {
-            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-            .renderPass = engine->renderPass,
-            .framebuffer = engine->framebuffers[imageIndex],
-            .renderArea.offset = {0, 0},
-            .renderArea.extent = engine->swapchainExtent,
-            .clearValueCount = 1,
-            .pClearValues = &clearColor
-        };
-
-        vkCmdBeginRenderPass(engine->commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        if (engine->vertexCount > 0 && engine->graphicsPipeline != VK_NULL_HANDLE) {
-            vkCmdBindPipeline(engine->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, engine->graphicsPipeline);
-            VkBuffer vertexBuffers[] = {engine->vertexBuffer};
-            VkDeviceSize offsets[] = {0};
-            vkCmdBindVertexBuffers(engine->commandBuffer, 0, 1, vertexBuffers, offsets);
-            vkCmdBindDescriptorSets(engine->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                    engine->pipelineLayout, 0, 1, &engine->descriptorSet, 0, NULL);
-            vkCmdDraw(engine->commandBuffer, engine->vertexCount, 1, 0, 0);
-        }
-
-        vkCmdEndRenderPass(engine->commandBuffer);
-
-        if (vkEndCommandBuffer(engine->commandBuffer) != VK_SUCCESS) {
-            fprintf(stderr, "Failed to end command buffer\n");
-            continue;
-        }
-
-        VkSubmitInfo submitInfo = {
-            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .waitSemaphoreCount = 1,
-            .pWaitSemaphores = &engine->imageAvailableSemaphore,
-            .pWaitDstStageMask = (VkPipelineStageFlags[]){VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT},
-            .commandBufferCount = 1,
-            .pCommandBuffers = &engine->commandBuffer,
-            .signalSemaphoreCount = 1,
-            .pSignalSemaphores = &engine->renderFinishedSemaphore
-        };
-
-        if (vkQueueSubmit(engine->graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
-            fprintf(stderr, "Failed to submit queue\n");
+        // Slot 0 is the main window, extra windows follow; they all go out in one submit and present.
+        VkSemaphore waitSemaphores[1 + MAX_WINDOWS];
+        VkSwapchainKHR swapchains[1 + MAX_WINDOWS];
+        uint32_t imageIndices[1 + MAX_WINDOWS];
+        VkPipelineStageFlags waitStages[1 + MAX_WINDOWS];
+        VkResult presentResults[1 + MAX_WINDOWS];
+        waitSemaphores[0] = engine->imageAvailableSemaphore;
+        swapchains[0] = engine->swapchain;
+        imageIndices[0] = imageIndex;
+        uint32_t targetCount = 1 + acquireWindows(engine, waitSemaphores + 1, swapchains + 1, imageIndices + 1);
+        reserveMeshViews(engine, targetCount);
+        for (uint32_t i = 0; i < targetCount; i++) waitStages[i] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+        if (!recordFrame(engine, imageIndex) || !submitFrame(engine, targetCount, waitSemaphores, waitStages)) {
+            abandonFrame(engine, targetCount, waitSemaphores, waitStages);
             continue;
         }
+        captureFrame(engine, deltaTime);
 
         VkPresentInfoKHR presentInfo = {
             .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
             .waitSemaphoreCount = 1,
             .pWaitSemaphores = &engine->renderFinishedSemaphore,
-            .swapchainCount = 1,
-            .pSwapchains = &engine->swapchain,
-            .pImageIndices = &imageIndex
+            .swapchainCount = targetCount,
+            .pSwapchains = swapchains,
+            .pImageIndices = imageIndices,
+            .pResults = presentResults
         };
 
-        result = vkQueuePresentKHR(engine->graphicsQueue, &presentInfo);
+        TRACE_ZONE_BEGIN(presentZone, "present");
+        for (uint32_t i = 0; i < targetCount; i++) presentResults[i] = VK_SUCCESS;
+        vkQueuePresentKHR(engine->graphicsQueue, &presentInfo);
+        TRACE_ZONE_END(presentZone);
+        if (!engine->firstFrameTime) firstFrameDone(engine);
+        windowsPresented(engine, presentResults + 1);
+        result = presentResults[0];
         if (result == VK_ERROR_OUT_OF_DATE_KHR) {
             recreateSwapChain(engine);
             continue;
         } else if (result != VK_SUCCESS) {
             fprintf(stderr, "Failed to present queue: %d\n", result);
         }
-        vkQueueWaitIdle(engine->graphicsQueue);
+        TRACE_CALL(vkQueueWaitIdle(engine->graphicsQueue));
+        gpuTraceCollect(engine);
+        resolutionCollect(engine);
+        engine->frameIndex++;
+        TRACE_ZONE_END(frameZone);
     }
 }
 
+// Renders one frame of a headless engine and waits for the GPU; submitTime is taken right after
+// the submit, so the caller can tell CPU cost from GPU cost.
+int renderHeadlessFrame(Engine* engine, uint64_t* submitTime) {
+    if (engine->window || !engine->swapchainImageViews || !engine->swapchainImageViews[0]) {
+        fprintf(stderr, "renderHeadlessFrame: not a headless engine\n");
+        return 0;
+    }
+
+    TRACE_ZONE_BEGIN(frameZone, "frame");
+    TRACE_CALL(engine_nodes_update(engine));
+    if (!recordFrame(engine, 0) || !submitFrame(engine, 0, NULL, NULL)) return 0;
+    *submitTime = traceNow();
+    TRACE_CALL(vkQueueWaitIdle(engine->graphicsQueue));
+    gpuTraceCollect(engine);
+    resolutionCollect(engine);
+    if (!engine->firstFrameTime) firstFrameDone(engine);
+    engine->frameIndex++;
+    TRACE_ZONE_END(frameZone);
+    return 1;
+}
+
+void recordVertices(Engine* engine, VkCommandBuffer commandBuffer, VkExtent2D extent, VkDescriptorSet descriptorSet) {
+    if (engine->vertexCount == 0 || engine->graphicsPipeline == VK_NULL_HANDLE) return;
+
+    VkViewport viewport = {0.0f, 0.0f, (float)extent.width, (float)extent.height, 0.0f, 1.0f};
+    VkRect2D scissor = {{0, 0}, extent};
+    VkBuffer vertexBuffers[] = {engine->vertexBuffer};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, engine->graphicsPipeline);
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, engine->pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+    vkCmdDraw(commandBuffer, engine->vertexCount, 1, 0, 0);
+}
+
+EXPORT void engine_request_close(Engine* engine) {
+    if (engine->window) glfwSetWindowShouldClose(engine->window, 1);
+}
+
 EXPORT void engine_set_clear_color(Engine* engine, float r, float g, float b, float a) {
+    if (engine->capture) captureCall(engine, CAPTURE_SET_CLEAR_COLOR, (CaptureWord[]){{.f = r}, {.f = g}, {.f = b}, {.f = a}}, 4, NULL, 0);
     engine->clearColor[0] = r;
     engine->clearColor[1] = g;
     engine->clearColor[2] = b;
@@ -316,6 +565,10 @@ EXPORT void engine_set_clear_color(Engine* engine, float r, float g, float b, fl
 }
 
 EXPORT void engine_set_vertices(Engine* engine, Vertex3D* vertices, uint32_t vertexCount) {
+    if (engine->capture) {
+        captureCall(engine, CAPTURE_SET_VERTICES, (CaptureWord[]){{.u = vertexCount}}, 1,
+                    (CaptureData[]){{vertices, (uint32_t)(sizeof(Vertex3D) * vertexCount)}}, 1);
+    }
     if (vertexCount > 1024) {
         fprintf(stderr, "Too many vertices, max is 1024\n");
         return;
@@ -339,18 +592,12 @@ EXPORT void engine_set_vertices(Engine* engine, Vertex3D* vertices, uint32_t ver
 }
 
 EXPORT void engine_set_view_matrix(Engine* engine, float* matrix) {
-    if (engine->uniformBufferMemory == VK_NULL_HANDLE) {
+    if (engine->capture) captureCall(engine, CAPTURE_SET_VIEW_MATRIX, NULL, 0, (CaptureData[]){{matrix, sizeof(float) * 16}}, 1);
+    if (engine->uniformBufferMapped == NULL) {
         fprintf(stderr, "Uniform buffer not initialized\n");
         return;
     }
 
-    void* data;
-    VkResult result = vkMapMemory(engine->device, engine->uniformBufferMemory, 0, sizeof(float) * 16, 0, &data);
-    if (result != VK_SUCCESS) {
-        fprintf(stderr, "Failed to map uniform buffer memory: %d\n", result);
-        return;
-    }
-
-    memcpy(data, matrix, sizeof(float) * 16);
-    vkUnmapMemory(engine->device, engine->uniformBufferMemory);
+    memcpy(engine->uniformBufferMapped, matrix, sizeof(float) * 16);
+    memcpy(engine->viewProj, matrix, sizeof(float) * 16);
 }
\ No newline at end of file
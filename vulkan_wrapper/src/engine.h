@@ -10,6 +10,24 @@
 #define EXPORT
 #endif
 
+#include "vmath.h"
+#include "lod.h"
+#include "filemap.h"
+#include "meshpack.h"
+#include "trace.h"
+#include "capture.h"
+
+#define MAX_TEXTURES 256
+#define TEXTURE_MAX_MIPS 16
+#define MAX_SPRITES 131072
+#define SPRITE_NO_TEXTURE 0xFFFF
+#define NODE_NONE 0xFFFFFFFFu
+#define MAX_MESHES 4096
+#define MAX_MESH_INSTANCES 65536
+#define DEFAULT_LOD_THRESHOLD 1.0f
+#define MAX_WINDOWS 8  // extra windows per engine, besides its own
+#define PREFERRED_SURFACE_FORMAT VK_FORMAT_B8G8R8A8_SRGB  // what pipelines are built for before a surface exists
+
 typedef void (*FrameCallback)(float deltaTime);
 
 typedef struct {
@@ -17,23 +35,110 @@ typedef struct {
     float r, g, b;
 } Vertex3D;
 
+// One quad per instance; the vertex shader expands it into two triangles.
+typedef struct {
+    float x, y, width, height;  // pixels, origin in the top-left corner
+    float u0, v0, u1, v1;
+    uint32_t color;             // RGBA8, red in the lowest byte
+    uint16_t layer;
+    uint16_t texture;           // SPRITE_NO_TEXTURE for untextured quads
+} SpriteInstance;
+
+// Texture pack container: header, textureCount entries, then mip payloads.
+// Mip payloads are stored exactly as vkCmdCopyBufferToImage expects them.
+typedef struct {
+    char magic[4];  // "DFTP"
+    uint32_t version;
+    uint32_t textureCount;
+    uint32_t reserved;
+} TexturePackHeader;
+
+typedef struct {
+    uint64_t offset;
+    uint64_t size;
+} TexturePackMip;
+
+typedef struct {
+    uint32_t format;  // VkFormat, BCn or R8G8B8A8
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipCount;
+    TexturePackMip mips[TEXTURE_MAX_MIPS];
+} TexturePackEntry;
+
+typedef struct TextureSystem TextureSystem;
+typedef struct SpriteBatch SpriteBatch;
+typedef struct NodeStore NodeStore;
+typedef struct MeshSystem MeshSystem;
+typedef struct OcclusionSystem OcclusionSystem;
+typedef struct GpuTrace GpuTrace;
+typedef struct DynamicResolution DynamicResolution;
+typedef struct DeviceContext DeviceContext;
+typedef struct WindowSystem WindowSystem;
+typedef struct RenderGraph RenderGraph;
+typedef struct Capture Capture;
+typedef struct InitGraph InitGraph;
+
+// A presentable window surface with its images; the main window and every extra window own one.
+typedef struct {
+    VkSwapchainKHR swapchain;
+    VkImage* images;
+    VkImageView* imageViews;
+    uint32_t imageCount;
+    VkFormat format;
+    VkExtent2D extent;
+} SurfaceSwapchain;
+
+// World-space bounding sphere of one visible instance. `command` is the indirect draw the
+// instance is appended to; its matrix sits at the same index in OcclusionBuffers.matrices.
+typedef struct {
+    float sphere[4];
+    uint32_t command;
+    uint32_t reserved[3];
+} OcclusionCandidate;
+
+// Host-visible inputs of the GPU cull, filled by the mesh system every frame. Phase 1 commands
+// live at commands[0..], phase 2 commands at commands[MAX_MESH_INSTANCES..].
+typedef struct {
+    OcclusionCandidate* candidates;
+    Mat4* matrices;
+    VkDrawIndexedIndirectCommand* commands;
+    VkBuffer commandBuffer;
+    VkBuffer visibleBuffer;  // culled matrices, bound as the per-instance vertex stream
+} OcclusionBuffers;
+
+#define MAX_INIT_STAGES 32
+
+typedef struct {
+    const char* name;
+    uint64_t start;     // nanoseconds since engine_create was entered
+    uint64_t duration;
+    uint32_t thread;    // 0 is the creating thread, init workers count from 1
+} InitStage;
+
 typedef struct {
     GLFWwindow* window;
+    DeviceContext* context;
     VkInstance instance;
     VkPhysicalDevice physicalDevice;
     VkDevice device;
     VkQueue graphicsQueue;
+    VkPipelineCache pipelineCache;
     VkSurfaceKHR surface;
     VkSwapchainKHR swapchain;
     VkImage* swapchainImages;
     uint32_t swapchainImageCount;
     VkImageView* swapchainImageViews;
     VkExtent2D swapchainExtent;
+    VkExtent2D renderExtent;  // area the scene is drawn into, smaller than the swapchain with dynamic resolution
     VkFormat swapchainImageFormat;
+    VkDeviceMemory offscreenMemory;  // headless engines render into a single offscreen image
+    VkFormat renderPassFormat;  // colour format the pipelines are built for, chosen before the swapchain exists
     VkRenderPass renderPass;
+    VkFormat depthFormat;
+    int depthSampled;
     VkPipelineLayout pipelineLayout;
     VkPipeline graphicsPipeline;
-    VkFramebuffer* framebuffers;
     VkCommandPool commandPool;
     VkCommandBuffer commandBuffer;
     VkSemaphore imageAvailableSemaphore;
@@ -44,31 +149,219 @@ typedef struct {
     uint32_t vertexCount;
     VkBuffer uniformBuffer;
     VkDeviceMemory uniformBufferMemory;
+    void* uniformBufferMapped;
     VkDescriptorSetLayout descriptorSetLayout;
     VkDescriptorPool descriptorPool;
     VkDescriptorSet descriptorSet;
+    TextureSystem* textures;
+    uint64_t frameIndex;
+    VkPipelineLayout spritePipelineLayout;
+    VkPipeline spritePipeline;
+    SpriteBatch* sprites;
+    NodeStore* nodes;
+    float viewProj[16];
+    VkPipeline meshPipelines[MESH_LAYOUT_COUNT];  // one per vertex layout
+    MeshSystem* meshes;
+    float lodThreshold;     // kept here so it can be set before the mesh system exists
+    OcclusionSystem* occlusion;
+    int occlusionDisabled;  // engine_set_occlusion_culling(0) before the system was created
+    GpuTrace* gpuTrace;
+    DynamicResolution* resolution;
+    WindowSystem* windows;
+    RenderGraph* graph;
+    Capture* capture;
+    uint64_t createStart;
+    uint64_t firstFrameTime;  // nanoseconds from engine_create to the first presented frame
+    InitStage initStages[MAX_INIT_STAGES];
+    uint32_t initStageCount;
 } Engine;
 
+#define GRAPH_NONE UINT32_MAX
+
+// How a render graph pass touches a resource. The graph derives pipeline stages, access masks,
+// image layouts and attachment load/store ops from it.
+typedef enum {
+    GRAPH_ACCESS_NONE,              // import/export only: contents are not needed
+    GRAPH_ACCESS_COLOR_ATTACHMENT,
+    GRAPH_ACCESS_DEPTH_ATTACHMENT,
+    GRAPH_ACCESS_DEPTH_SAMPLED,     // read by a compute shader in the read-only depth layout
+    GRAPH_ACCESS_COMPUTE_READ,
+    GRAPH_ACCESS_COMPUTE_WRITE,
+    GRAPH_ACCESS_INDIRECT_READ,     // indirect commands and per-instance vertex data
+    GRAPH_ACCESS_TRANSFER_WRITE,
+    GRAPH_ACCESS_TRANSFER_READ,
+    GRAPH_ACCESS_PRESENT,
+    GRAPH_ACCESS_COUNT
+} GraphAccess;
+
+typedef enum {
+    GRAPH_PASS_GRAPHICS,  // recorded inside a render pass over its attachments
+    GRAPH_PASS_COMPUTE,
+    GRAPH_PASS_TRANSFER
+} GraphPassType;
+
+typedef void (*GraphRecordFn)(Engine* engine, VkCommandBuffer commandBuffer, void* userData);
+
+// One step of engine creation. Tasks without a run function are completed by the caller.
+typedef struct {
+    const char* name;
+    void (*run)(Engine* engine);
+    uint32_t dependencies;  // bit mask of earlier task indices that must finish first
+    int mainThread;         // GLFW calls and queue submissions stay on the creating thread
+} InitTask;
+
 EXPORT Engine* engine_create(int width, int height, const char* title);
 EXPORT void engine_destroy(Engine* engine);
 EXPORT void engine_run(Engine* engine, FrameCallback callback);
 EXPORT void engine_set_clear_color(Engine* engine, float r, float g, float b, float a);
 EXPORT void engine_set_vertices(Engine* engine, Vertex3D* vertices, uint32_t vertexCount);
 EXPORT void engine_set_view_matrix(Engine* engine, float* matrix);
+EXPORT int32_t engine_texture_pack_open(Engine* engine, const char* path, uint32_t* textureCount);
+EXPORT void engine_texture_touch(Engine* engine, uint32_t texture);
+EXPORT void engine_texture_set_budget(Engine* engine, uint64_t bytes);
+EXPORT uint64_t engine_texture_resident_bytes(Engine* engine);
+EXPORT void engine_set_sprites(Engine* engine, const SpriteInstance* sprites, uint32_t spriteCount);
+EXPORT void engine_request_close(Engine* engine);
+EXPORT uint32_t engine_node_create(Engine* engine, uint32_t parent);
+EXPORT void engine_node_destroy(Engine* engine, uint32_t node);
+EXPORT int engine_node_set_parent(Engine* engine, uint32_t node, uint32_t parent);
+EXPORT void engine_node_set_translation(Engine* engine, uint32_t node, float x, float y, float z);
+EXPORT void engine_node_set_rotation(Engine* engine, uint32_t node, float x, float y, float z, float w);
+EXPORT void engine_node_set_scale(Engine* engine, uint32_t node, float x, float y, float z);
+EXPORT void engine_nodes_set_translations(Engine* engine, const uint32_t* nodes, const float* translations, uint32_t count);
+EXPORT void engine_nodes_update(Engine* engine);
+EXPORT int engine_node_world_matrix(Engine* engine, uint32_t node, float* out);
+EXPORT uint32_t engine_node_count(Engine* engine);
+EXPORT int32_t engine_mesh_create(Engine* engine, const Vertex3D* vertices, uint32_t vertexCount,
+                                  const uint32_t* indices, uint32_t indexCount, float lodMaxError);
+EXPORT int32_t engine_mesh_create_layout(Engine* engine, const Vertex3D* vertices, uint32_t vertexCount,
+                                         const uint32_t* indices, uint32_t indexCount, float lodMaxError,
+                                         uint32_t layout);
+EXPORT int32_t engine_mesh_pack_open(Engine* engine, const char* path, uint32_t* meshCount);
+EXPORT uint32_t engine_mesh_lod_count(Engine* engine, int32_t mesh);
+EXPORT int32_t engine_mesh_instance_create(Engine* engine, int32_t mesh, uint32_t node);
+EXPORT void engine_mesh_instance_destroy(Engine* engine, int32_t instance);
+EXPORT void engine_set_lod_threshold(Engine* engine, float pixels);
+EXPORT uint64_t engine_mesh_drawn_triangles(Engine* engine);
+EXPORT void engine_set_occlusion_culling(Engine* engine, int enabled);
+EXPORT void engine_occlusion_stats(Engine* engine, uint32_t* stats);
+EXPORT int engine_trace_begin(const char* path);
+EXPORT int64_t engine_trace_end(void);
+EXPORT int32_t engine_window_create(Engine* engine, int width, int height, const char* title);
+EXPORT void engine_window_destroy(Engine* engine, int32_t window);
+EXPORT int engine_window_is_open(Engine* engine, int32_t window);
+EXPORT void engine_window_set_view_matrix(Engine* engine, int32_t window, const float* matrix);
+EXPORT void engine_render_graph_stats(Engine* engine, uint64_t* stats);
+EXPORT Engine* engine_create_headless(int width, int height);
+EXPORT int engine_capture_begin(Engine* engine, const char* path);
+EXPORT int64_t engine_capture_end(Engine* engine);
+EXPORT int64_t engine_replay(const char* path, ReplayFrameCallback callback, void* userData);
+EXPORT const char* engine_init_stage(Engine* engine, uint32_t index, uint64_t* timings);
+EXPORT uint64_t engine_time_to_first_frame(Engine* engine);
+EXPORT void engine_set_dynamic_resolution(Engine* engine, float targetMilliseconds, float minScale);
+EXPORT float engine_render_scale(Engine* engine);
+EXPORT float engine_gpu_frame_time(Engine* engine);
 
 
+int acquireDeviceContext(Engine* engine, const char* applicationName, int headless);
+void releaseDeviceContext(Engine* engine);
+int createSurfaceSwapchain(Engine* engine, GLFWwindow* window, VkSurfaceKHR surface, SurfaceSwapchain* out);
+void destroySurfaceSwapchain(Engine* engine, SurfaceSwapchain* swapchain);
 void createSwapChain(Engine* engine);
 void createRenderPass(Engine* engine);
-void createFramebuffers(Engine* engine);
 void createCommandPoolAndBuffers(Engine* engine);
 void createSyncObjects(Engine* engine);
 void createVertexBuffer(Engine* engine);
 void createUniformBuffer(Engine* engine);
+void createPipelineLayout(Engine* engine);
 void createGraphicsPipeline(Engine* engine);
+void createSpritePipeline(Engine* engine);
 void createDescriptorPool(Engine* engine);
 void createDescriptorSet(Engine* engine);
 void createDescriptorSetLayout(Engine* engine);
+void createTextureSystem(Engine* engine);
+void destroyTextureSystem(Engine* engine);
+void updateTextureStreaming(Engine* engine, VkCommandBuffer commandBuffer);
+void touchTexture(Engine* engine, uint32_t texture);
+void createSpriteBatch(Engine* engine);
+void destroySpriteBatch(Engine* engine);
+void recordSprites(Engine* engine, VkCommandBuffer commandBuffer);
+void createNodeStore(Engine* engine);
+void destroyNodeStore(Engine* engine);
+uint32_t nodeIndex(Engine* engine, uint32_t node);
+const float* nodeWorldMatrix(Engine* engine, uint32_t index);
+void createMeshSystem(Engine* engine);
+void destroyMeshSystem(Engine* engine);
+void createMeshPipelines(Engine* engine);
+int32_t createMesh(Engine* engine, const Vertex3D* vertices, uint32_t vertexCount, uint32_t layout,
+                   const uint32_t* indices, uint32_t indexCount, const MeshLod* lods, uint32_t lodCount,
+                   const float* bounds);
+void prepareMeshes(Engine* engine);
+void cullMeshes(Engine* engine, VkCommandBuffer commandBuffer, uint32_t phase);
+void recordMeshes(Engine* engine, VkCommandBuffer commandBuffer, uint32_t phase);
+void reserveMeshViews(Engine* engine, uint32_t views);
+void recordMeshesView(Engine* engine, VkCommandBuffer commandBuffer, const float* viewProj, VkExtent2D extent,
+                      VkDescriptorSet descriptorSet);
+void recordVertices(Engine* engine, VkCommandBuffer commandBuffer, VkExtent2D extent, VkDescriptorSet descriptorSet);
+void createOcclusionSystem(Engine* engine);
+void destroyOcclusionSystem(Engine* engine);
+const OcclusionBuffers* beginOcclusionFrame(Engine* engine);
+uint32_t importHiZ(Engine* engine, RenderGraph* graph);
+void bindOcclusionDepth(Engine* engine, VkImageView depthView);
+void invalidateHiZ(Engine* engine);
+void cullOcclusion(Engine* engine, VkCommandBuffer commandBuffer, uint32_t phase, uint32_t candidateCount);
+void buildHiZ(Engine* engine, VkCommandBuffer commandBuffer);
+void createGpuTrace(Engine* engine);
+void destroyGpuTrace(Engine* engine);
+void gpuTraceFrameBegin(Engine* engine, VkCommandBuffer commandBuffer);
+void gpuTraceFrameEnd(Engine* engine, VkCommandBuffer commandBuffer);
+uint32_t gpuZoneBegin(Engine* engine, VkCommandBuffer commandBuffer, const char* name);
+void gpuZoneEnd(Engine* engine, VkCommandBuffer commandBuffer, uint32_t zone);
+void gpuTraceCollect(Engine* engine);
+void createDynamicResolution(Engine* engine);
+void destroyDynamicResolution(Engine* engine);
+int updateRenderExtent(Engine* engine);
+void resolutionFrameBegin(Engine* engine, VkCommandBuffer commandBuffer);
+void resolutionFrameEnd(Engine* engine, VkCommandBuffer commandBuffer);
+void resolutionCollect(Engine* engine);
+void addUpscalePass(Engine* engine, RenderGraph* graph, uint32_t scene, uint32_t target);
+void destroyWindowSystem(Engine* engine);
+uint32_t acquireWindows(Engine* engine, VkSemaphore* waitSemaphores, VkSwapchainKHR* swapchains, uint32_t* imageIndices);
+void addWindowPasses(Engine* engine, RenderGraph* graph);
+void windowsPresented(Engine* engine, const VkResult* results);
+void windowsAbandoned(Engine* engine);
+void createRenderGraph(Engine* engine);
+void destroyRenderGraph(Engine* engine);
+void graphInvalidate(Engine* engine);
+void graphBegin(RenderGraph* graph);
+uint32_t graphImportImage(RenderGraph* graph, const char* name, VkImage image, VkImageView view, VkFormat format,
+                          VkExtent2D extent, GraphAccess initial, GraphAccess final);
+uint32_t graphImportBuffer(RenderGraph* graph, const char* name, GraphAccess initial, GraphAccess final);
+uint32_t graphCreateImage(RenderGraph* graph, const char* name, VkFormat format, VkExtent2D extent);
+uint32_t graphAddPass(RenderGraph* graph, const char* name, GraphPassType type, GraphRecordFn record, void* userData);
+void graphUse(RenderGraph* graph, uint32_t pass, uint32_t resource, GraphAccess access);
+void graphClear(RenderGraph* graph, uint32_t pass, uint32_t resource, GraphAccess access, VkClearValue value);
+void graphSideEffects(RenderGraph* graph, uint32_t pass);
+int graphCompile(Engine* engine, RenderGraph* graph);
+void graphRenderArea(RenderGraph* graph, uint32_t pass, VkExtent2D area);
+VkImage graphImage(RenderGraph* graph, uint32_t resource);
+VkImageView graphImageView(RenderGraph* graph, uint32_t resource);
+void graphExecute(Engine* engine, RenderGraph* graph, VkCommandBuffer commandBuffer);
+void captureCall(Engine* engine, uint32_t call, const CaptureWord* words, uint32_t wordCount,
+                 const CaptureData* data, uint32_t dataCount);
+void captureFrame(Engine* engine, float deltaTime);
+int renderHeadlessFrame(Engine* engine, uint64_t* submitTime);
+InitGraph* beginInitGraph(Engine* engine, const InitTask* tasks, uint32_t taskCount);
+void completeInitTask(InitGraph* graph, uint32_t task, uint64_t start, int succeeded);
+void endInitGraph(InitGraph* graph);
+void recordInitStage(Engine* engine, const char* name, uint64_t start);
+void createLazily(Engine* engine, const char* name, void (*create)(Engine* engine));
 
+uint32_t findMemoryType(Engine* engine, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+VkResult createBuffer(Engine* engine, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                      VkBuffer* buffer, VkDeviceMemory* memory);
+VkCommandBuffer beginSingleTimeCommands(Engine* engine);
+void endSingleTimeCommands(Engine* engine, VkCommandBuffer commandBuffer);
 
 VkShaderModule createShaderModule(VkDevice device, const char* filename);
 
@@ -0,0 +1,17 @@
+#ifndef FILEMAP_H
+#define FILEMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Read-only memory mapping of a whole file; shared by the engine and the offline tools.
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    void* handle;
+} MappedFile;
+
+int mapFile(const char* path, MappedFile* file);
+void unmapFile(MappedFile* file);
+
+#endif
@@ -0,0 +1,127 @@
+#include "engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define GPU_TRACE_MAX_ZONES 32
+
+// Timestamp ranges for one frame. Queries 2 * i and 2 * i + 1 bracket zone i; zone 0 spans the
+// whole command buffer and anchors the GPU clock to the CPU time of the submit.
+struct GpuTrace {
+    VkQueryPool queryPool;
+    double nanosecondsPerTick;
+    uint64_t timestampMask;
+    const char* names[GPU_TRACE_MAX_ZONES];
+    uint32_t zoneCount;
+    uint32_t frameZone;
+    uint64_t submitTime;
+    int recording;
+};
+
+void createGpuTrace(Engine* engine) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(engine->physicalDevice, &properties);
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(engine->physicalDevice, &familyCount, NULL);
+    VkQueueFamilyProperties* families = (VkQueueFamilyProperties*)malloc(sizeof(VkQueueFamilyProperties) * familyCount);
+    if (!families) return;
+    vkGetPhysicalDeviceQueueFamilyProperties(engine->physicalDevice, &familyCount, families);
+    uint32_t validBits = familyCount > 0 ? families[0].timestampValidBits : 0;
+    free(families);
+
+    if (validBits == 0 || properties.limits.timestampPeriod <= 0.0f) {
+        fprintf(stderr, "GPU timestamps are not supported, GPU tracing disabled\n");
+        return;
+    }
+
+    GpuTrace* trace = (GpuTrace*)calloc(1, sizeof(GpuTrace));
+    if (!trace) {
+        fprintf(stderr, "Failed to allocate memory for GPU trace\n");
+        return;
+    }
+    trace->nanosecondsPerTick = properties.limits.timestampPeriod;
+    trace->timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+
+    VkQueryPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = GPU_TRACE_MAX_ZONES * 2
+    };
+
+    if (vkCreateQueryPool(engine->device, &poolInfo, NULL, &trace->queryPool) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create timestamp query pool\n");
+        free(trace);
+        return;
+    }
+    engine->gpuTrace = trace;
+}
+
+void destroyGpuTrace(Engine* engine) {
+    GpuTrace* trace = engine->gpuTrace;
+    if (!trace) return;
+
+    if (trace->queryPool) vkDestroyQueryPool(engine->device, trace->queryPool, NULL);
+    free(trace);
+    engine->gpuTrace = NULL;
+}
+
+// Must be recorded outside a render pass, before any other zone of the frame.
+void gpuTraceFrameBegin(Engine* engine, VkCommandBuffer commandBuffer) {
+    GpuTrace* trace = engine->gpuTrace;
+    if (!trace) return;
+
+    trace->zoneCount = 0;
+    trace->recording = traceEnabled != 0;
+    if (!trace->recording) return;
+
+    vkCmdResetQueryPool(commandBuffer, trace->queryPool, 0, GPU_TRACE_MAX_ZONES * 2);
+    trace->frameZone = gpuZoneBegin(engine, commandBuffer, "frame");
+}
+
+uint32_t gpuZoneBegin(Engine* engine, VkCommandBuffer commandBuffer, const char* name) {
+    GpuTrace* trace = engine->gpuTrace;
+    if (!trace || !trace->recording || trace->zoneCount == GPU_TRACE_MAX_ZONES) return UINT32_MAX;
+
+    uint32_t zone = trace->zoneCount++;
+    trace->names[zone] = name;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, trace->queryPool, zone * 2);
+    return zone;
+}
+
+void gpuZoneEnd(Engine* engine, VkCommandBuffer commandBuffer, uint32_t zone) {
+    GpuTrace* trace = engine->gpuTrace;
+    if (!trace || zone >= trace->zoneCount) return;
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, trace->queryPool, zone * 2 + 1);
+}
+
+void gpuTraceFrameEnd(Engine* engine, VkCommandBuffer commandBuffer) {
+    GpuTrace* trace = engine->gpuTrace;
+    if (!trace || !trace->recording) return;
+
+    gpuZoneEnd(engine, commandBuffer, trace->frameZone);
+    trace->submitTime = traceNow();
+}
+
+// Called once the frame has finished executing. Without calibrated timestamps the GPU clock is
+// aligned so the frame starts at the submit; ranges are exact relative to each other.
+void gpuTraceCollect(Engine* engine) {
+    GpuTrace* trace = engine->gpuTrace;
+    if (!trace || !trace->recording || trace->zoneCount == 0) return;
+    trace->recording = 0;
+
+    uint64_t timestamps[GPU_TRACE_MAX_ZONES * 2];
+    if (vkGetQueryPoolResults(engine->device, trace->queryPool, 0, trace->zoneCount * 2, sizeof(timestamps), timestamps,
+                              sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return;
+    }
+
+    uint64_t origin = timestamps[trace->frameZone * 2] & trace->timestampMask;
+    for (uint32_t i = 0; i < trace->zoneCount; i++) {
+        uint64_t begin = (timestamps[i * 2] & trace->timestampMask) - origin;
+        uint64_t end = (timestamps[i * 2 + 1] & trace->timestampMask) - origin;
+        if (end < begin) continue;
+        traceEmit(trace->names[i], trace->submitTime + (uint64_t)((double)begin * trace->nanosecondsPerTick),
+                  (uint64_t)((double)(end - begin) * trace->nanosecondsPerTick), TRACE_TRACK_GPU);
+    }
+}
@@ -0,0 +1,226 @@
+#include "engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#define INIT_WORKERS 3
+
+// Engine creation as a dependency graph. Workers take whatever is ready while the creating thread
+// makes the window, then the creating thread joins in and also runs the tasks that must stay on
+// it. Picking a task is a scan over at most 32 entries under one lock, which is nothing next to
+// the Vulkan calls the tasks make.
+struct InitGraph {
+    Engine* engine;
+    const InitTask* tasks;
+    uint32_t taskCount;
+    uint32_t workerTasks;  // bit masks of task indices
+    uint32_t started;
+    uint32_t finished;
+    uint32_t failed;
+    uint32_t workerCount;
+    uint32_t nextThread;
+    InitStage stages[MAX_INIT_STAGES];
+#ifdef _WIN32
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE changed;
+    HANDLE workers[INIT_WORKERS];
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t workers[INIT_WORKERS];
+#endif
+};
+
+#ifdef _WIN32
+static void lockGraph(InitGraph* graph) { EnterCriticalSection(&graph->lock); }
+static void unlockGraph(InitGraph* graph) { LeaveCriticalSection(&graph->lock); }
+static void waitGraph(InitGraph* graph) { SleepConditionVariableCS(&graph->changed, &graph->lock, INFINITE); }
+static void wakeGraph(InitGraph* graph) { WakeAllConditionVariable(&graph->changed); }
+#else
+static void lockGraph(InitGraph* graph) { pthread_mutex_lock(&graph->lock); }
+static void unlockGraph(InitGraph* graph) { pthread_mutex_unlock(&graph->lock); }
+static void waitGraph(InitGraph* graph) { pthread_cond_wait(&graph->changed, &graph->lock); }
+static void wakeGraph(InitGraph* graph) { pthread_cond_broadcast(&graph->changed); }
+#endif
+
+// Tasks that depend on a failed one are skipped; dependencies point backwards, so one pass in
+// index order propagates a failure all the way down.
+static int32_t takeTask(InitGraph* graph, int mainThread) {
+    for (uint32_t i = 0; i < graph->taskCount; i++) {
+        const InitTask* task = &graph->tasks[i];
+        uint32_t bit = 1u << i;
+        if ((graph->started & bit) || !task->run) continue;
+        if (task->dependencies & graph->failed) {
+            graph->started |= bit;
+            graph->finished |= bit;
+            graph->failed |= bit;
+            wakeGraph(graph);
+            continue;
+        }
+        if ((graph->finished & task->dependencies) != task->dependencies) continue;
+        if (task->mainThread && !mainThread) continue;
+        graph->started |= bit;
+        return (int32_t)i;
+    }
+    return -1;
+}
+
+static void runTasks(InitGraph* graph, int mainThread) {
+    uint32_t all = graph->taskCount == 32 ? UINT32_MAX : (1u << graph->taskCount) - 1;
+    lockGraph(graph);
+    uint32_t thread = mainThread ? 0 : ++graph->nextThread;
+    for (;;) {
+        int32_t index = takeTask(graph, mainThread);
+        if (index < 0) {
+            if (mainThread ? graph->finished == all : (graph->started & graph->workerTasks) == graph->workerTasks) break;
+            waitGraph(graph);
+            continue;
+        }
+        unlockGraph(graph);
+
+        const InitTask* task = &graph->tasks[index];
+        uint64_t start = traceNow();
+        TRACE_ZONE_BEGIN(taskZone, task->name);
+        task->run(graph->engine);
+        TRACE_ZONE_END(taskZone);
+        uint64_t end = traceNow();
+
+        lockGraph(graph);
+        graph->stages[index] = (InitStage){task->name, start - graph->engine->createStart, end - start, thread};
+        graph->finished |= 1u << index;
+        wakeGraph(graph);
+    }
+    unlockGraph(graph);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI workerMain(LPVOID argument) {
+    traceThreadName("init worker");
+    runTasks((InitGraph*)argument, 0);
+    return 0;
+}
+#else
+static void* workerMain(void* argument) {
+    traceThreadName("init worker");
+    runTasks((InitGraph*)argument, 0);
+    return NULL;
+}
+#endif
+
+// Starts the workers on every task they can take. If threads cannot be started the creating
+// thread runs the whole graph in endInitGraph.
+InitGraph* beginInitGraph(Engine* engine, const InitTask* tasks, uint32_t taskCount) {
+    if (taskCount > MAX_INIT_STAGES || taskCount > 32) {
+        fprintf(stderr, "Too many init tasks, max is %d\n", MAX_INIT_STAGES);
+        return NULL;
+    }
+
+    InitGraph* graph = (InitGraph*)calloc(1, sizeof(InitGraph));
+    if (!graph) {
+        fprintf(stderr, "Failed to allocate memory for init graph\n");
+        return NULL;
+    }
+    graph->engine = engine;
+    graph->tasks = tasks;
+    graph->taskCount = taskCount;
+    for (uint32_t i = 0; i < taskCount; i++) {
+        if (tasks[i].run && !tasks[i].mainThread) graph->workerTasks |= 1u << i;
+    }
+
+#ifdef _WIN32
+    InitializeCriticalSection(&graph->lock);
+    InitializeConditionVariable(&graph->changed);
+    for (uint32_t i = 0; i < INIT_WORKERS; i++) {
+        graph->workers[i] = CreateThread(NULL, 0, workerMain, graph, 0, NULL);
+        if (!graph->workers[i]) {
+            fprintf(stderr, "Failed to start init worker %u\n", i);
+            break;
+        }
+        graph->workerCount++;
+    }
+#else
+    pthread_mutex_init(&graph->lock, NULL);
+    pthread_cond_init(&graph->changed, NULL);
+    for (uint32_t i = 0; i < INIT_WORKERS; i++) {
+        if (pthread_create(&graph->workers[i], NULL, workerMain, graph) != 0) {
+            fprintf(stderr, "Failed to start init worker %u\n", i);
+            break;
+        }
+        graph->workerCount++;
+    }
+#endif
+    return graph;
+}
+
+// Marks a task without a run function as done; `start` is when the caller began it.
+void completeInitTask(InitGraph* graph, uint32_t task, uint64_t start, int succeeded) {
+    uint64_t end = traceNow();
+    lockGraph(graph);
+    graph->stages[task] = (InitStage){graph->tasks[task].name, start - graph->engine->createStart, end - start, 0};
+    graph->started |= 1u << task;
+    graph->finished |= 1u << task;
+    if (!succeeded) graph->failed |= 1u << task;
+    wakeGraph(graph);
+    unlockGraph(graph);
+}
+
+// Runs what is left on the creating thread, waits for the workers and appends the stage timings
+// to the engine.
+void endInitGraph(InitGraph* graph) {
+    for (uint32_t i = 0; i < graph->taskCount; i++) {
+        if (!graph->tasks[i].run && !(graph->finished & (1u << i))) completeInitTask(graph, i, traceNow(), 0);
+    }
+    runTasks(graph, 1);
+
+#ifdef _WIN32
+    if (graph->workerCount) WaitForMultipleObjects(graph->workerCount, graph->workers, TRUE, INFINITE);
+    for (uint32_t i = 0; i < graph->workerCount; i++) CloseHandle(graph->workers[i]);
+    DeleteCriticalSection(&graph->lock);
+#else
+    for (uint32_t i = 0; i < graph->workerCount; i++) pthread_join(graph->workers[i], NULL);
+    pthread_cond_destroy(&graph->changed);
+    pthread_mutex_destroy(&graph->lock);
+#endif
+
+    Engine* engine = graph->engine;
+    for (uint32_t i = 0; i < graph->taskCount && engine->initStageCount < MAX_INIT_STAGES; i++) {
+        if (graph->stages[i].name) engine->initStages[engine->initStageCount++] = graph->stages[i];
+    }
+    free(graph);
+}
+
+// Stages outside the graph: the device context, and resources created on first use.
+void recordInitStage(Engine* engine, const char* name, uint64_t start) {
+    if (engine->initStageCount == MAX_INIT_STAGES) return;
+    engine->initStages[engine->initStageCount++] = (InitStage){name, start - engine->createStart, traceNow() - start, 0};
+}
+
+// Subsystems most applications use only some of are created by the first call that needs them.
+void createLazily(Engine* engine, const char* name, void (*create)(Engine* engine)) {
+    uint64_t start = traceNow();
+    TRACE_ZONE_BEGIN(createZone, name);
+    create(engine);
+    TRACE_ZONE_END(createZone);
+    recordInitStage(engine, name, start);
+}
+
+// Fills timings with [start, duration] in nanoseconds since engine_create and the thread that ran
+// the stage (0 is the creating thread). Returns the stage name, or NULL past the last stage.
+EXPORT const char* engine_init_stage(Engine* engine, uint32_t index, uint64_t* timings) {
+    if (index >= engine->initStageCount) return NULL;
+    const InitStage* stage = &engine->initStages[index];
+    timings[0] = stage->start;
+    timings[1] = stage->duration;
+    timings[2] = stage->thread;
+    return stage->name;
+}
+
+// Nanoseconds from entering engine_create to the first presented frame, 0 before it.
+EXPORT uint64_t engine_time_to_first_frame(Engine* engine) {
+    return engine->firstFrameTime;
+}
@@ -0,0 +1,283 @@
+#include "lod.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Collapses that tilt a neighbouring triangle's normal further than this (cosine) are rejected.
+#define LOD_MIN_NORMAL_DOT 0.2
+// A coarser level must drop at least this fraction of the previous level's indices.
+#define LOD_MIN_REDUCTION 0.75
+
+typedef struct {
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+} Quadric;
+
+typedef struct {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+} Collapse;
+
+static const float* vertexPosition(const float* positions, size_t stride, uint32_t v) {
+    return (const float*)((const char*)positions + (size_t)v * stride);
+}
+
+static void quadricAdd(Quadric* q, const Quadric* other) {
+    q->a2 += other->a2; q->ab += other->ab; q->ac += other->ac; q->ad += other->ad;
+    q->b2 += other->b2; q->bc += other->bc; q->bd += other->bd;
+    q->c2 += other->c2; q->cd += other->cd; q->d2 += other->d2;
+}
+
+static double quadricError(const Quadric* q, const float* p) {
+    double x = p[0], y = p[1], z = p[2];
+    double e = q->a2 * x * x + 2.0 * q->ab * x * y + 2.0 * q->ac * x * z + 2.0 * q->ad * x +
+               q->b2 * y * y + 2.0 * q->bc * y * z + 2.0 * q->bd * y +
+               q->c2 * z * z + 2.0 * q->cd * z + q->d2;
+    return e > 0.0 ? e : 0.0;
+}
+
+static void triangleNormal(double* n, const float* p0, const float* p1, const float* p2) {
+    double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+static int compareCollapse(const void* a, const void* b) {
+    double ca = ((const Collapse*)a)->cost;
+    double cb = ((const Collapse*)b)->cost;
+    return (ca > cb) - (ca < cb);
+}
+
+static uint64_t edgeKey(uint32_t a, uint32_t b) {
+    return ((uint64_t)a << 32) | b;
+}
+
+static uint32_t edgeHash(uint64_t key, uint32_t mask) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (uint32_t)key & mask;
+}
+
+// Every vertex on an edge without a matching opposite half-edge is locked in place.
+static int lockBorderVertices(uint8_t* locked, const uint32_t* indices, uint32_t indexCount) {
+    uint32_t capacity = 16;
+    while (capacity < indexCount * 2) capacity *= 2;
+    uint64_t* table = (uint64_t*)malloc(sizeof(uint64_t) * capacity);
+    if (!table) return 0;
+    memset(table, 0xFF, sizeof(uint64_t) * capacity);
+
+    uint32_t mask = capacity - 1;
+    for (uint32_t i = 0; i < indexCount; i++) {
+        uint32_t a = indices[i];
+        uint32_t b = indices[i % 3 == 2 ? i - 2 : i + 1];
+        uint64_t key = edgeKey(a, b);
+        uint32_t slot = edgeHash(key, mask);
+        while (table[slot] != UINT64_MAX && table[slot] != key) slot = (slot + 1) & mask;
+        table[slot] = key;
+    }
+
+    for (uint32_t i = 0; i < indexCount; i++) {
+        uint32_t a = indices[i];
+        uint32_t b = indices[i % 3 == 2 ? i - 2 : i + 1];
+        uint64_t key = edgeKey(b, a);
+        uint32_t slot = edgeHash(key, mask);
+        while (table[slot] != UINT64_MAX && table[slot] != key) slot = (slot + 1) & mask;
+        if (table[slot] != key) {
+            locked[a] = 1;
+            locked[b] = 1;
+        }
+    }
+
+    free(table);
+    return 1;
+}
+
+// Triangles around `from` must keep their orientation once `from` moves onto `to`.
+static int collapseFlips(const uint32_t* indices, const uint32_t* adjacency, uint32_t begin, uint32_t end,
+                         uint32_t from, uint32_t to, const float* positions, size_t stride) {
+    const float* target = vertexPosition(positions, stride, to);
+    for (uint32_t k = begin; k < end; k++) {
+        const uint32_t* tri = indices + adjacency[k] * 3;
+        if (tri[0] == to || tri[1] == to || tri[2] == to) continue;
+
+        const float* p[3];
+        const float* q[3];
+        for (int c = 0; c < 3; c++) {
+            p[c] = vertexPosition(positions, stride, tri[c]);
+            q[c] = tri[c] == from ? target : p[c];
+        }
+        double before[3], after[3];
+        triangleNormal(before, p[0], p[1], p[2]);
+        triangleNormal(after, q[0], q[1], q[2]);
+        double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+        double lengths = sqrt((before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) *
+                              (after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+        if (dot <= LOD_MIN_NORMAL_DOT * lengths) return 1;
+    }
+    return 0;
+}
+
+uint32_t simplifyMesh(uint32_t* destination, const uint32_t* indices, uint32_t indexCount,
+                      const float* positions, uint32_t vertexCount, size_t stride,
+                      uint32_t targetIndexCount, float maxError, float* resultError) {
+    if (destination != indices) memmove(destination, indices, sizeof(uint32_t) * indexCount);
+    if (resultError) *resultError = 0.0f;
+    if (indexCount <= targetIndexCount || indexCount < 3) return indexCount;
+
+    Quadric* quadrics = (Quadric*)calloc(vertexCount, sizeof(Quadric));
+    uint8_t* locked = (uint8_t*)calloc(vertexCount, 2);
+    uint32_t* remap = (uint32_t*)malloc(sizeof(uint32_t) * vertexCount);
+    uint32_t* offsets = (uint32_t*)malloc(sizeof(uint32_t) * (vertexCount + 1));
+    uint32_t* adjacency = (uint32_t*)malloc(sizeof(uint32_t) * indexCount);
+    Collapse* collapses = (Collapse*)malloc(sizeof(Collapse) * indexCount);
+    if (!quadrics || !locked || !remap || !offsets || !adjacency || !collapses ||
+        !lockBorderVertices(locked, destination, indexCount)) {
+        fprintf(stderr, "Failed to allocate memory for mesh simplification\n");
+        free(quadrics); free(locked); free(remap); free(offsets); free(adjacency); free(collapses);
+        return indexCount;
+    }
+    uint8_t* touched = locked + vertexCount;
+
+    for (uint32_t i = 0; i < indexCount; i += 3) {
+        const float* p0 = vertexPosition(positions, stride, destination[i]);
+        double n[3];
+        triangleNormal(n, p0, vertexPosition(positions, stride, destination[i + 1]),
+                       vertexPosition(positions, stride, destination[i + 2]));
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0) continue;
+        n[0] /= length; n[1] /= length; n[2] /= length;
+        double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+        Quadric plane = {
+            n[0] * n[0], n[0] * n[1], n[0] * n[2], n[0] * d,
+            n[1] * n[1], n[1] * n[2], n[1] * d,
+            n[2] * n[2], n[2] * d, d * d
+        };
+        for (int c = 0; c < 3; c++) quadricAdd(&quadrics[destination[i + c]], &plane);
+    }
+
+    double limit = (double)maxError * maxError;
+    double worst = 0.0;
+    uint32_t count = indexCount;
+
+    while (count > targetIndexCount) {
+        // Vertex -> triangle adjacency for the current index buffer.
+        memset(offsets, 0, sizeof(uint32_t) * (vertexCount + 1));
+        for (uint32_t i = 0; i < count; i++) offsets[destination[i] + 1]++;
+        for (uint32_t v = 0; v < vertexCount; v++) offsets[v + 1] += offsets[v];
+        for (uint32_t i = 0; i < count; i++) adjacency[offsets[destination[i]]++] = i / 3;
+        for (uint32_t v = vertexCount; v > 0; v--) offsets[v] = offsets[v - 1];
+        offsets[0] = 0;
+
+        uint32_t collapseCount = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t a = destination[i];
+            uint32_t b = destination[i % 3 == 2 ? i - 2 : i + 1];
+            if (a > b || (locked[a] && locked[b])) continue;
+
+            Quadric q = quadrics[a];
+            quadricAdd(&q, &quadrics[b]);
+            double toB = locked[a] ? INFINITY : quadricError(&q, vertexPosition(positions, stride, b));
+            double toA = locked[b] ? INFINITY : quadricError(&q, vertexPosition(positions, stride, a));
+            Collapse c = toB <= toA ? (Collapse){a, b, toB} : (Collapse){b, a, toA};
+            if (c.cost <= limit) collapses[collapseCount++] = c;
+        }
+        if (collapseCount == 0) break;
+        qsort(collapses, collapseCount, sizeof(Collapse), compareCollapse);
+
+        for (uint32_t v = 0; v < vertexCount; v++) remap[v] = v;
+        memset(touched, 0, vertexCount);
+
+        uint32_t remaining = count;
+        uint32_t applied = 0;
+        for (uint32_t i = 0; i < collapseCount && remaining > targetIndexCount; i++) {
+            Collapse c = collapses[i];
+            if (touched[c.from] || touched[c.to]) continue;
+            if (collapseFlips(destination, adjacency, offsets[c.from], offsets[c.from + 1],
+                              c.from, c.to, positions, stride)) continue;
+
+            // Lock the whole one-ring so later collapses in this pass see valid flip checks.
+            for (uint32_t k = offsets[c.from]; k < offsets[c.from + 1]; k++) {
+                const uint32_t* tri = destination + adjacency[k] * 3;
+                if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) remaining -= 3;
+                touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+            }
+            remap[c.from] = c.to;
+            quadricAdd(&quadrics[c.to], &quadrics[c.from]);
+            if (c.cost > worst) worst = c.cost;
+            applied++;
+        }
+        if (applied == 0) break;
+
+        uint32_t out = 0;
+        for (uint32_t i = 0; i < count; i += 3) {
+            uint32_t a = remap[destination[i]];
+            uint32_t b = remap[destination[i + 1]];
+            uint32_t c = remap[destination[i + 2]];
+            if (a == b || b == c || a == c) continue;
+            destination[out++] = a;
+            destination[out++] = b;
+            destination[out++] = c;
+        }
+        count = out;
+    }
+
+    free(quadrics); free(locked); free(remap); free(offsets); free(adjacency); free(collapses);
+    if (resultError) *resultError = (float)sqrt(worst);
+    return count;
+}
+
+void computeMeshBounds(float* bounds, const float* positions, uint32_t vertexCount, size_t stride) {
+    bounds[0] = bounds[1] = bounds[2] = bounds[3] = 0.0f;
+    if (vertexCount == 0) return;
+
+    float min[3], max[3];
+    memcpy(min, positions, sizeof(float) * 3);
+    memcpy(max, positions, sizeof(float) * 3);
+    for (uint32_t i = 1; i < vertexCount; i++) {
+        const float* p = vertexPosition(positions, stride, i);
+        for (int c = 0; c < 3; c++) {
+            if (p[c] < min[c]) min[c] = p[c];
+            if (p[c] > max[c]) max[c] = p[c];
+        }
+    }
+    for (int c = 0; c < 3; c++) bounds[c] = (min[c] + max[c]) * 0.5f;
+
+    float radius = 0.0f;
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        const float* p = vertexPosition(positions, stride, i);
+        float dx = p[0] - bounds[0], dy = p[1] - bounds[1], dz = p[2] - bounds[2];
+        float d = dx * dx + dy * dy + dz * dz;
+        if (d > radius) radius = d;
+    }
+    bounds[3] = sqrtf(radius);
+}
+
+uint32_t buildLodChain(uint32_t* destination, uint32_t destinationCapacity, MeshLod* lods,
+                       const uint32_t* indices, uint32_t indexCount,
+                       const float* positions, uint32_t vertexCount, size_t stride, float maxError) {
+    if (destinationCapacity < indexCount) return 0;
+    memcpy(destination, indices, sizeof(uint32_t) * indexCount);
+    lods[0] = (MeshLod){0, indexCount, 0.0f, 0};
+
+    uint32_t lodCount = 1;
+    uint32_t used = indexCount;
+    uint32_t previous = indexCount;
+    while (lodCount < MESH_MAX_LODS && maxError > 0.0f && used + indexCount <= destinationCapacity) {
+        uint32_t target = (previous / 2) / 3 * 3;
+        if (target < 3) break;
+
+        float error;
+        uint32_t count = simplifyMesh(destination + used, indices, indexCount, positions, vertexCount,
+                                      stride, target, maxError, &error);
+        if (count == 0 || count > (uint32_t)(previous * LOD_MIN_REDUCTION)) break;
+
+        lods[lodCount++] = (MeshLod){used, count, error, 0};
+        used += count;
+        previous = count;
+    }
+    return lodCount;
+}
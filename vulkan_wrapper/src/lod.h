@@ -0,0 +1,37 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Mesh simplification has no Vulkan dependency so offline tools can link it directly.
+
+#define MESH_MAX_LODS 8
+
+// One level of detail: a range in the mesh index buffer. All levels share the mesh vertices.
+typedef struct {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;        // object-space deviation from LOD 0
+    uint32_t reserved;
+} MeshLod;
+
+// Quadric edge-collapse simplification of a triangle list. Vertices are only collapsed onto
+// existing vertices, so the result indexes the same vertex buffer. Open borders and attribute
+// seams (vertices with no matching opposite edge) are never moved.
+// Stops at targetIndexCount or when the next collapse would exceed maxError. Returns the new
+// index count; destination needs room for indexCount indices and may alias indices.
+uint32_t simplifyMesh(uint32_t* destination, const uint32_t* indices, uint32_t indexCount,
+                      const float* positions, uint32_t vertexCount, size_t stride,
+                      uint32_t targetIndexCount, float maxError, float* resultError);
+
+// Bounding sphere around the AABB center: center xyz and radius.
+void computeMeshBounds(float* bounds, const float* positions, uint32_t vertexCount, size_t stride);
+
+// Writes LOD 0 (a copy of indices) followed by progressively coarser levels, each simplified from
+// the original so errors are measured against full detail. Returns the number of levels.
+uint32_t buildLodChain(uint32_t* destination, uint32_t destinationCapacity, MeshLod* lods,
+                       const uint32_t* indices, uint32_t indexCount,
+                       const float* positions, uint32_t vertexCount, size_t stride, float maxError);
+
+#endif
@@ -0,0 +1,809 @@
+#include "engine.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Starting arena sizes; they double (or jump to what a mesh pack needs) when full.
+#define MESH_VERTEX_ARENA_SIZE (64u * 1024 * 1024)
+#define MESH_INDEX_ARENA_SIZE (32u * 1024 * 1024)
+#define MESH_ARENA_USAGE (VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT)
+#define MESH_PACK_STAGING_SIZE (16u * 1024 * 1024)
+// A coarser level is only picked once its error is this far below the threshold, so objects
+// sitting at a switching distance don't flicker between two levels.
+#define LOD_HYSTERESIS 0.75f
+
+typedef struct {
+    float center[3];
+    float radius;
+    int32_t vertexOffset;
+    uint32_t layout;
+    VertexDequantize dequantize;
+    uint32_t lodCount;
+    MeshLod lods[MESH_MAX_LODS];
+} Mesh;
+
+typedef struct {
+    uint32_t mesh;
+    uint32_t node;
+    uint32_t lod;
+    uint32_t active;
+} MeshInstance;
+
+struct MeshSystem {
+    VkBuffer vertexBuffer;
+    VkDeviceMemory vertexMemory;
+    VkDeviceSize vertexUsed;
+    VkDeviceSize vertexCapacity;
+    VkBuffer indexBuffer;
+    VkDeviceMemory indexMemory;
+    VkDeviceSize indexUsed;
+    VkDeviceSize indexCapacity;
+    VkBuffer instanceBuffer;
+    VkDeviceMemory instanceMemory;
+    Mat4* instanceMapped;
+    uint32_t instanceUsed;
+    uint32_t instanceViews;  // MAX_MESH_INSTANCES matrices per view the instance buffer holds
+
+    Mesh meshes[MAX_MESHES];
+    uint32_t meshCount;
+
+    MeshInstance instances[MAX_MESH_INSTANCES];
+    uint32_t instanceCount;
+    uint32_t freeInstances[MAX_MESH_INSTANCES];
+    uint32_t freeCount;
+
+    // Per-frame scratch: visible instances bucketed by mesh * MESH_MAX_LODS + lod.
+    uint32_t visible[MAX_MESH_INSTANCES];
+    uint32_t visibleKeys[MAX_MESH_INSTANCES];
+    float visibleSpheres[MAX_MESH_INSTANCES][4];
+    uint32_t bucketOffsets[MAX_MESHES * MESH_MAX_LODS + 1];
+    uint32_t bucketCommands[MAX_MESHES * MESH_MAX_LODS];
+    uint8_t commandLayouts[MAX_MESHES * MESH_MAX_LODS];
+    uint32_t visibleCount;
+
+    // Set when this frame's draws come from the GPU occlusion cull instead of the bucket list.
+    const OcclusionBuffers* occlusion;
+    uint32_t commandCount;
+    int multiDrawIndirect;
+
+    float lodThreshold;
+    uint64_t drawnTriangles;
+};
+
+// The main view's matrices come first; extra windows append theirs behind it each frame. Replaces
+// the buffer only once the new one is mapped, so a failure leaves the old one in place.
+static int createInstanceBuffer(Engine* engine, MeshSystem* meshes, uint32_t views) {
+    VkDeviceSize size = sizeof(Mat4) * MAX_MESH_INSTANCES * (VkDeviceSize)views;
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    if (createBuffer(engine, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     &buffer, &memory) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create mesh instance buffer for %u views\n", views);
+        return 0;
+    }
+
+    void* data;
+    if (vkMapMemory(engine->device, memory, 0, size, 0, &data) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to map mesh instance buffer memory\n");
+        vkFreeMemory(engine->device, memory, NULL);
+        vkDestroyBuffer(engine->device, buffer, NULL);
+        return 0;
+    }
+
+    if (meshes->instanceMapped) vkUnmapMemory(engine->device, meshes->instanceMemory);
+    if (meshes->instanceMemory) vkFreeMemory(engine->device, meshes->instanceMemory, NULL);
+    if (meshes->instanceBuffer) vkDestroyBuffer(engine->device, meshes->instanceBuffer, NULL);
+    meshes->instanceBuffer = buffer;
+    meshes->instanceMemory = memory;
+    meshes->instanceMapped = (Mat4*)data;
+    meshes->instanceViews = views;
+    return 1;
+}
+
+void createMeshSystem(Engine* engine) {
+    MeshSystem* meshes = (MeshSystem*)calloc(1, sizeof(MeshSystem));
+    if (!meshes) {
+        fprintf(stderr, "Failed to allocate memory for mesh system\n");
+        return;
+    }
+    meshes->lodThreshold = engine->lodThreshold;
+
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(engine->physicalDevice, &features);
+    meshes->multiDrawIndirect = features.multiDrawIndirect;
+
+    meshes->vertexCapacity = MESH_VERTEX_ARENA_SIZE;
+    meshes->indexCapacity = MESH_INDEX_ARENA_SIZE;
+    if (createBuffer(engine, MESH_VERTEX_ARENA_SIZE, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | MESH_ARENA_USAGE,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &meshes->vertexBuffer, &meshes->vertexMemory) != VK_SUCCESS ||
+        createBuffer(engine, MESH_INDEX_ARENA_SIZE, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | MESH_ARENA_USAGE,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &meshes->indexBuffer, &meshes->indexMemory) != VK_SUCCESS ||
+        !createInstanceBuffer(engine, meshes, 1)) {
+        engine->meshes = meshes;
+        destroyMeshSystem(engine);
+        return;
+    }
+    engine->meshes = meshes;
+}
+
+void destroyMeshSystem(Engine* engine) {
+    MeshSystem* meshes = engine->meshes;
+    if (!meshes) return;
+
+    if (meshes->instanceMapped) vkUnmapMemory(engine->device, meshes->instanceMemory);
+    if (meshes->instanceMemory) vkFreeMemory(engine->device, meshes->instanceMemory, NULL);
+    if (meshes->instanceBuffer) vkDestroyBuffer(engine->device, meshes->instanceBuffer, NULL);
+    if (meshes->indexMemory) vkFreeMemory(engine->device, meshes->indexMemory, NULL);
+    if (meshes->indexBuffer) vkDestroyBuffer(engine->device, meshes->indexBuffer, NULL);
+    if (meshes->vertexMemory) vkFreeMemory(engine->device, meshes->vertexMemory, NULL);
+    if (meshes->vertexBuffer) vkDestroyBuffer(engine->device, meshes->vertexBuffer, NULL);
+    free(meshes);
+    engine->meshes = NULL;
+}
+
+// Moves an arena into a buffer of at least `required` bytes, keeping what is already in it. Meshes
+// are only created between frames, so nothing in flight still reads the old buffer.
+static int growArena(Engine* engine, VkBuffer* buffer, VkDeviceMemory* memory, VkDeviceSize* capacity,
+                     VkDeviceSize used, VkDeviceSize required, VkBufferUsageFlags usage, const char* name) {
+    if (required <= *capacity) return 1;
+    VkDeviceSize size = *capacity * 2 > required ? *capacity * 2 : required;
+
+    VkBuffer grown;
+    VkDeviceMemory grownMemory;
+    if (createBuffer(engine, size, usage | MESH_ARENA_USAGE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                     &grown, &grownMemory) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to grow the mesh %s arena to %llu MB\n", name,
+                (unsigned long long)(size / (1024 * 1024)));
+        return 0;
+    }
+    if (used > 0) {
+        VkCommandBuffer commandBuffer = beginSingleTimeCommands(engine);
+        VkBufferCopy copy = {.srcOffset = 0, .dstOffset = 0, .size = used};
+        vkCmdCopyBuffer(commandBuffer, *buffer, grown, 1, &copy);
+        endSingleTimeCommands(engine, commandBuffer);
+    }
+    vkFreeMemory(engine->device, *memory, NULL);
+    vkDestroyBuffer(engine->device, *buffer, NULL);
+    *buffer = grown;
+    *memory = grownMemory;
+    *capacity = size;
+    return 1;
+}
+
+static int meshFits(Engine* engine, MeshSystem* meshes, uint32_t meshCount, VkDeviceSize vertexSize,
+                    VkDeviceSize indexSize) {
+    if (meshes->meshCount + meshCount > MAX_MESHES) {
+        fprintf(stderr, "Too many meshes, max is %d\n", MAX_MESHES);
+        return 0;
+    }
+    return growArena(engine, &meshes->vertexBuffer, &meshes->vertexMemory, &meshes->vertexCapacity, meshes->vertexUsed,
+                     meshes->vertexUsed + vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, "vertex") &&
+           growArena(engine, &meshes->indexBuffer, &meshes->indexMemory, &meshes->indexCapacity, meshes->indexUsed,
+                     meshes->indexUsed + indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, "index");
+}
+
+// Layouts share the vertex arena, and vertexOffset counts in vertices of the mesh's own layout,
+// so each mesh starts on a multiple of its stride.
+static void alignVertexArena(MeshSystem* meshes, uint32_t layout) {
+    VkDeviceSize stride = vertexLayoutStride(layout);
+    meshes->vertexUsed = (meshes->vertexUsed + stride - 1) / stride * stride;
+}
+
+// Records a mesh whose data has been (or is about to be) copied to the current arena tails.
+static int32_t commitMesh(MeshSystem* meshes, uint32_t layout, const VertexDequantize* dequantize,
+                          VkDeviceSize vertexSize, VkDeviceSize indexSize,
+                          const MeshLod* lods, uint32_t lodCount, const float* bounds) {
+    Mesh* mesh = &meshes->meshes[meshes->meshCount];
+    memcpy(mesh->center, bounds, sizeof(float) * 3);
+    mesh->radius = bounds[3];
+    mesh->vertexOffset = (int32_t)(meshes->vertexUsed / vertexLayoutStride(layout));
+    mesh->layout = layout;
+    mesh->dequantize = *dequantize;
+    mesh->lodCount = lodCount;
+    uint32_t firstIndex = (uint32_t)(meshes->indexUsed / sizeof(uint32_t));
+    for (uint32_t i = 0; i < lodCount; i++) {
+        mesh->lods[i] = lods[i];
+        mesh->lods[i].firstIndex += firstIndex;
+    }
+
+    meshes->vertexUsed += vertexSize;
+    meshes->indexUsed += indexSize;
+    return (int32_t)meshes->meshCount++;
+}
+
+// Vertices are encoded into the layout straight into staging memory.
+int32_t createMesh(Engine* engine, const Vertex3D* vertices, uint32_t vertexCount, uint32_t layout,
+                   const uint32_t* indices, uint32_t indexCount, const MeshLod* lods, uint32_t lodCount,
+                   const float* bounds) {
+    MeshSystem* meshes = engine->meshes;
+    if (!meshes || !meshes->instanceMapped) return -1;
+
+    VkDeviceSize vertexSize = (VkDeviceSize)vertexCount * vertexLayoutStride(layout);
+    VkDeviceSize indexSize = (VkDeviceSize)indexCount * sizeof(uint32_t);
+    if (lodCount == 0 || lodCount > MESH_MAX_LODS) {
+        fprintf(stderr, "Invalid LOD count %u\n", lodCount);
+        return -1;
+    }
+    alignVertexArena(meshes, layout);
+    if (!meshFits(engine, meshes, 1, vertexSize, indexSize)) return -1;
+
+    TRACE_ZONE_BEGIN(uploadZone, "mesh upload");
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+    if (createBuffer(engine, vertexSize + indexSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     &stagingBuffer, &stagingMemory) != VK_SUCCESS) {
+        return -1;
+    }
+
+    void* data;
+    if (vkMapMemory(engine->device, stagingMemory, 0, vertexSize + indexSize, 0, &data) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to map mesh staging memory\n");
+        vkFreeMemory(engine->device, stagingMemory, NULL);
+        vkDestroyBuffer(engine->device, stagingBuffer, NULL);
+        return -1;
+    }
+    VertexDequantize dequantize;
+    encodeVertices(data, layout, &vertices[0].x, vertexCount, sizeof(Vertex3D), &dequantize);
+    memcpy((uint8_t*)data + vertexSize, indices, (size_t)indexSize);
+    vkUnmapMemory(engine->device, stagingMemory);
+
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands(engine);
+    VkBufferCopy vertexCopy = {.srcOffset = 0, .dstOffset = meshes->vertexUsed, .size = vertexSize};
+    VkBufferCopy indexCopy = {.srcOffset = vertexSize, .dstOffset = meshes->indexUsed, .size = indexSize};
+    vkCmdCopyBuffer(commandBuffer, stagingBuffer, meshes->vertexBuffer, 1, &vertexCopy);
+    vkCmdCopyBuffer(commandBuffer, stagingBuffer, meshes->indexBuffer, 1, &indexCopy);
+    endSingleTimeCommands(engine, commandBuffer);
+
+    vkFreeMemory(engine->device, stagingMemory, NULL);
+    vkDestroyBuffer(engine->device, stagingBuffer, NULL);
+    TRACE_ZONE_END(uploadZone);
+
+    return commitMesh(meshes, layout, &dequantize, vertexSize, indexSize, lods, lodCount, bounds);
+}
+
+// Meshes, and the occlusion culling that draws them, are created with the first mesh.
+static void requireMeshSystem(Engine* engine) {
+    if (engine->meshes) return;
+    createLazily(engine, "mesh system", createMeshSystem);
+    if (!engine->occlusion && !engine->occlusionDisabled) createLazily(engine, "occlusion system", createOcclusionSystem);
+}
+
+EXPORT int32_t engine_mesh_create(Engine* engine, const Vertex3D* vertices, uint32_t vertexCount,
+                                  const uint32_t* indices, uint32_t indexCount, float lodMaxError) {
+    return engine_mesh_create_layout(engine, vertices, vertexCount, indices, indexCount, lodMaxError,
+                                     MESH_LAYOUT_POSITION_COLOR);
+}
+
+// Vertices are always passed as Vertex3D; layout picks how the GPU copy stores them.
+EXPORT int32_t engine_mesh_create_layout(Engine* engine, const Vertex3D* vertices, uint32_t vertexCount,
+                                         const uint32_t* indices, uint32_t indexCount, float lodMaxError,
+                                         uint32_t layout) {
+    if (engine->capture) {
+        captureCall(engine, CAPTURE_MESH_CREATE_LAYOUT,
+                    (CaptureWord[]){{.u = vertexCount}, {.u = indexCount}, {.f = lodMaxError}, {.u = layout}}, 4,
+                    (CaptureData[]){{vertices, (uint32_t)(sizeof(Vertex3D) * vertexCount)},
+                                    {indices, (uint32_t)(sizeof(uint32_t) * indexCount)}}, 2);
+    }
+    if (vertexCount == 0 || indexCount == 0 || indexCount % 3 != 0) {
+        fprintf(stderr, "engine_mesh_create: invalid geometry\n");
+        return -1;
+    }
+    if (layout >= MESH_LAYOUT_COUNT) {
+        fprintf(stderr, "engine_mesh_create: invalid vertex layout %u\n", layout);
+        return -1;
+    }
+    for (uint32_t i = 0; i < indexCount; i++) {
+        if (indices[i] >= vertexCount) {
+            fprintf(stderr, "engine_mesh_create: index %u is %u, past the %u vertices\n", i, indices[i], vertexCount);
+            return -1;
+        }
+    }
+    requireMeshSystem(engine);
+
+    float bounds[4];
+    computeMeshBounds(bounds, &vertices[0].x, vertexCount, sizeof(Vertex3D));
+
+    // Room for LOD 0 and two more full-size levels; buildLodChain stops adding levels before one
+    // could overrun it, so a chain that does not fit is cut short rather than overflowed.
+    uint32_t capacity = indexCount * 3;
+    uint32_t* chain = (uint32_t*)malloc(sizeof(uint32_t) * capacity);
+    if (!chain) {
+        fprintf(stderr, "Failed to allocate memory for LOD chain\n");
+        return -1;
+    }
+
+    MeshLod lods[MESH_MAX_LODS];
+    TRACE_ZONE_BEGIN(lodZone, "buildLodChain");
+    uint32_t lodCount = buildLodChain(chain, capacity, lods, indices, indexCount, &vertices[0].x, vertexCount,
+                                      sizeof(Vertex3D), lodMaxError * bounds[3]);
+    TRACE_ZONE_END(lodZone);
+    uint32_t chainCount = lods[lodCount - 1].firstIndex + lods[lodCount - 1].indexCount;
+    int32_t mesh = createMesh(engine, vertices, vertexCount, layout, chain, chainCount, lods, lodCount, bounds);
+    free(chain);
+    return mesh;
+}
+
+static int validSection(const MappedFile* file, const MeshPackSection* section, uint64_t expectedSize) {
+    return section->size == expectedSize && section->offset % MESH_PACK_ALIGNMENT == 0 &&
+           section->offset <= file->size && section->size <= file->size - section->offset;
+}
+
+static int validMeshPackEntry(const MappedFile* file, const MeshPackEntry* entry) {
+    if (entry->vertexLayout >= MESH_LAYOUT_COUNT || entry->vertexCount == 0 ||
+        entry->indexCount == 0 || entry->lodCount == 0 || entry->lodCount > MESH_MAX_LODS) {
+        return 0;
+    }
+    uint64_t vertexSize = (uint64_t)entry->vertexCount * vertexLayoutStride(entry->vertexLayout);
+    if (!validSection(file, &entry->sections[MESH_SECTION_VERTICES], vertexSize) ||
+        !validSection(file, &entry->sections[MESH_SECTION_INDICES], (uint64_t)entry->indexCount * sizeof(uint32_t)) ||
+        !validSection(file, &entry->sections[MESH_SECTION_BOUNDS], sizeof(float) * 4) ||
+        !validSection(file, &entry->sections[MESH_SECTION_LODS], (uint64_t)entry->lodCount * sizeof(MeshLod)) ||
+        !validSection(file, &entry->sections[MESH_SECTION_DEQUANTIZE], sizeof(VertexDequantize))) {
+        return 0;
+    }
+
+    const MeshLod* lods = (const MeshLod*)(file->data + entry->sections[MESH_SECTION_LODS].offset);
+    for (uint32_t i = 0; i < entry->lodCount; i++) {
+        if (lods[i].indexCount == 0 || lods[i].indexCount % 3 != 0 || lods[i].firstIndex > entry->indexCount ||
+            lods[i].indexCount > entry->indexCount - lods[i].firstIndex) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Copies every mesh of a pack into the arenas. Sections are memcpy'd from the mapping into one
+// staging buffer and flushed with a single submit whenever it fills up.
+EXPORT int32_t engine_mesh_pack_open(Engine* engine, const char* path, uint32_t* meshCount) {
+    if (engine->capture && path) {
+        captureCall(engine, CAPTURE_MESH_PACK_OPEN, NULL, 0, (CaptureData[]){{path, (uint32_t)strlen(path) + 1}}, 1);
+    }
+    requireMeshSystem(engine);
+    MeshSystem* meshes = engine->meshes;
+    if (meshCount) *meshCount = 0;
+    if (!meshes || !meshes->instanceMapped) return -1;
+
+    MappedFile file;
+    if (!mapFile(path, &file)) return -1;
+
+    const MeshPackHeader* header = (const MeshPackHeader*)file.data;
+    if (file.size < sizeof(MeshPackHeader) || memcmp(header->magic, "DFMP", 4) != 0 ||
+        header->version != MESH_PACK_VERSION ||
+        header->meshCount > (file.size - sizeof(MeshPackHeader)) / sizeof(MeshPackEntry)) {
+        fprintf(stderr, "Invalid mesh pack: %s\n", path);
+        unmapFile(&file);
+        return -1;
+    }
+
+    const MeshPackEntry* entries = (const MeshPackEntry*)(file.data + sizeof(MeshPackHeader));
+    VkDeviceSize stagingSize = MESH_PACK_STAGING_SIZE;
+    VkDeviceSize vertexTotal = 0, indexTotal = 0;
+    for (uint32_t i = 0; i < header->meshCount; i++) {
+        if (!validMeshPackEntry(&file, &entries[i])) {
+            fprintf(stderr, "Invalid mesh %u in pack: %s\n", i, path);
+            unmapFile(&file);
+            return -1;
+        }
+        VkDeviceSize size = entries[i].sections[MESH_SECTION_VERTICES].size + entries[i].sections[MESH_SECTION_INDICES].size;
+        if (size > stagingSize) stagingSize = size;
+        // Worst case for aligning each mesh to its stride in the arena.
+        vertexTotal += entries[i].sections[MESH_SECTION_VERTICES].size + vertexLayoutStride(entries[i].vertexLayout);
+        indexTotal += entries[i].sections[MESH_SECTION_INDICES].size;
+    }
+    if (!meshFits(engine, meshes, header->meshCount, vertexTotal, indexTotal)) {
+        fprintf(stderr, "Mesh pack does not fit (%llu MB of vertices, %llu MB of indices): %s\n",
+                (unsigned long long)(vertexTotal / (1024 * 1024)), (unsigned long long)(indexTotal / (1024 * 1024)), path);
+        unmapFile(&file);
+        return -1;
+    }
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+    void* staging;
+    if (createBuffer(engine, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     &stagingBuffer, &stagingMemory) != VK_SUCCESS) {
+        unmapFile(&file);
+        return -1;
+    }
+    if (vkMapMemory(engine->device, stagingMemory, 0, stagingSize, 0, &staging) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to map mesh staging memory\n");
+        vkFreeMemory(engine->device, stagingMemory, NULL);
+        vkDestroyBuffer(engine->device, stagingBuffer, NULL);
+        unmapFile(&file);
+        return -1;
+    }
+
+    TRACE_ZONE_BEGIN(uploadZone, "mesh pack upload");
+    int32_t first = (int32_t)meshes->meshCount;
+    VkDeviceSize vertexStart = meshes->vertexUsed, indexStart = meshes->indexUsed;
+    int valid = 1;
+    VkDeviceSize stagingUsed = 0;
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands(engine);
+    for (uint32_t i = 0; i < header->meshCount; i++) {
+        const MeshPackEntry* entry = &entries[i];
+        const MeshPackSection* vertices = &entry->sections[MESH_SECTION_VERTICES];
+        const MeshPackSection* indices = &entry->sections[MESH_SECTION_INDICES];
+
+        if (stagingUsed + vertices->size + indices->size > stagingSize) {
+            endSingleTimeCommands(engine, commandBuffer);
+            commandBuffer = beginSingleTimeCommands(engine);
+            stagingUsed = 0;
+        }
+
+        // Indices are checked as they are copied, so a bad pack costs no extra pass over the file.
+        const uint32_t* source = (const uint32_t*)(file.data + indices->offset);
+        uint32_t* destination = (uint32_t*)((uint8_t*)staging + stagingUsed + vertices->size);
+        uint32_t maxIndex = 0;
+        for (uint32_t j = 0; j < entry->indexCount; j++) {
+            uint32_t index = source[j];
+            destination[j] = index;
+            if (index > maxIndex) maxIndex = index;
+        }
+        if (maxIndex >= entry->vertexCount) {
+            fprintf(stderr, "Mesh %u in pack indexes vertex %u of %u: %s\n", i, maxIndex, entry->vertexCount, path);
+            valid = 0;
+            break;
+        }
+
+        alignVertexArena(meshes, entry->vertexLayout);
+        memcpy((uint8_t*)staging + stagingUsed, file.data + vertices->offset, (size_t)vertices->size);
+        VkBufferCopy vertexCopy = {.srcOffset = stagingUsed, .dstOffset = meshes->vertexUsed, .size = vertices->size};
+        VkBufferCopy indexCopy = {.srcOffset = stagingUsed + vertices->size, .dstOffset = meshes->indexUsed, .size = indices->size};
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer, meshes->vertexBuffer, 1, &vertexCopy);
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer, meshes->indexBuffer, 1, &indexCopy);
+        stagingUsed += vertices->size + indices->size;
+
+        commitMesh(meshes, entry->vertexLayout,
+                   (const VertexDequantize*)(file.data + entry->sections[MESH_SECTION_DEQUANTIZE].offset),
+                   vertices->size, indices->size,
+                   (const MeshLod*)(file.data + entry->sections[MESH_SECTION_LODS].offset), entry->lodCount,
+                   (const float*)(file.data + entry->sections[MESH_SECTION_BOUNDS].offset));
+    }
+    endSingleTimeCommands(engine, commandBuffer);
+    TRACE_ZONE_END(uploadZone);
+
+    vkUnmapMemory(engine->device, stagingMemory);
+    vkFreeMemory(engine->device, stagingMemory, NULL);
+    vkDestroyBuffer(engine->device, stagingBuffer, NULL);
+    unmapFile(&file);
+
+    // The meshes copied before the bad one are dropped; their arena space is reused.
+    if (!valid) {
+        meshes->meshCount = (uint32_t)first;
+        meshes->vertexUsed = vertexStart;
+        meshes->indexUsed = indexStart;
+        return -1;
+    }
+    if (meshCount) *meshCount = header->meshCount;
+    return first;
+}
+
+EXPORT uint32_t engine_mesh_lod_count(Engine* engine, int32_t mesh) {
+    MeshSystem* meshes = engine->meshes;
+    if (!meshes || mesh < 0 || (uint32_t)mesh >= meshes->meshCount) return 0;
+    return meshes->meshes[mesh].lodCount;
+}
+
+EXPORT int32_t engine_mesh_instance_create(Engine* engine, int32_t mesh, uint32_t node) {
+    if (engine->capture) captureCall(engine, CAPTURE_MESH_INSTANCE_CREATE, (CaptureWord[]){{.i = mesh}, {.u = node}}, 2, NULL, 0);
+    MeshSystem* meshes = engine->meshes;
+    if (!meshes || mesh < 0 || (uint32_t)mesh >= meshes->meshCount) {
+        fprintf(stderr, "engine_mesh_instance_create: invalid mesh %d\n", mesh);
+        return -1;
+    }
+    if (nodeIndex(engine, node) == NODE_NONE) {
+        fprintf(stderr, "engine_mesh_instance_create: invalid node handle %u\n", node);
+        return -1;
+    }
+
+    uint32_t instance;
+    if (meshes->freeCount > 0) {
+        instance = meshes->freeInstances[--meshes->freeCount];
+    } else if (meshes->instanceCount < MAX_MESH_INSTANCES) {
+        instance = meshes->instanceCount++;
+    } else {
+        fprintf(stderr, "engine_mesh_instance_create: too many mesh instances\n");
+        return -1;
+    }
+
+    meshes->instances[instance] = (MeshInstance){(uint32_t)mesh, node, 0, 1};
+    return (int32_t)instance;
+}
+
+EXPORT void engine_mesh_instance_destroy(Engine* engine, int32_t instance) {
+    if (engine->capture) captureCall(engine, CAPTURE_MESH_INSTANCE_DESTROY, (CaptureWord[]){{.i = instance}}, 1, NULL, 0);
+    MeshSystem* meshes = engine->meshes;
+    if (!meshes || instance < 0 || (uint32_t)instance >= meshes->instanceCount) return;
+    if (!meshes->instances[instance].active) return;
+
+    meshes->instances[instance].active = 0;
+    meshes->freeInstances[meshes->freeCount++] = (uint32_t)instance;
+}
+
+EXPORT void engine_set_lod_threshold(Engine* engine, float pixels) {
+    if (engine->capture) captureCall(engine, CAPTURE_SET_LOD_THRESHOLD, (CaptureWord[]){{.f = pixels}}, 1, NULL, 0);
+    engine->lodThreshold = pixels;
+    if (engine->meshes) engine->meshes->lodThreshold = pixels;
+}
+
+// With occlusion culling the instance counts are only known once the frame has executed, so
+// they are summed from the indirect commands of the last frame.
+EXPORT uint64_t engine_mesh_drawn_triangles(Engine* engine) {
+    MeshSystem* meshes = engine->meshes;
+    if (!meshes) return 0;
+    if (!meshes->occlusion) return meshes->drawnTriangles;
+
+    uint64_t triangles = 0;
+    for (uint32_t i = 0; i < meshes->commandCount; i++) {
+        const VkDrawIndexedIndirectCommand* first = &meshes->occlusion->commands[i];
+        const VkDrawIndexedIndirectCommand* second = &meshes->occlusion->commands[MAX_MESH_INSTANCES + i];
+        triangles += (uint64_t)(first->indexCount / 3) * (first->instanceCount + second->instanceCount);
+    }
+    return triangles;
+}
+
+// Keeps the current level unless it is too coarse for the threshold or a coarser one is
+// comfortably below it.
+static uint32_t selectLod(const Mesh* mesh, uint32_t current, float pixelsPerUnit, float threshold) {
+    uint32_t lod = current < mesh->lodCount ? current : mesh->lodCount - 1;
+    while (lod > 0 && mesh->lods[lod].error * pixelsPerUnit > threshold) lod--;
+    while (lod + 1 < mesh->lodCount && mesh->lods[lod + 1].error * pixelsPerUnit <= threshold * LOD_HYSTERESIS) lod++;
+    return lod;
+}
+
+// Frustum culling, LOD selection and bucketing for one view. Leaves the visible instances in the
+// scratch arrays and bucketOffsets as prefix sums. Only the main view (updateLod) moves the LOD
+// hysteresis state; other views select from it without writing it back.
+static uint32_t gatherVisible(Engine* engine, const float* vp, VkExtent2D extent, int updateLod) {
+    MeshSystem* meshes = engine->meshes;
+    float planes[24];
+    engine_frustum_planes(planes, vp);
+
+    // Row 1 of viewProj is the view-space up axis scaled by cot(fovY / 2), and row 3 gives clip w
+    // (view depth), so world-space error e at depth w covers e * projScale / w pixels.
+    float projScale = sqrtf(vp[1] * vp[1] + vp[5] * vp[5] + vp[9] * vp[9]) * 0.5f * (float)extent.height;
+
+    uint32_t bucketCount = meshes->meshCount * MESH_MAX_LODS;
+    uint32_t* offsets = meshes->bucketOffsets;
+    memset(offsets, 0, sizeof(uint32_t) * (bucketCount + 1));
+
+    uint32_t visibleCount = 0;
+    for (uint32_t i = 0; i < meshes->instanceCount; i++) {
+        MeshInstance* instance = &meshes->instances[i];
+        if (!instance->active) continue;
+        uint32_t index = nodeIndex(engine, instance->node);
+        if (index == NODE_NONE) continue;
+
+        const Mesh* mesh = &meshes->meshes[instance->mesh];
+        const float* m = nodeWorldMatrix(engine, index);
+        float center[3] = {
+            m[0] * mesh->center[0] + m[4] * mesh->center[1] + m[8] * mesh->center[2] + m[12],
+            m[1] * mesh->center[0] + m[5] * mesh->center[1] + m[9] * mesh->center[2] + m[13],
+            m[2] * mesh->center[0] + m[6] * mesh->center[1] + m[10] * mesh->center[2] + m[14]
+        };
+        float sx = m[0] * m[0] + m[1] * m[1] + m[2] * m[2];
+        float sy = m[4] * m[4] + m[5] * m[5] + m[6] * m[6];
+        float sz = m[8] * m[8] + m[9] * m[9] + m[10] * m[10];
+        float scale = sqrtf(sx > sy ? (sx > sz ? sx : sz) : (sy > sz ? sy : sz));
+        float radius = mesh->radius * scale;
+
+        int outside = 0;
+        for (int p = 0; p < 6 && !outside; p++) {
+            const float* plane = planes + p * 4;
+            outside = plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3] < -radius;
+        }
+        if (outside) continue;
+
+        float w = vp[3] * center[0] + vp[7] * center[1] + vp[11] * center[2] + vp[15];
+        uint32_t lod = w <= radius ? 0 : selectLod(mesh, instance->lod, projScale * scale / w, meshes->lodThreshold);
+        if (updateLod) instance->lod = lod;
+
+        uint32_t key = instance->mesh * MESH_MAX_LODS + lod;
+        float* sphere = meshes->visibleSpheres[visibleCount];
+        sphere[0] = center[0];
+        sphere[1] = center[1];
+        sphere[2] = center[2];
+        sphere[3] = radius;
+        meshes->visible[visibleCount] = index;
+        meshes->visibleKeys[visibleCount++] = key;
+        offsets[key + 1]++;
+    }
+
+    if (visibleCount > 0) {
+        for (uint32_t b = 0; b < bucketCount; b++) offsets[b + 1] += offsets[b];
+    }
+    return visibleCount;
+}
+
+// world * dequantize, with dequantize a per-axis scale and a translation. The float layout has an
+// identity dequantize and takes the plain copy.
+static void writeInstanceMatrix(Mat4* out, const float* world, const Mesh* mesh) {
+    if (mesh->layout == MESH_LAYOUT_POSITION_COLOR) {
+        memcpy(out->m, world, sizeof(Mat4));
+        return;
+    }
+    const float* scale = mesh->dequantize.scale;
+    const float* offset = mesh->dequantize.offset;
+    for (int row = 0; row < 4; row++) {
+        out->m[row] = world[row] * scale[0];
+        out->m[4 + row] = world[4 + row] * scale[1];
+        out->m[8 + row] = world[8 + row] * scale[2];
+        out->m[12 + row] = world[row] * offset[0] + world[4 + row] * offset[1] + world[8 + row] * offset[2] + world[12 + row];
+    }
+}
+
+// CPU part of the frame: frustum culling, LOD selection and bucketing. With occlusion culling the
+// buckets become indirect draws whose instance counts are filled by the GPU first-pass cull.
+void prepareMeshes(Engine* engine) {
+    MeshSystem* meshes = engine->meshes;
+    if (!meshes) return;
+
+    meshes->occlusion = beginOcclusionFrame(engine);
+    meshes->visibleCount = 0;
+    meshes->instanceUsed = 0;
+    meshes->commandCount = 0;
+    meshes->drawnTriangles = 0;
+    if (meshes->instanceCount == meshes->freeCount || engine->meshPipelines[0] == VK_NULL_HANDLE) return;
+
+    uint32_t visibleCount = gatherVisible(engine, engine->viewProj, engine->renderExtent, 1);
+    meshes->visibleCount = visibleCount;
+    if (visibleCount == 0) return;
+
+    uint32_t bucketCount = meshes->meshCount * MESH_MAX_LODS;
+    uint32_t* offsets = meshes->bucketOffsets;
+    const OcclusionBuffers* occlusion = meshes->occlusion;
+    if (occlusion) {
+        // One command per non-empty bucket for each pass; the second pass appends after the first.
+        uint32_t commandCount = 0;
+        for (uint32_t b = 0; b < bucketCount; b++) {
+            if (offsets[b + 1] == offsets[b]) continue;
+            const Mesh* mesh = &meshes->meshes[b / MESH_MAX_LODS];
+            const MeshLod* lod = &mesh->lods[b % MESH_MAX_LODS];
+            VkDrawIndexedIndirectCommand command = {lod->indexCount, 0, lod->firstIndex, mesh->vertexOffset, offsets[b]};
+            occlusion->commands[commandCount] = command;
+            command.firstInstance += MAX_MESH_INSTANCES;
+            occlusion->commands[MAX_MESH_INSTANCES + commandCount] = command;
+            meshes->commandLayouts[commandCount] = (uint8_t)mesh->layout;
+            meshes->bucketCommands[b] = commandCount++;
+        }
+        meshes->commandCount = commandCount;
+    }
+
+    Mat4* matrices = occlusion ? occlusion->matrices : meshes->instanceMapped;
+    if (!occlusion) meshes->instanceUsed = visibleCount;
+    for (uint32_t i = 0; i < visibleCount; i++) {
+        uint32_t key = meshes->visibleKeys[i];
+        uint32_t slot = offsets[key]++;
+        writeInstanceMatrix(&matrices[slot], nodeWorldMatrix(engine, meshes->visible[i]), &meshes->meshes[key / MESH_MAX_LODS]);
+        if (occlusion) {
+            OcclusionCandidate* candidate = &occlusion->candidates[slot];
+            memcpy(candidate->sphere, meshes->visibleSpheres[i], sizeof(candidate->sphere));
+            candidate->command = meshes->bucketCommands[key];
+        }
+    }
+}
+
+// Phase 0 culls this frame's candidates against the previous pyramid, phase 1 re-tests what it
+// rejected once the pyramid has been rebuilt from the first pass.
+void cullMeshes(Engine* engine, VkCommandBuffer commandBuffer, uint32_t phase) {
+    MeshSystem* meshes = engine->meshes;
+    if (!meshes || !meshes->occlusion || meshes->visibleCount == 0) return;
+
+    cullOcclusion(engine, commandBuffer, phase, meshes->visibleCount);
+}
+
+static void bindMeshState(Engine* engine, VkCommandBuffer commandBuffer, VkExtent2D extent, VkBuffer instanceBuffer,
+                          VkDescriptorSet descriptorSet) {
+    MeshSystem* meshes = engine->meshes;
+    VkViewport viewport = {0.0f, 0.0f, (float)extent.width, (float)extent.height, 0.0f, 1.0f};
+    VkRect2D scissor = {{0, 0}, extent};
+    VkBuffer vertexBuffers[] = {meshes->vertexBuffer, instanceBuffer};
+    VkDeviceSize bufferOffsets[] = {0, 0};
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, bufferOffsets);
+    vkCmdBindIndexBuffer(commandBuffer, meshes->indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, engine->pipelineLayout,
+                            0, 1, &descriptorSet, 0, NULL);
+}
+
+// One direct draw per bucket. After the scatter, offsets[b] is the end of bucket b and the start
+// of bucket b + 1; instances of the view start at firstInstance. The pipeline only changes where
+// the vertex layout does, which for meshes loaded together from a pack is rarely.
+static uint64_t drawBuckets(Engine* engine, VkCommandBuffer commandBuffer, uint32_t firstInstance) {
+    MeshSystem* meshes = engine->meshes;
+    const uint32_t* offsets = meshes->bucketOffsets;
+    uint32_t bucketCount = meshes->meshCount * MESH_MAX_LODS;
+    uint64_t triangles = 0;
+    uint32_t first = 0;
+    uint32_t boundLayout = MESH_LAYOUT_COUNT;
+    for (uint32_t b = 0; b < bucketCount; b++) {
+        uint32_t count = offsets[b] - first;
+        if (count == 0) continue;
+        const Mesh* mesh = &meshes->meshes[b / MESH_MAX_LODS];
+        const MeshLod* lod = &mesh->lods[b % MESH_MAX_LODS];
+        if (mesh->layout != boundLayout) {
+            boundLayout = mesh->layout;
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, engine->meshPipelines[boundLayout]);
+        }
+        vkCmdDrawIndexed(commandBuffer, lod->indexCount, count, lod->firstIndex, mesh->vertexOffset, firstInstance + first);
+        triangles += (uint64_t)(lod->indexCount / 3) * count;
+        first = offsets[b];
+    }
+    return triangles;
+}
+
+// Phase 0 draws inside the first render pass, phase 1 the instances recovered by the second cull.
+void recordMeshes(Engine* engine, VkCommandBuffer commandBuffer, uint32_t phase) {
+    MeshSystem* meshes = engine->meshes;
+    if (!meshes || meshes->visibleCount == 0) return;
+    const OcclusionBuffers* occlusion = meshes->occlusion;
+    if (!occlusion && phase > 0) return;
+
+    bindMeshState(engine, commandBuffer, engine->renderExtent,
+                  occlusion ? occlusion->visibleBuffer : meshes->instanceBuffer, engine->descriptorSet);
+
+    if (occlusion) {
+        // Commands come in bucket order; each run of one vertex layout is one multi-draw.
+        uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+        VkDeviceSize offset = (VkDeviceSize)(phase ? MAX_MESH_INSTANCES : 0) * stride;
+        for (uint32_t first = 0; first < meshes->commandCount;) {
+            uint32_t layout = meshes->commandLayouts[first];
+            uint32_t count = 1;
+            while (first + count < meshes->commandCount && meshes->commandLayouts[first + count] == layout) count++;
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, engine->meshPipelines[layout]);
+            if (meshes->multiDrawIndirect) {
+                vkCmdDrawIndexedIndirect(commandBuffer, occlusion->commandBuffer, offset + (VkDeviceSize)first * stride,
+                                         count, stride);
+            } else {
+                for (uint32_t i = first; i < first + count; i++) {
+                    vkCmdDrawIndexedIndirect(commandBuffer, occlusion->commandBuffer, offset + (VkDeviceSize)i * stride, 1, stride);
+                }
+            }
+            first += count;
+        }
+        return;
+    }
+
+    meshes->drawnTriangles = drawBuckets(engine, commandBuffer, 0);
+}
+
+// Grows the instance buffer to hold a full set of matrices for each view of the frame, so no
+// window runs out of room. Must be called while the queue is idle, before recording.
+void reserveMeshViews(Engine* engine, uint32_t views) {
+    MeshSystem* meshes = engine->meshes;
+    if (!meshes || views <= meshes->instanceViews) return;
+    createInstanceBuffer(engine, meshes, views);
+}
+
+// Draws the meshes seen by an extra window with frustum culling only. Must be recorded after the
+// main view, whose bucket scratch it reuses; its matrices go behind the main view's.
+void recordMeshesView(Engine* engine, VkCommandBuffer commandBuffer, const float* viewProj, VkExtent2D extent,
+                      VkDescriptorSet descriptorSet) {
+    MeshSystem* meshes = engine->meshes;
+    if (!meshes || meshes->instanceCount == meshes->freeCount || engine->meshPipelines[0] == VK_NULL_HANDLE) return;
+
+    uint32_t visibleCount = gatherVisible(engine, viewProj, extent, 0);
+    if (visibleCount == 0) return;
+    if (visibleCount > MAX_MESH_INSTANCES * meshes->instanceViews - meshes->instanceUsed) {
+        fprintf(stderr, "Instance buffer is full, skipping window meshes\n");
+        return;
+    }
+
+    uint32_t base = meshes->instanceUsed;
+    uint32_t* offsets = meshes->bucketOffsets;
+    for (uint32_t i = 0; i < visibleCount; i++) {
+        uint32_t key = meshes->visibleKeys[i];
+        uint32_t slot = offsets[key]++;
+        writeInstanceMatrix(&meshes->instanceMapped[base + slot], nodeWorldMatrix(engine, meshes->visible[i]),
+                            &meshes->meshes[key / MESH_MAX_LODS]);
+    }
+    meshes->instanceUsed += visibleCount;
+
+    bindMeshState(engine, commandBuffer, extent, meshes->instanceBuffer, descriptorSet);
+    drawBuckets(engine, commandBuffer, base);
+}
@@ -0,0 +1,43 @@
+#ifndef MESHPACK_H
+#define MESHPACK_H
+
+#include <stdint.h>
+#include "lod.h"
+#include "vertexcodec.h"
+
+// Mesh pack container: header, meshCount entries, then per-mesh sections.
+// Every section starts on a MESH_PACK_ALIGNMENT boundary and holds data exactly as the GPU
+// buffers expect it, so loading is a straight copy from the mapped file into staging memory.
+#define MESH_PACK_VERSION 2
+#define MESH_PACK_ALIGNMENT 16
+
+enum {
+    MESH_SECTION_VERTICES,    // vertexCount vertices in vertexLayout
+    MESH_SECTION_INDICES,     // indexCount uint32 indices, all LOD levels back to back
+    MESH_SECTION_BOUNDS,      // bounding sphere: center xyz, radius
+    MESH_SECTION_LODS,        // lodCount MeshLod, firstIndex relative to the index section
+    MESH_SECTION_DEQUANTIZE,  // VertexDequantize of the vertex section
+    MESH_SECTION_COUNT
+};
+
+typedef struct {
+    char magic[4];  // "DFMP"
+    uint32_t version;
+    uint32_t meshCount;
+    uint32_t reserved;
+} MeshPackHeader;
+
+typedef struct {
+    uint64_t offset;
+    uint64_t size;
+} MeshPackSection;
+
+typedef struct {
+    uint32_t vertexLayout;  // MESH_LAYOUT_*
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t lodCount;
+    MeshPackSection sections[MESH_SECTION_COUNT];
+} MeshPackEntry;
+
+#endif
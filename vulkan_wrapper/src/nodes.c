@@ -0,0 +1,467 @@
+#include "engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// 131072 slots and a 15-bit generation. A slot whose generation would wrap is retired instead
+// of reused, so a stale handle never becomes valid again.
+#define NODE_SLOT_BITS 17
+#define NODE_SLOT_MASK ((1u << NODE_SLOT_BITS) - 1)
+#define NODE_GENERATION_MASK ((1u << (32 - NODE_SLOT_BITS)) - 1)
+// parent[] marker for nodes destroyed since the last update; roots use NODE_NONE.
+#define NODE_REMOVED 0xFFFFFFFEu
+
+// Dense arrays are kept sorted parent-before-child so world matrices resolve in one forward sweep.
+struct NodeStore {
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t* parent;       // dense index of the parent, NODE_NONE for roots
+    uint32_t* slot;         // dense index -> handle slot
+    float* translation;     // 3 floats per node
+    float* rotation;        // 4 floats per node, quaternion xyzw
+    float* scale;           // 3 floats per node
+    Mat4* world;
+    uint8_t* dirty;
+    uint32_t firstDirty;
+    int needsReorder;
+    uint32_t removedCount;
+
+    uint32_t slotCount;
+    uint32_t slotCapacity;
+    uint32_t* slotIndex;    // slot -> dense index, NODE_NONE when free
+    uint16_t* slotGeneration;
+    uint32_t* freeSlots;
+    uint32_t freeCount;
+
+    uint32_t* scratch;
+};
+
+static void* alignedAlloc(size_t size) {
+#ifdef _WIN32
+    return _aligned_malloc(size, 16);
+#else
+    return aligned_alloc(16, size);
+#endif
+}
+
+static void alignedFree(void* p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+static int growArray(void** array, size_t elementSize, uint32_t capacity) {
+    void* p = realloc(*array, elementSize * capacity);
+    if (!p) return 0;
+    *array = p;
+    return 1;
+}
+
+static int reserveNodes(NodeStore* store, uint32_t capacity) {
+    if (capacity <= store->capacity) return 1;
+    uint32_t newCapacity = store->capacity ? store->capacity : 1024;
+    while (newCapacity < capacity) newCapacity *= 2;
+
+    Mat4* world = (Mat4*)alignedAlloc(sizeof(Mat4) * newCapacity);
+    if (!world) return 0;
+    if (store->world) {
+        memcpy(world, store->world, sizeof(Mat4) * store->count);
+        alignedFree(store->world);
+    }
+    store->world = world;
+
+    if (!growArray((void**)&store->parent, sizeof(uint32_t), newCapacity) ||
+        !growArray((void**)&store->slot, sizeof(uint32_t), newCapacity) ||
+        !growArray((void**)&store->translation, sizeof(float) * 3, newCapacity) ||
+        !growArray((void**)&store->rotation, sizeof(float) * 4, newCapacity) ||
+        !growArray((void**)&store->scale, sizeof(float) * 3, newCapacity) ||
+        !growArray((void**)&store->dirty, sizeof(uint8_t), newCapacity) ||
+        !growArray((void**)&store->scratch, sizeof(uint32_t) * 2, newCapacity)) {
+        return 0;
+    }
+    store->capacity = newCapacity;
+    return 1;
+}
+
+static int reserveSlots(NodeStore* store, uint32_t capacity) {
+    if (capacity <= store->slotCapacity) return 1;
+    uint32_t newCapacity = store->slotCapacity ? store->slotCapacity : 1024;
+    while (newCapacity < capacity) newCapacity *= 2;
+
+    if (!growArray((void**)&store->slotIndex, sizeof(uint32_t), newCapacity) ||
+        !growArray((void**)&store->slotGeneration, sizeof(uint16_t), newCapacity) ||
+        !growArray((void**)&store->freeSlots, sizeof(uint32_t), newCapacity)) {
+        return 0;
+    }
+    store->slotCapacity = newCapacity;
+    return 1;
+}
+
+void createNodeStore(Engine* engine) {
+    NodeStore* store = (NodeStore*)calloc(1, sizeof(NodeStore));
+    if (!store) {
+        fprintf(stderr, "Failed to allocate memory for node store\n");
+        return;
+    }
+    store->firstDirty = UINT32_MAX;
+    engine->nodes = store;
+}
+
+void destroyNodeStore(Engine* engine) {
+    NodeStore* store = engine->nodes;
+    if (!store) return;
+
+    free(store->parent);
+    free(store->slot);
+    free(store->translation);
+    free(store->rotation);
+    free(store->scale);
+    alignedFree(store->world);
+    free(store->dirty);
+    free(store->scratch);
+    free(store->slotIndex);
+    free(store->slotGeneration);
+    free(store->freeSlots);
+    free(store);
+    engine->nodes = NULL;
+}
+
+// Nodes destroyed since the last compaction no longer resolve.
+static uint32_t resolve(const NodeStore* store, uint32_t handle) {
+    uint32_t s = handle & NODE_SLOT_MASK;
+    if (handle == NODE_NONE || s >= store->slotCount) return NODE_NONE;
+    if (store->slotGeneration[s] != handle >> NODE_SLOT_BITS) return NODE_NONE;
+    uint32_t index = store->slotIndex[s];
+    if (index == NODE_NONE || store->parent[index] == NODE_REMOVED) return NODE_NONE;
+    return index;
+}
+
+static void markDirty(NodeStore* store, uint32_t index) {
+    store->dirty[index] = 1;
+    if (index < store->firstDirty) store->firstDirty = index;
+}
+
+uint32_t nodeIndex(Engine* engine, uint32_t handle) {
+    return engine->nodes ? resolve(engine->nodes, handle) : NODE_NONE;
+}
+
+const float* nodeWorldMatrix(Engine* engine, uint32_t index) {
+    return engine->nodes->world[index].m;
+}
+
+EXPORT uint32_t engine_node_create(Engine* engine, uint32_t parent) {
+    if (engine->capture) captureCall(engine, CAPTURE_NODE_CREATE, (CaptureWord[]){{.u = parent}}, 1, NULL, 0);
+    NodeStore* store = engine->nodes;
+    if (!store) return NODE_NONE;
+
+    uint32_t parentIndex = NODE_NONE;
+    if (parent != NODE_NONE) {
+        parentIndex = resolve(store, parent);
+        if (parentIndex == NODE_NONE) {
+            fprintf(stderr, "Invalid parent node handle %u\n", parent);
+            return NODE_NONE;
+        }
+    }
+
+    if (!reserveNodes(store, store->count + 1)) {
+        fprintf(stderr, "Failed to grow node store\n");
+        return NODE_NONE;
+    }
+
+    uint32_t s;
+    if (store->freeCount > 0) {
+        s = store->freeSlots[--store->freeCount];
+    } else {
+        if (store->slotCount >= NODE_SLOT_MASK || !reserveSlots(store, store->slotCount + 1)) {
+            fprintf(stderr, "Failed to grow node handle table\n");
+            return NODE_NONE;
+        }
+        s = store->slotCount++;
+        store->slotGeneration[s] = 0;
+    }
+
+    // Appending keeps the parent-before-child order, the parent already has a lower index.
+    uint32_t index = store->count++;
+    store->parent[index] = parentIndex;
+    store->slot[index] = s;
+    float* t = store->translation + index * 3;
+    float* r = store->rotation + index * 4;
+    float* sc = store->scale + index * 3;
+    t[0] = t[1] = t[2] = 0.0f;
+    r[0] = r[1] = r[2] = 0.0f;
+    r[3] = 1.0f;
+    sc[0] = sc[1] = sc[2] = 1.0f;
+    store->slotIndex[s] = index;
+    markDirty(store, index);
+
+    return ((uint32_t)store->slotGeneration[s] << NODE_SLOT_BITS) | s;
+}
+
+static void compactNodes(NodeStore* store);
+static int reorderNodes(NodeStore* store);
+
+// Drops destroyed nodes and restores the parent-before-child order.
+static int settleNodes(NodeStore* store) {
+    if (store->removedCount > 0) compactNodes(store);
+    return !store->needsReorder || reorderNodes(store);
+}
+
+EXPORT void engine_node_destroy(Engine* engine, uint32_t handle) {
+    if (engine->capture) captureCall(engine, CAPTURE_NODE_DESTROY, (CaptureWord[]){{.u = handle}}, 1, NULL, 0);
+    NodeStore* store = engine->nodes;
+    if (!store) return;
+    uint32_t index = resolve(store, handle);
+    if (index == NODE_NONE) return;
+
+    // The subtree walk below needs the order a reparent may have broken.
+    if (store->needsReorder) {
+        if (!settleNodes(store)) return;
+        index = resolve(store, handle);
+    }
+
+    // Descendants always follow their ancestors, so one forward pass finds the whole subtree.
+    store->parent[index] = NODE_REMOVED;
+    store->removedCount++;
+    for (uint32_t i = index + 1; i < store->count; i++) {
+        uint32_t p = store->parent[i];
+        if (p != NODE_NONE && p != NODE_REMOVED && store->parent[p] == NODE_REMOVED) {
+            store->parent[i] = NODE_REMOVED;
+            store->removedCount++;
+        }
+    }
+}
+
+EXPORT int engine_node_set_parent(Engine* engine, uint32_t handle, uint32_t parent) {
+    if (engine->capture) captureCall(engine, CAPTURE_NODE_SET_PARENT, (CaptureWord[]){{.u = handle}, {.u = parent}}, 2, NULL, 0);
+    NodeStore* store = engine->nodes;
+    if (!store) return 0;
+    uint32_t index = resolve(store, handle);
+    if (index == NODE_NONE) return 0;
+
+    uint32_t parentIndex = NODE_NONE;
+    if (parent != NODE_NONE) {
+        parentIndex = resolve(store, parent);
+        if (parentIndex == NODE_NONE) return 0;
+        for (uint32_t p = parentIndex; p != NODE_NONE; p = store->parent[p]) {
+            if (p == index) {
+                fprintf(stderr, "engine_node_set_parent: node cannot become its own descendant\n");
+                return 0;
+            }
+        }
+    }
+
+    store->parent[index] = parentIndex;
+    if (parentIndex != NODE_NONE && parentIndex > index) store->needsReorder = 1;
+    markDirty(store, index);
+    return 1;
+}
+
+EXPORT void engine_node_set_translation(Engine* engine, uint32_t handle, float x, float y, float z) {
+    if (engine->capture) {
+        captureCall(engine, CAPTURE_NODE_SET_TRANSLATION, (CaptureWord[]){{.u = handle}, {.f = x}, {.f = y}, {.f = z}}, 4, NULL, 0);
+    }
+    uint32_t index = nodeIndex(engine, handle);
+    if (index == NODE_NONE) return;
+    float* t = engine->nodes->translation + index * 3;
+    t[0] = x;
+    t[1] = y;
+    t[2] = z;
+    markDirty(engine->nodes, index);
+}
+
+EXPORT void engine_node_set_rotation(Engine* engine, uint32_t handle, float x, float y, float z, float w) {
+    if (engine->capture) {
+        captureCall(engine, CAPTURE_NODE_SET_ROTATION, (CaptureWord[]){{.u = handle}, {.f = x}, {.f = y}, {.f = z}, {.f = w}}, 5, NULL, 0);
+    }
+    uint32_t index = nodeIndex(engine, handle);
+    if (index == NODE_NONE) return;
+    float* r = engine->nodes->rotation + index * 4;
+    r[0] = x;
+    r[1] = y;
+    r[2] = z;
+    r[3] = w;
+    markDirty(engine->nodes, index);
+}
+
+EXPORT void engine_node_set_scale(Engine* engine, uint32_t handle, float x, float y, float z) {
+    if (engine->capture) {
+        captureCall(engine, CAPTURE_NODE_SET_SCALE, (CaptureWord[]){{.u = handle}, {.f = x}, {.f = y}, {.f = z}}, 4, NULL, 0);
+    }
+    uint32_t index = nodeIndex(engine, handle);
+    if (index == NODE_NONE) return;
+    float* s = engine->nodes->scale + index * 3;
+    s[0] = x;
+    s[1] = y;
+    s[2] = z;
+    markDirty(engine->nodes, index);
+}
+
+// Bulk update for many moving nodes in one call; translations holds 3 floats per handle.
+EXPORT void engine_nodes_set_translations(Engine* engine, const uint32_t* handles, const float* translations, uint32_t count) {
+    if (engine->capture) {
+        captureCall(engine, CAPTURE_NODES_SET_TRANSLATIONS, (CaptureWord[]){{.u = count}}, 1,
+                    (CaptureData[]){{handles, (uint32_t)(sizeof(uint32_t) * count)},
+                                    {translations, (uint32_t)(sizeof(float) * 3 * count)}}, 2);
+    }
+    NodeStore* store = engine->nodes;
+    if (!store) return;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t index = resolve(store, handles[i]);
+        if (index == NODE_NONE) continue;
+        memcpy(store->translation + index * 3, translations + i * 3, sizeof(float) * 3);
+        markDirty(store, index);
+    }
+}
+
+// Remaps in a first pass, since a pending reorder can leave parents after their children.
+static void compactNodes(NodeStore* store) {
+    uint32_t* remap = store->scratch;
+    uint32_t out = 0;
+    for (uint32_t i = 0; i < store->count; i++) {
+        if (store->parent[i] == NODE_REMOVED) {
+            uint32_t s = store->slot[i];
+            store->slotIndex[s] = NODE_NONE;
+            store->slotGeneration[s] = (uint16_t)((store->slotGeneration[s] + 1) & NODE_GENERATION_MASK);
+            if (store->slotGeneration[s] != 0) store->freeSlots[store->freeCount++] = s;
+            continue;
+        }
+        remap[i] = out++;
+    }
+
+    out = 0;
+    for (uint32_t i = 0; i < store->count; i++) {
+        if (store->parent[i] == NODE_REMOVED) continue;
+        if (out != i) {
+            uint32_t p = store->parent[i];
+            store->parent[out] = p == NODE_NONE ? NODE_NONE : remap[p];
+            store->slot[out] = store->slot[i];
+            memcpy(store->translation + out * 3, store->translation + i * 3, sizeof(float) * 3);
+            memcpy(store->rotation + out * 4, store->rotation + i * 4, sizeof(float) * 4);
+            memcpy(store->scale + out * 3, store->scale + i * 3, sizeof(float) * 3);
+            store->world[out] = store->world[i];
+            store->dirty[out] = store->dirty[i];
+            store->slotIndex[store->slot[out]] = out;
+        } else if (store->parent[i] != NODE_NONE) {
+            store->parent[i] = remap[store->parent[i]];
+        }
+        out++;
+    }
+    if (store->firstDirty != UINT32_MAX) {
+        for (store->firstDirty = 0; store->firstDirty < out && !store->dirty[store->firstDirty]; store->firstDirty++) {}
+        if (store->firstDirty == out) store->firstDirty = UINT32_MAX;
+    }
+    store->count = out;
+    store->removedCount = 0;
+}
+
+// Counting sort by depth: stable, and every parent lands before its children.
+static int reorderNodes(NodeStore* store) {
+    uint32_t n = store->count;
+    uint32_t* depth = store->scratch;
+    uint32_t* order = store->scratch + store->capacity;
+    for (uint32_t i = 0; i < n; i++) depth[i] = UINT32_MAX;
+
+    uint32_t maxDepth = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t steps = 0;
+        uint32_t p = i;
+        while (p != NODE_NONE && depth[p] == UINT32_MAX) {
+            p = store->parent[p];
+            steps++;
+        }
+        uint32_t d = (p == NODE_NONE ? 0 : depth[p] + 1) + steps - 1;
+        for (p = i; p != NODE_NONE && depth[p] == UINT32_MAX; p = store->parent[p]) {
+            depth[p] = d--;
+        }
+        if (depth[i] > maxDepth) maxDepth = depth[i];
+    }
+
+    uint32_t* offsets = (uint32_t*)calloc(maxDepth + 2, sizeof(uint32_t));
+    uint32_t* parent = (uint32_t*)malloc(sizeof(uint32_t) * n);
+    uint32_t* slot = (uint32_t*)malloc(sizeof(uint32_t) * n);
+    float* translation = (float*)malloc(sizeof(float) * 3 * n);
+    float* rotation = (float*)malloc(sizeof(float) * 4 * n);
+    float* scale = (float*)malloc(sizeof(float) * 3 * n);
+    uint8_t* dirty = (uint8_t*)malloc(n);
+    Mat4* world = (Mat4*)alignedAlloc(sizeof(Mat4) * store->capacity);
+    if (!offsets || !parent || !slot || !translation || !rotation || !scale || !dirty || !world) {
+        free(offsets); free(parent); free(slot); free(translation); free(rotation); free(scale); free(dirty);
+        if (world) alignedFree(world);
+        fprintf(stderr, "Failed to allocate memory for node reorder\n");
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < n; i++) offsets[depth[i] + 1]++;
+    for (uint32_t d = 0; d <= maxDepth; d++) offsets[d + 1] += offsets[d];
+    for (uint32_t i = 0; i < n; i++) order[i] = offsets[depth[i]]++;
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t dst = order[i];
+        uint32_t p = store->parent[i];
+        parent[dst] = p == NODE_NONE ? NODE_NONE : order[p];
+        slot[dst] = store->slot[i];
+        memcpy(translation + dst * 3, store->translation + i * 3, sizeof(float) * 3);
+        memcpy(rotation + dst * 4, store->rotation + i * 4, sizeof(float) * 4);
+        memcpy(scale + dst * 3, store->scale + i * 3, sizeof(float) * 3);
+        world[dst] = store->world[i];
+        dirty[dst] = store->dirty[i];
+        store->slotIndex[store->slot[i]] = dst;
+    }
+
+    memcpy(store->parent, parent, sizeof(uint32_t) * n);
+    memcpy(store->slot, slot, sizeof(uint32_t) * n);
+    memcpy(store->translation, translation, sizeof(float) * 3 * n);
+    memcpy(store->rotation, rotation, sizeof(float) * 4 * n);
+    memcpy(store->scale, scale, sizeof(float) * 3 * n);
+    memcpy(store->dirty, dirty, n);
+    alignedFree(store->world);
+    store->world = world;
+    free(offsets); free(parent); free(slot); free(translation); free(rotation); free(scale); free(dirty);
+
+    // Reordering moves subtrees around; recompute everything once.
+    for (uint32_t i = 0; i < n; i++) store->dirty[i] = 1;
+    store->firstDirty = n ? 0 : UINT32_MAX;
+    store->needsReorder = 0;
+    return 1;
+}
+
+EXPORT void engine_nodes_update(Engine* engine) {
+    NodeStore* store = engine->nodes;
+    if (!store) return;
+
+    if (!settleNodes(store)) return;
+    if (store->firstDirty == UINT32_MAX) return;
+
+    // dirty[] doubles as "world changed this update" so children inherit it from their parent.
+    for (uint32_t i = store->firstDirty; i < store->count; i++) {
+        uint32_t p = store->parent[i];
+        if (!store->dirty[i]) {
+            if (p == NODE_NONE || p < store->firstDirty || !store->dirty[p]) continue;
+            store->dirty[i] = 1;
+        }
+
+        float* world = store->world[i].m;
+        engine_mat4_from_trs(world, store->translation + i * 3, store->rotation + i * 4, store->scale + i * 3);
+        if (p != NODE_NONE) engine_mat4_multiply(world, store->world[p].m, world);
+    }
+
+    memset(store->dirty + store->firstDirty, 0, store->count - store->firstDirty);
+    store->firstDirty = UINT32_MAX;
+}
+
+EXPORT int engine_node_world_matrix(Engine* engine, uint32_t handle, float* out) {
+    uint32_t index = nodeIndex(engine, handle);
+    if (index == NODE_NONE) return 0;
+    memcpy(out, engine->nodes->world[index].m, sizeof(float) * 16);
+    return 1;
+}
+
+EXPORT uint32_t engine_node_count(Engine* engine) {
+    return engine->nodes ? engine->nodes->count - engine->nodes->removedCount : 0;
+}
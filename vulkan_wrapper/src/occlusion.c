@@ -0,0 +1,606 @@
+#include "engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIZ_MAX_LEVELS 16
+#define HIZ_GROUP_SIZE 8
+#define CULL_GROUP_SIZE 64
+#define CULL_SET_BINDINGS 7
+
+enum {
+    OCCLUSION_STAT_FIRST_PASS,   // drawn by the first pass (visible in the previous frame's pyramid)
+    OCCLUSION_STAT_SECOND_PASS,  // rejected by the old pyramid but visible in the current one
+    OCCLUSION_STAT_OCCLUDED,     // rejected by both
+    OCCLUSION_STAT_COUNT
+};
+
+typedef struct {
+    int32_t sourceSize[2];
+    int32_t destinationSize[2];
+} HiZPushConstants;
+
+typedef struct {
+    float viewProj[16];
+    int32_t hizSize[2];
+    uint32_t candidateCount;
+    uint32_t phase;
+    uint32_t hizLevels;
+    uint32_t commandOffset;
+} CullPushConstants;
+
+struct OcclusionSystem {
+    int enabled;
+    OcclusionBuffers buffers;
+    VkDeviceMemory candidateMemory;
+    VkBuffer candidateBuffer;
+    VkDeviceMemory matrixMemory;
+    VkBuffer matrixBuffer;
+    VkDeviceMemory commandMemory;
+    VkDeviceMemory visibleMemory;
+    VkDeviceMemory pendingMemory;
+    VkBuffer pendingBuffer;
+    VkDeviceMemory statsMemory;
+    VkBuffer statsBuffer;
+    uint32_t* stats;
+
+    VkSampler sampler;
+    VkDescriptorSetLayout hizSetLayout;
+    VkDescriptorSetLayout cullSetLayout;
+    VkPipelineLayout hizLayout;
+    VkPipelineLayout cullLayout;
+    VkPipeline hizPipeline;
+    VkPipeline cullPipeline;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet hizSets[HIZ_MAX_LEVELS];
+    VkDescriptorSet cullSet;
+
+    // Max-depth pyramid, created lazily for the current depth attachment.
+    VkImage hizImage;
+    VkDeviceMemory hizMemory;
+    VkImageView hizView;
+    VkImageView hizLevelViews[HIZ_MAX_LEVELS];
+    uint32_t hizWidth;
+    uint32_t hizHeight;
+    uint32_t hizLevelCount;
+    int hizValid;  // holds depth from an earlier pass
+    VkImageView depthView;  // level 0's source, the frame graph's transient depth
+};
+
+static uint32_t previousPowerOfTwo(uint32_t value) {
+    uint32_t result = 1;
+    while (result * 2 <= value) result *= 2;
+    return result;
+}
+
+static VkResult createHostBuffer(Engine* engine, VkDeviceSize size, VkBufferUsageFlags usage,
+                                 VkBuffer* buffer, VkDeviceMemory* memory, void** mapped) {
+    VkResult result = createBuffer(engine, size, usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                   buffer, memory);
+    if (result != VK_SUCCESS) return result;
+
+    result = vkMapMemory(engine->device, *memory, 0, size, 0, mapped);
+    if (result != VK_SUCCESS) fprintf(stderr, "Failed to map occlusion buffer memory: %d\n", result);
+    return result;
+}
+
+static VkResult createComputePipeline(Engine* engine, const char* path, VkDescriptorSetLayout setLayout, uint32_t pushSize,
+                                      VkPipelineLayout* layout, VkPipeline* pipeline) {
+    VkShaderModule shaderModule = createShaderModule(engine->device, path);
+    if (shaderModule == VK_NULL_HANDLE) return VK_ERROR_INITIALIZATION_FAILED;
+
+    VkPushConstantRange pushConstantRange = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = pushSize
+    };
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange
+    };
+
+    VkResult result = vkCreatePipelineLayout(engine->device, &pipelineLayoutInfo, NULL, layout);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create compute pipeline layout for %s\n", path);
+        vkDestroyShaderModule(engine->device, shaderModule, NULL);
+        return result;
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = shaderModule,
+            .pName = "main"
+        },
+        .layout = *layout
+    };
+
+    result = vkCreateComputePipelines(engine->device, engine->pipelineCache, 1, &pipelineInfo, NULL, pipeline);
+    if (result != VK_SUCCESS) fprintf(stderr, "Failed to create compute pipeline for %s\n", path);
+
+    vkDestroyShaderModule(engine->device, shaderModule, NULL);
+    return result;
+}
+
+static VkResult createDescriptors(Engine* engine, OcclusionSystem* occlusion) {
+    VkDescriptorSetLayoutBinding hizBindings[] = {
+        { .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1,
+          .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT },
+        { .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1,
+          .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT }
+    };
+
+    VkDescriptorSetLayoutBinding cullBindings[CULL_SET_BINDINGS];
+    for (uint32_t i = 0; i < CULL_SET_BINDINGS; i++) {
+        cullBindings[i] = (VkDescriptorSetLayoutBinding){
+            .binding = i,
+            .descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+        };
+    }
+
+    VkDescriptorSetLayoutCreateInfo hizLayoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 2,
+        .pBindings = hizBindings
+    };
+    VkDescriptorSetLayoutCreateInfo cullLayoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = CULL_SET_BINDINGS,
+        .pBindings = cullBindings
+    };
+
+    if (vkCreateDescriptorSetLayout(engine->device, &hizLayoutInfo, NULL, &occlusion->hizSetLayout) != VK_SUCCESS ||
+        vkCreateDescriptorSetLayout(engine->device, &cullLayoutInfo, NULL, &occlusion->cullSetLayout) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create occlusion descriptor set layouts\n");
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkDescriptorPoolSize poolSizes[] = {
+        { .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = HIZ_MAX_LEVELS + 1 },
+        { .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = HIZ_MAX_LEVELS },
+        { .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = CULL_SET_BINDINGS - 1 }
+    };
+
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .poolSizeCount = 3,
+        .pPoolSizes = poolSizes,
+        .maxSets = HIZ_MAX_LEVELS + 1
+    };
+
+    if (vkCreateDescriptorPool(engine->device, &poolInfo, NULL, &occlusion->descriptorPool) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create occlusion descriptor pool\n");
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkDescriptorSetLayout layouts[HIZ_MAX_LEVELS];
+    for (uint32_t i = 0; i < HIZ_MAX_LEVELS; i++) layouts[i] = occlusion->hizSetLayout;
+
+    VkDescriptorSetAllocateInfo hizAllocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = occlusion->descriptorPool,
+        .descriptorSetCount = HIZ_MAX_LEVELS,
+        .pSetLayouts = layouts
+    };
+    VkDescriptorSetAllocateInfo cullAllocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = occlusion->descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &occlusion->cullSetLayout
+    };
+
+    if (vkAllocateDescriptorSets(engine->device, &hizAllocInfo, occlusion->hizSets) != VK_SUCCESS ||
+        vkAllocateDescriptorSets(engine->device, &cullAllocInfo, &occlusion->cullSet) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate occlusion descriptor sets\n");
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    // Buffer bindings never change; the pyramid binding is written when the pyramid is created.
+    VkDescriptorBufferInfo bufferInfos[CULL_SET_BINDINGS - 1] = {
+        { occlusion->candidateBuffer, 0, VK_WHOLE_SIZE },
+        { occlusion->matrixBuffer, 0, VK_WHOLE_SIZE },
+        { occlusion->buffers.commandBuffer, 0, VK_WHOLE_SIZE },
+        { occlusion->buffers.visibleBuffer, 0, VK_WHOLE_SIZE },
+        { occlusion->pendingBuffer, 0, VK_WHOLE_SIZE },
+        { occlusion->statsBuffer, 0, VK_WHOLE_SIZE }
+    };
+
+    VkWriteDescriptorSet writes[CULL_SET_BINDINGS - 1];
+    for (uint32_t i = 0; i < CULL_SET_BINDINGS - 1; i++) {
+        writes[i] = (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = occlusion->cullSet,
+            .dstBinding = i + 1,
+            .dstArrayElement = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .pBufferInfo = &bufferInfos[i]
+        };
+    }
+    vkUpdateDescriptorSets(engine->device, CULL_SET_BINDINGS - 1, writes, 0, NULL);
+    return VK_SUCCESS;
+}
+
+void createOcclusionSystem(Engine* engine) {
+    if (!engine->depthSampled) {
+        fprintf(stderr, "Depth format is not sampleable, occlusion culling disabled\n");
+        return;
+    }
+
+    OcclusionSystem* occlusion = (OcclusionSystem*)calloc(1, sizeof(OcclusionSystem));
+    if (!occlusion) {
+        fprintf(stderr, "Failed to allocate memory for occlusion system\n");
+        return;
+    }
+    engine->occlusion = occlusion;
+
+    void* candidates;
+    void* matrices;
+    void* commands;
+    void* stats;
+    VkBuffer commandBuffer, visibleBuffer;
+    if (createHostBuffer(engine, sizeof(OcclusionCandidate) * MAX_MESH_INSTANCES, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                         &occlusion->candidateBuffer, &occlusion->candidateMemory, &candidates) != VK_SUCCESS ||
+        createHostBuffer(engine, sizeof(Mat4) * MAX_MESH_INSTANCES, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                         &occlusion->matrixBuffer, &occlusion->matrixMemory, &matrices) != VK_SUCCESS ||
+        createHostBuffer(engine, sizeof(VkDrawIndexedIndirectCommand) * MAX_MESH_INSTANCES * 2,
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                         &commandBuffer, &occlusion->commandMemory, &commands) != VK_SUCCESS ||
+        createHostBuffer(engine, sizeof(uint32_t) * OCCLUSION_STAT_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                         &occlusion->statsBuffer, &occlusion->statsMemory, &stats) != VK_SUCCESS) {
+        destroyOcclusionSystem(engine);
+        return;
+    }
+    occlusion->buffers.candidates = (OcclusionCandidate*)candidates;
+    occlusion->buffers.matrices = (Mat4*)matrices;
+    occlusion->buffers.commands = (VkDrawIndexedIndirectCommand*)commands;
+    occlusion->buffers.commandBuffer = commandBuffer;
+    occlusion->stats = (uint32_t*)stats;
+
+    if (createBuffer(engine, sizeof(Mat4) * MAX_MESH_INSTANCES * 2,
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &visibleBuffer, &occlusion->visibleMemory) != VK_SUCCESS ||
+        createBuffer(engine, sizeof(uint32_t) * MAX_MESH_INSTANCES, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &occlusion->pendingBuffer, &occlusion->pendingMemory) != VK_SUCCESS) {
+        destroyOcclusionSystem(engine);
+        return;
+    }
+    occlusion->buffers.visibleBuffer = visibleBuffer;
+
+    VkSamplerCreateInfo samplerInfo = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .minLod = 0.0f,
+        .maxLod = (float)HIZ_MAX_LEVELS
+    };
+
+    if (vkCreateSampler(engine->device, &samplerInfo, NULL, &occlusion->sampler) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create Hi-Z sampler\n");
+        destroyOcclusionSystem(engine);
+        return;
+    }
+
+    if (createDescriptors(engine, occlusion) != VK_SUCCESS ||
+        createComputePipeline(engine, ".shaders/computehiz.spv", occlusion->hizSetLayout, sizeof(HiZPushConstants),
+                              &occlusion->hizLayout, &occlusion->hizPipeline) != VK_SUCCESS ||
+        createComputePipeline(engine, ".shaders/computecull.spv", occlusion->cullSetLayout, sizeof(CullPushConstants),
+                              &occlusion->cullLayout, &occlusion->cullPipeline) != VK_SUCCESS) {
+        destroyOcclusionSystem(engine);
+        return;
+    }
+
+    occlusion->enabled = 1;
+}
+
+void invalidateHiZ(Engine* engine) {
+    OcclusionSystem* occlusion = engine->occlusion;
+    if (!occlusion) return;
+
+    for (uint32_t i = 0; i < occlusion->hizLevelCount; i++) {
+        vkDestroyImageView(engine->device, occlusion->hizLevelViews[i], NULL);
+        occlusion->hizLevelViews[i] = VK_NULL_HANDLE;
+    }
+    if (occlusion->hizView) vkDestroyImageView(engine->device, occlusion->hizView, NULL);
+    if (occlusion->hizImage) vkDestroyImage(engine->device, occlusion->hizImage, NULL);
+    if (occlusion->hizMemory) vkFreeMemory(engine->device, occlusion->hizMemory, NULL);
+    occlusion->hizView = VK_NULL_HANDLE;
+    occlusion->hizImage = VK_NULL_HANDLE;
+    occlusion->hizMemory = VK_NULL_HANDLE;
+    occlusion->hizLevelCount = 0;
+    occlusion->hizValid = 0;
+    occlusion->depthView = VK_NULL_HANDLE;
+}
+
+void destroyOcclusionSystem(Engine* engine) {
+    OcclusionSystem* occlusion = engine->occlusion;
+    if (!occlusion) return;
+
+    invalidateHiZ(engine);
+    if (occlusion->cullPipeline) vkDestroyPipeline(engine->device, occlusion->cullPipeline, NULL);
+    if (occlusion->hizPipeline) vkDestroyPipeline(engine->device, occlusion->hizPipeline, NULL);
+    if (occlusion->cullLayout) vkDestroyPipelineLayout(engine->device, occlusion->cullLayout, NULL);
+    if (occlusion->hizLayout) vkDestroyPipelineLayout(engine->device, occlusion->hizLayout, NULL);
+    if (occlusion->descriptorPool) vkDestroyDescriptorPool(engine->device, occlusion->descriptorPool, NULL);
+    if (occlusion->cullSetLayout) vkDestroyDescriptorSetLayout(engine->device, occlusion->cullSetLayout, NULL);
+    if (occlusion->hizSetLayout) vkDestroyDescriptorSetLayout(engine->device, occlusion->hizSetLayout, NULL);
+    if (occlusion->sampler) vkDestroySampler(engine->device, occlusion->sampler, NULL);
+
+    VkBuffer buffers[] = {occlusion->candidateBuffer, occlusion->matrixBuffer, occlusion->buffers.commandBuffer,
+                          occlusion->buffers.visibleBuffer, occlusion->pendingBuffer, occlusion->statsBuffer};
+    VkDeviceMemory memories[] = {occlusion->candidateMemory, occlusion->matrixMemory, occlusion->commandMemory,
+                                 occlusion->visibleMemory, occlusion->pendingMemory, occlusion->statsMemory};
+    for (uint32_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+        if (buffers[i]) vkDestroyBuffer(engine->device, buffers[i], NULL);
+        if (memories[i]) vkFreeMemory(engine->device, memories[i], NULL);
+    }
+
+    free(occlusion);
+    engine->occlusion = NULL;
+}
+
+static VkImageView createHiZView(Engine* engine, VkImage image, uint32_t baseLevel, uint32_t levelCount) {
+    VkImageViewCreateInfo viewInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = VK_FORMAT_R32_SFLOAT,
+        .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .subresourceRange.baseMipLevel = baseLevel,
+        .subresourceRange.levelCount = levelCount,
+        .subresourceRange.baseArrayLayer = 0,
+        .subresourceRange.layerCount = 1
+    };
+
+    VkImageView view = VK_NULL_HANDLE;
+    if (vkCreateImageView(engine->device, &viewInfo, NULL, &view) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create Hi-Z image view\n");
+    }
+    return view;
+}
+
+// Level 0 is the largest power of two not above the depth size, so every later level halves exactly.
+static int createHiZ(Engine* engine, OcclusionSystem* occlusion) {
+    uint32_t width = previousPowerOfTwo(engine->swapchainExtent.width);
+    uint32_t height = previousPowerOfTwo(engine->swapchainExtent.height);
+    uint32_t levels = 1;
+    while (levels < HIZ_MAX_LEVELS && ((width >> levels) > 0 || (height >> levels) > 0)) levels++;
+
+    VkImageCreateInfo imageInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R32_SFLOAT,
+        .extent = {width, height, 1},
+        .mipLevels = levels,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+
+    if (vkCreateImage(engine->device, &imageInfo, NULL, &occlusion->hizImage) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create Hi-Z image\n");
+        return 0;
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(engine->device, occlusion->hizImage, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memRequirements.size,
+        .memoryTypeIndex = findMemoryType(engine, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+    };
+
+    if (vkAllocateMemory(engine->device, &allocInfo, NULL, &occlusion->hizMemory) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate Hi-Z memory\n");
+        invalidateHiZ(engine);
+        return 0;
+    }
+    vkBindImageMemory(engine->device, occlusion->hizImage, occlusion->hizMemory, 0);
+
+    occlusion->hizView = createHiZView(engine, occlusion->hizImage, 0, levels);
+    for (uint32_t i = 0; i < levels; i++) {
+        occlusion->hizLevelViews[i] = createHiZView(engine, occlusion->hizImage, i, 1);
+        occlusion->hizLevelCount = i + 1;
+        if (occlusion->hizLevelViews[i] == VK_NULL_HANDLE) break;
+    }
+    if (occlusion->hizView == VK_NULL_HANDLE || occlusion->hizLevelViews[levels - 1] == VK_NULL_HANDLE) {
+        invalidateHiZ(engine);
+        return 0;
+    }
+    occlusion->hizWidth = width;
+    occlusion->hizHeight = height;
+
+    // Every level but the first reads the one above it; level 0 reads the depth attachment, which
+    // is bound once the frame graph has placed it.
+    VkDescriptorImageInfo sources[HIZ_MAX_LEVELS];
+    VkDescriptorImageInfo destinations[HIZ_MAX_LEVELS];
+    VkWriteDescriptorSet writes[HIZ_MAX_LEVELS * 2 + 1];
+    uint32_t writeCount = 0;
+    for (uint32_t i = 0; i < levels; i++) {
+        sources[i] = (VkDescriptorImageInfo){
+            .sampler = occlusion->sampler,
+            .imageView = i == 0 ? VK_NULL_HANDLE : occlusion->hizLevelViews[i - 1],
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+        };
+        destinations[i] = (VkDescriptorImageInfo){
+            .imageView = occlusion->hizLevelViews[i],
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+        };
+        if (i > 0) {
+            writes[writeCount++] = (VkWriteDescriptorSet){
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = occlusion->hizSets[i],
+                .dstBinding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = 1,
+                .pImageInfo = &sources[i]
+            };
+        }
+        writes[writeCount++] = (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = occlusion->hizSets[i],
+            .dstBinding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .pImageInfo = &destinations[i]
+        };
+    }
+
+    VkDescriptorImageInfo pyramid = {
+        .sampler = occlusion->sampler,
+        .imageView = occlusion->hizView,
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+    };
+    writes[writeCount++] = (VkWriteDescriptorSet){
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = occlusion->cullSet,
+        .dstBinding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .pImageInfo = &pyramid
+    };
+    vkUpdateDescriptorSets(engine->device, writeCount, writes, 0, NULL);
+    return 1;
+}
+
+const OcclusionBuffers* beginOcclusionFrame(Engine* engine) {
+    OcclusionSystem* occlusion = engine->occlusion;
+    if (!occlusion) return NULL;
+
+    memset(occlusion->stats, 0, sizeof(uint32_t) * OCCLUSION_STAT_COUNT);
+    if (!occlusion->enabled) return NULL;
+    if (occlusion->hizLevelCount == 0 && !createHiZ(engine, occlusion)) {
+        occlusion->enabled = 0;
+        return NULL;
+    }
+    return &occlusion->buffers;
+}
+
+// The pyramid outlives the frame, so it enters the graph as an import; a fresh or stale one has
+// no contents worth keeping. Returns GRAPH_NONE when occlusion culling is off this frame.
+uint32_t importHiZ(Engine* engine, RenderGraph* graph) {
+    OcclusionSystem* occlusion = engine->occlusion;
+    if (!occlusion || !occlusion->enabled || occlusion->hizLevelCount == 0) return GRAPH_NONE;
+
+    VkExtent2D extent = {occlusion->hizWidth, occlusion->hizHeight};
+    return graphImportImage(graph, "hi-z", occlusion->hizImage, occlusion->hizView, VK_FORMAT_R32_SFLOAT, extent,
+                            occlusion->hizValid ? GRAPH_ACCESS_COMPUTE_WRITE : GRAPH_ACCESS_NONE,
+                            GRAPH_ACCESS_COMPUTE_WRITE);
+}
+
+// The depth attachment only exists once the graph is compiled, and moves when it is reallocated.
+void bindOcclusionDepth(Engine* engine, VkImageView depthView) {
+    OcclusionSystem* occlusion = engine->occlusion;
+    if (!occlusion || occlusion->hizLevelCount == 0 || depthView == VK_NULL_HANDLE || depthView == occlusion->depthView) return;
+
+    VkDescriptorImageInfo source = {
+        .sampler = occlusion->sampler,
+        .imageView = depthView,
+        .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+    };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = occlusion->hizSets[0],
+        .dstBinding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .pImageInfo = &source
+    };
+    vkUpdateDescriptorSets(engine->device, 1, &write, 0, NULL);
+    occlusion->depthView = depthView;
+}
+
+void buildHiZ(Engine* engine, VkCommandBuffer commandBuffer) {
+    OcclusionSystem* occlusion = engine->occlusion;
+    if (!occlusion || !occlusion->enabled || occlusion->hizLevelCount == 0 || !occlusion->depthView) return;
+
+    // Levels depend on each other inside the pass; readers of the finished pyramid are synchronised
+    // by the frame graph.
+    VkMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+    };
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, occlusion->hizPipeline);
+    int32_t sourceWidth = (int32_t)engine->renderExtent.width;
+    int32_t sourceHeight = (int32_t)engine->renderExtent.height;
+    for (uint32_t i = 0; i < occlusion->hizLevelCount; i++) {
+        int32_t width = (int32_t)(occlusion->hizWidth >> i);
+        int32_t height = (int32_t)(occlusion->hizHeight >> i);
+        HiZPushConstants constants = {
+            {sourceWidth, sourceHeight},
+            {width > 0 ? width : 1, height > 0 ? height : 1}
+        };
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, occlusion->hizLayout,
+                                0, 1, &occlusion->hizSets[i], 0, NULL);
+        vkCmdPushConstants(commandBuffer, occlusion->hizLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vkCmdDispatch(commandBuffer, ((uint32_t)constants.destinationSize[0] + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE,
+                      ((uint32_t)constants.destinationSize[1] + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, 1);
+        if (i + 1 < occlusion->hizLevelCount) {
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0, 1, &barrier, 0, NULL, 0, NULL);
+        }
+
+        sourceWidth = constants.destinationSize[0];
+        sourceHeight = constants.destinationSize[1];
+    }
+    occlusion->hizValid = 1;
+}
+
+// Phase 0 tests every candidate against the previous frame's pyramid and remembers the rejected
+// ones; phase 1 re-tests only those against the pyramid built from this frame's first pass.
+void cullOcclusion(Engine* engine, VkCommandBuffer commandBuffer, uint32_t phase, uint32_t candidateCount) {
+    OcclusionSystem* occlusion = engine->occlusion;
+    if (!occlusion || !occlusion->enabled || candidateCount == 0) return;
+
+    CullPushConstants constants = {
+        .hizSize = {(int32_t)occlusion->hizWidth, (int32_t)occlusion->hizHeight},
+        .candidateCount = candidateCount,
+        .phase = phase,
+        .hizLevels = occlusion->hizValid ? occlusion->hizLevelCount : 0,
+        .commandOffset = phase ? MAX_MESH_INSTANCES : 0
+    };
+    memcpy(constants.viewProj, engine->viewProj, sizeof(constants.viewProj));
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, occlusion->cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, occlusion->cullLayout,
+                            0, 1, &occlusion->cullSet, 0, NULL);
+    vkCmdPushConstants(commandBuffer, occlusion->cullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(commandBuffer, (candidateCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+}
+
+EXPORT void engine_set_occlusion_culling(Engine* engine, int enabled) {
+    if (engine->capture) captureCall(engine, CAPTURE_SET_OCCLUSION_CULLING, (CaptureWord[]){{.i = enabled}}, 1, NULL, 0);
+    // Switching it off before the system exists only keeps the first mesh from creating it.
+    engine->occlusionDisabled = !enabled;
+    if (!engine->occlusion && enabled) createLazily(engine, "occlusion system", createOcclusionSystem);
+    if (!engine->occlusion) return;
+    // The pyramid is not maintained while disabled, so it must not be trusted when re-enabled.
+    engine->occlusion->enabled = enabled != 0;
+    engine->occlusion->hizValid = 0;
+}
+
+// Counts from the last rendered frame: first-pass draws, second-pass draws, occluded instances.
+EXPORT void engine_occlusion_stats(Engine* engine, uint32_t* stats) {
+    for (uint32_t i = 0; i < OCCLUSION_STAT_COUNT; i++) {
+        stats[i] = engine->occlusion && engine->occlusion->stats ? engine->occlusion->stats[i] : 0;
+    }
+}
@@ -33,11 +33,30 @@ VkShaderModule createShaderModule(VkDevice device, const char* filename) {
     return shaderModule;
 }
 
+// Shared by the vertex and mesh pipelines; created up front so all pipelines can compile at once.
+void createPipelineLayout(Engine* engine) {
+    createDescriptorSetLayout(engine);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &engine->descriptorSetLayout
+    };
+
+    if (vkCreatePipelineLayout(engine->device, &pipelineLayoutInfo, NULL, &engine->pipelineLayout) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create pipeline layout\n");
+    }
+}
+
 void createGraphicsPipeline(Engine* engine) {
     VkShaderModule vertShaderModule = createShaderModule(engine->device, ".shaders/vertex3d.spv");
     VkShaderModule fragShaderModule = createShaderModule(engine->device, ".shaders/fragment3d.spv");
 
-    if (vertShaderModule == VK_NULL_HANDLE || fragShaderModule == VK_NULL_HANDLE) return;
+    if (vertShaderModule == VK_NULL_HANDLE || fragShaderModule == VK_NULL_HANDLE || engine->pipelineLayout == VK_NULL_HANDLE) {
+        if (vertShaderModule) vkDestroyShaderModule(engine->device, vertShaderModule, NULL);
+        if (fragShaderModule) vkDestroyShaderModule(engine->device, fragShaderModule, NULL);
+        return;
+    }
 
     VkPipelineShaderStageCreateInfo shaderStages[] = {
         {
@@ -79,26 +98,145 @@ void createGraphicsPipeline(Engine* engine) {
         .primitiveRestartEnable = VK_FALSE
     };
 
-    VkViewport viewport = {
-        .x = 0.0f,
-        .y = 0.0f,
-        .width = (float)engine->swapchainExtent.width,
-        .height = (float)engine->swapchainExtent.height,
-        .minDepth = 0.0f,
-        .maxDepth = 1.0f
+    VkPipelineViewportStateCreateInfo viewportState = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1
+    };
+
+    // Every window draws with this pipeline at its own size.
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = 2,
+        .pDynamicStates = dynamicStates
+    };
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .depthClampEnable = VK_FALSE,
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .lineWidth = 1.0f,
+        .cullMode = VK_CULL_MODE_BACK_BIT,
+        .frontFace = VK_FRONT_FACE_CLOCKWISE,
+        .depthBiasEnable = VK_FALSE
+    };
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .sampleShadingEnable = VK_FALSE,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+    };
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = VK_TRUE,
+        .depthWriteEnable = VK_TRUE,
+        .depthCompareOp = VK_COMPARE_OP_LESS,
+        .depthBoundsTestEnable = VK_FALSE,
+        .stencilTestEnable = VK_FALSE
+    };
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {
+        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+        .blendEnable = VK_FALSE
+    };
+
+    VkPipelineColorBlendStateCreateInfo colorBlending = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .logicOpEnable = VK_FALSE,
+        .attachmentCount = 1,
+        .pAttachments = &colorBlendAttachment
+    };
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .stageCount = 2,
+        .pStages = shaderStages,
+        .pVertexInputState = &vertexInputInfo,
+        .pInputAssemblyState = &inputAssembly,
+        .pViewportState = &viewportState,
+        .pRasterizationState = &rasterizer,
+        .pMultisampleState = &multisampling,
+        .pDepthStencilState = &depthStencil,
+        .pColorBlendState = &colorBlending,
+        .pDynamicState = &dynamicState,
+        .layout = engine->pipelineLayout,
+        .renderPass = engine->renderPass,
+        .subpass = 0
     };
 
-    VkRect2D scissor = {
-        .offset = {0, 0},
-        .extent = engine->swapchainExtent
+    if (vkCreateGraphicsPipelines(engine->device, engine->pipelineCache, 1, &pipelineInfo, NULL, &engine->graphicsPipeline) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create graphics pipeline\n");
+    }
+
+    vkDestroyShaderModule(engine->device, fragShaderModule, NULL);
+    vkDestroyShaderModule(engine->device, vertShaderModule, NULL);
+}
+
+void createSpritePipeline(Engine* engine) {
+    VkShaderModule vertShaderModule = createShaderModule(engine->device, ".shaders/vertex2d.spv");
+    VkShaderModule fragShaderModule = createShaderModule(engine->device, ".shaders/fragment2d.spv");
+
+    if (vertShaderModule == VK_NULL_HANDLE || fragShaderModule == VK_NULL_HANDLE) {
+        if (vertShaderModule) vkDestroyShaderModule(engine->device, vertShaderModule, NULL);
+        if (fragShaderModule) vkDestroyShaderModule(engine->device, fragShaderModule, NULL);
+        return;
+    }
+
+    VkPipelineShaderStageCreateInfo shaderStages[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vertShaderModule,
+            .pName = "main"
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fragShaderModule,
+            .pName = "main"
+        }
+    };
+
+    VkVertexInputBindingDescription bindingDescription = {
+        .binding = 0,
+        .stride = sizeof(SpriteInstance),
+        .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE
+    };
+
+    VkVertexInputAttributeDescription attributeDescriptions[] = {
+        { .location = 0, .binding = 0, .format = VK_FORMAT_R32G32B32A32_SFLOAT, .offset = offsetof(SpriteInstance, x) },
+        { .location = 1, .binding = 0, .format = VK_FORMAT_R32G32B32A32_SFLOAT, .offset = offsetof(SpriteInstance, u0) },
+        { .location = 2, .binding = 0, .format = VK_FORMAT_R8G8B8A8_UNORM, .offset = offsetof(SpriteInstance, color) }
+    };
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = 1,
+        .pVertexBindingDescriptions = &bindingDescription,
+        .vertexAttributeDescriptionCount = 3,
+        .pVertexAttributeDescriptions = attributeDescriptions
+    };
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .primitiveRestartEnable = VK_FALSE
     };
 
     VkPipelineViewportStateCreateInfo viewportState = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
         .viewportCount = 1,
-        .pViewports = &viewport,
-        .scissorCount = 1,
-        .pScissors = &scissor
+        .scissorCount = 1
+    };
+
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = 2,
+        .pDynamicStates = dynamicStates
     };
 
     VkPipelineRasterizationStateCreateInfo rasterizer = {
@@ -107,7 +245,7 @@ void createGraphicsPipeline(Engine* engine) {
         .rasterizerDiscardEnable = VK_FALSE,
         .polygonMode = VK_POLYGON_MODE_FILL,
         .lineWidth = 1.0f,
-        .cullMode = VK_CULL_MODE_BACK_BIT,
+        .cullMode = VK_CULL_MODE_NONE,
         .frontFace = VK_FRONT_FACE_CLOCKWISE,
         .depthBiasEnable = VK_FALSE
     };
@@ -118,9 +256,25 @@ void createGraphicsPipeline(Engine* engine) {
         .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
     };
 
+    // Sprites are a 2D overlay: drawn in submission order on top of the 3D scene.
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = VK_FALSE,
+        .depthWriteEnable = VK_FALSE,
+        .depthCompareOp = VK_COMPARE_OP_ALWAYS,
+        .depthBoundsTestEnable = VK_FALSE,
+        .stencilTestEnable = VK_FALSE
+    };
+
     VkPipelineColorBlendAttachmentState colorBlendAttachment = {
         .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-        .blendEnable = VK_FALSE
+        .blendEnable = VK_TRUE,
+        .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .colorBlendOp = VK_BLEND_OP_ADD,
+        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .alphaBlendOp = VK_BLEND_OP_ADD
     };
 
     VkPipelineColorBlendStateCreateInfo colorBlending = {
@@ -130,16 +284,24 @@ void createGraphicsPipeline(Engine* engine) {
         .pAttachments = &colorBlendAttachment
     };
 
-    createDescriptorSetLayout(engine);
+    VkPushConstantRange pushConstantRange = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+        .offset = 0,
+        .size = sizeof(float) * 4 + sizeof(uint32_t) * 2
+    };
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         .setLayoutCount = 1,
-        .pSetLayouts = &engine->descriptorSetLayout
+        .pSetLayouts = &engine->descriptorSetLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange
     };
 
-    if (vkCreatePipelineLayout(engine->device, &pipelineLayoutInfo, NULL, &engine->pipelineLayout) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to create pipeline layout\n");
+    if (vkCreatePipelineLayout(engine->device, &pipelineLayoutInfo, NULL, &engine->spritePipelineLayout) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create sprite pipeline layout\n");
+        vkDestroyShaderModule(engine->device, fragShaderModule, NULL);
+        vkDestroyShaderModule(engine->device, vertShaderModule, NULL);
         return;
     }
 
@@ -152,16 +314,167 @@ void createGraphicsPipeline(Engine* engine) {
         .pViewportState = &viewportState,
         .pRasterizationState = &rasterizer,
         .pMultisampleState = &multisampling,
+        .pDepthStencilState = &depthStencil,
         .pColorBlendState = &colorBlending,
-        .layout = engine->pipelineLayout,
+        .pDynamicState = &dynamicState,
+        .layout = engine->spritePipelineLayout,
         .renderPass = engine->renderPass,
         .subpass = 0
     };
 
-    if (vkCreateGraphicsPipelines(engine->device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &engine->graphicsPipeline) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to create graphics pipeline\n");
+    if (vkCreateGraphicsPipelines(engine->device, engine->pipelineCache, 1, &pipelineInfo, NULL, &engine->spritePipeline) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create sprite pipeline\n");
     }
 
     vkDestroyShaderModule(engine->device, fragShaderModule, NULL);
     vkDestroyShaderModule(engine->device, vertShaderModule, NULL);
-}
\ No newline at end of file
+}
+
+void createMeshPipelines(Engine* engine) {
+    VkShaderModule vertShaderModule = createShaderModule(engine->device, ".shaders/vertexmesh.spv");
+    VkShaderModule fragShaderModule = createShaderModule(engine->device, ".shaders/fragment3d.spv");
+
+    if (vertShaderModule == VK_NULL_HANDLE || fragShaderModule == VK_NULL_HANDLE || engine->pipelineLayout == VK_NULL_HANDLE) {
+        if (vertShaderModule) vkDestroyShaderModule(engine->device, vertShaderModule, NULL);
+        if (fragShaderModule) vkDestroyShaderModule(engine->device, fragShaderModule, NULL);
+        return;
+    }
+
+    VkPipelineShaderStageCreateInfo shaderStages[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vertShaderModule,
+            .pName = "main"
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fragShaderModule,
+            .pName = "main"
+        }
+    };
+
+    // Binding 1 carries one world matrix per instance; firstInstance selects the slice for a draw.
+    // Quantized layouts have their dequantization folded into that matrix, and 4-component
+    // positions and RGBA8 colours feed the same vec3 inputs, so only the vertex fetch differs.
+    VkVertexInputBindingDescription bindingDescriptions[MESH_LAYOUT_COUNT][2];
+    VkVertexInputAttributeDescription attributeDescriptions[MESH_LAYOUT_COUNT][6];
+    VkPipelineVertexInputStateCreateInfo vertexInputInfos[MESH_LAYOUT_COUNT];
+    for (uint32_t layout = 0; layout < MESH_LAYOUT_COUNT; layout++) {
+        int quantized = layout != MESH_LAYOUT_POSITION_COLOR;
+        VkFormat positionFormat = layout == MESH_LAYOUT_HALF_POSITION ? VK_FORMAT_R16G16B16A16_SFLOAT
+                                  : layout == MESH_LAYOUT_SNORM16_POSITION ? VK_FORMAT_R16G16B16A16_SNORM
+                                  : VK_FORMAT_R32G32B32_SFLOAT;
+
+        VkVertexInputBindingDescription* bindings = bindingDescriptions[layout];
+        bindings[0] = (VkVertexInputBindingDescription){0, vertexLayoutStride(layout), VK_VERTEX_INPUT_RATE_VERTEX};
+        bindings[1] = (VkVertexInputBindingDescription){1, sizeof(Mat4), VK_VERTEX_INPUT_RATE_INSTANCE};
+
+        VkVertexInputAttributeDescription* attributes = attributeDescriptions[layout];
+        attributes[0] = (VkVertexInputAttributeDescription){0, 0, positionFormat, 0};
+        attributes[1] = (VkVertexInputAttributeDescription){1, 0, quantized ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R32G32B32_SFLOAT,
+                                                            quantized ? offsetof(QuantizedVertex, r) : offsetof(Vertex3D, r)};
+        for (uint32_t column = 0; column < 4; column++) {
+            attributes[2 + column] = (VkVertexInputAttributeDescription){2 + column, 1, VK_FORMAT_R32G32B32A32_SFLOAT,
+                                                                         sizeof(float) * 4 * column};
+        }
+
+        vertexInputInfos[layout] = (VkPipelineVertexInputStateCreateInfo){
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+            .vertexBindingDescriptionCount = 2,
+            .pVertexBindingDescriptions = bindings,
+            .vertexAttributeDescriptionCount = 6,
+            .pVertexAttributeDescriptions = attributes
+        };
+    }
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .primitiveRestartEnable = VK_FALSE
+    };
+
+    VkPipelineViewportStateCreateInfo viewportState = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1
+    };
+
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = 2,
+        .pDynamicStates = dynamicStates
+    };
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .depthClampEnable = VK_FALSE,
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .lineWidth = 1.0f,
+        .cullMode = VK_CULL_MODE_BACK_BIT,
+        .frontFace = VK_FRONT_FACE_CLOCKWISE,
+        .depthBiasEnable = VK_FALSE
+    };
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .sampleShadingEnable = VK_FALSE,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+    };
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = VK_TRUE,
+        .depthWriteEnable = VK_TRUE,
+        .depthCompareOp = VK_COMPARE_OP_LESS,
+        .depthBoundsTestEnable = VK_FALSE,
+        .stencilTestEnable = VK_FALSE
+    };
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {
+        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+        .blendEnable = VK_FALSE
+    };
+
+    VkPipelineColorBlendStateCreateInfo colorBlending = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .logicOpEnable = VK_FALSE,
+        .attachmentCount = 1,
+        .pAttachments = &colorBlendAttachment
+    };
+
+    VkGraphicsPipelineCreateInfo pipelineInfos[MESH_LAYOUT_COUNT];
+    for (uint32_t layout = 0; layout < MESH_LAYOUT_COUNT; layout++) {
+        pipelineInfos[layout] = (VkGraphicsPipelineCreateInfo){
+            .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+            .stageCount = 2,
+            .pStages = shaderStages,
+            .pVertexInputState = &vertexInputInfos[layout],
+            .pInputAssemblyState = &inputAssembly,
+            .pViewportState = &viewportState,
+            .pRasterizationState = &rasterizer,
+            .pMultisampleState = &multisampling,
+            .pDepthStencilState = &depthStencil,
+            .pColorBlendState = &colorBlending,
+            .pDynamicState = &dynamicState,
+            .layout = engine->pipelineLayout,
+            .renderPass = engine->renderPass,
+            .subpass = 0
+        };
+    }
+
+    if (vkCreateGraphicsPipelines(engine->device, engine->pipelineCache, MESH_LAYOUT_COUNT, pipelineInfos, NULL,
+                                  engine->meshPipelines) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create mesh pipelines\n");
+        for (uint32_t layout = 0; layout < MESH_LAYOUT_COUNT; layout++) {
+            if (engine->meshPipelines[layout]) vkDestroyPipeline(engine->device, engine->meshPipelines[layout], NULL);
+            engine->meshPipelines[layout] = VK_NULL_HANDLE;
+        }
+    }
+
+    vkDestroyShaderModule(engine->device, fragShaderModule, NULL);
+    vkDestroyShaderModule(engine->device, vertShaderModule, NULL);
+}
@@ -0,0 +1,970 @@
+#include "engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GRAPH_MAX_PASSES 32
+#define GRAPH_MAX_RESOURCES 32
+#define GRAPH_MAX_PASS_USES 8
+#define GRAPH_MAX_ATTACHMENTS 4
+#define GRAPH_MAX_BARRIERS 128
+#define GRAPH_MAX_RENDER_PASSES 16
+#define GRAPH_MAX_FRAMEBUFFERS 64
+
+enum {
+    GRAPH_STAT_PASSES,
+    GRAPH_STAT_CULLED,
+    GRAPH_STAT_BARRIERS,
+    GRAPH_STAT_TRANSIENT_BYTES,  // sum of all transient images
+    GRAPH_STAT_ALLOCATED_BYTES,  // memory actually allocated for them after aliasing
+    GRAPH_STAT_LAZY_BYTES,       // part of the above in lazily allocated memory
+    GRAPH_STAT_COUNT
+};
+
+typedef struct {
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    VkImageLayout layout;
+    int write;
+    VkImageUsageFlags usage;  // what a transient image needs to support the access
+} AccessInfo;
+
+static const AccessInfo accessInfo[GRAPH_ACCESS_COUNT] = {
+    [GRAPH_ACCESS_NONE] = {0, 0, VK_IMAGE_LAYOUT_UNDEFINED, 0, 0},
+    [GRAPH_ACCESS_COLOR_ATTACHMENT] = {
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, 1, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+    },
+    [GRAPH_ACCESS_DEPTH_ATTACHMENT] = {
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+    },
+    [GRAPH_ACCESS_DEPTH_SAMPLED] = {
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, 0, VK_IMAGE_USAGE_SAMPLED_BIT
+    },
+    [GRAPH_ACCESS_COMPUTE_READ] = {
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_IMAGE_LAYOUT_GENERAL, 0, VK_IMAGE_USAGE_SAMPLED_BIT
+    },
+    [GRAPH_ACCESS_COMPUTE_WRITE] = {
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_IMAGE_LAYOUT_GENERAL, 1, VK_IMAGE_USAGE_STORAGE_BIT
+    },
+    [GRAPH_ACCESS_INDIRECT_READ] = {
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, 0, 0
+    },
+    [GRAPH_ACCESS_TRANSFER_WRITE] = {
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, VK_IMAGE_USAGE_TRANSFER_DST_BIT
+    },
+    [GRAPH_ACCESS_TRANSFER_READ] = {
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 0, VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+    },
+    [GRAPH_ACCESS_PRESENT] = {
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0, 0
+    }
+};
+
+typedef struct {
+    uint32_t resource;
+    GraphAccess access;
+    int clear;
+    VkClearValue clearValue;
+} GraphUse;
+
+typedef struct {
+    const char* name;
+    GraphPassType type;
+    GraphRecordFn record;
+    void* userData;
+    GraphUse uses[GRAPH_MAX_PASS_USES];
+    uint32_t useCount;
+    int sideEffects;
+    int needed;
+
+    // Compiled: one batched barrier before the pass, and the render pass of graphics passes.
+    VkPipelineStageFlags srcStages;
+    VkPipelineStageFlags dstStages;
+    VkAccessFlags memorySrcAccess;
+    VkAccessFlags memoryDstAccess;
+    uint32_t firstBarrier;
+    uint32_t barrierCount;
+    VkRenderPass renderPass;
+    VkFramebuffer framebuffer;
+    VkExtent2D extent;
+    VkExtent2D renderArea;  // zero: the whole framebuffer
+    VkClearValue clearValues[GRAPH_MAX_ATTACHMENTS];
+    uint32_t attachmentCount;
+} GraphPass;
+
+typedef struct {
+    const char* name;
+    int isImage;
+    int imported;
+    VkImage image;
+    VkImageView view;
+    VkFormat format;
+    VkExtent2D extent;
+    VkImageAspectFlags aspect;
+    GraphAccess initial;
+    GraphAccess final;
+    VkImageUsageFlags usage;
+    uint32_t firstPass;
+    uint32_t lastPass;
+    uint32_t transient;
+
+    // Compile-time tracking: the last writer, readers since then, and what was made visible.
+    VkImageLayout layout;
+    int hasContent;
+    VkPipelineStageFlags writeStages;
+    VkAccessFlags writeAccess;
+    VkPipelineStageFlags readStages;
+    VkPipelineStageFlags visibleStages;
+    VkAccessFlags visibleAccess;
+} GraphResource;
+
+// Everything that decides a transient's memory; when a frame declares the same set as the last
+// one the images and their aliased memory are reused as they are.
+typedef struct {
+    VkFormat format;
+    VkExtent2D extent;
+    VkImageUsageFlags usage;
+    uint32_t firstPass;
+    uint32_t lastPass;
+} GraphTransientDesc;
+
+typedef struct {
+    GraphTransientDesc desc;
+    VkImage image;
+    VkImageView view;
+    VkMemoryRequirements requirements;
+    uint32_t memoryType;
+    int lazy;
+    uint32_t block;
+} GraphTransient;
+
+typedef struct {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    uint32_t memoryType;
+    int lazy;
+} GraphBlock;
+
+typedef struct {
+    uint32_t attachmentCount;
+    VkFormat formats[GRAPH_MAX_ATTACHMENTS];
+    VkImageLayout layouts[GRAPH_MAX_ATTACHMENTS];
+    VkAttachmentLoadOp loadOps[GRAPH_MAX_ATTACHMENTS];
+    VkAttachmentStoreOp storeOps[GRAPH_MAX_ATTACHMENTS];
+} RenderPassKey;
+
+typedef struct {
+    VkRenderPass renderPass;
+    uint32_t attachmentCount;
+    VkImageView views[GRAPH_MAX_ATTACHMENTS];
+    VkExtent2D extent;
+} FramebufferKey;
+
+struct RenderGraph {
+    GraphPass passes[GRAPH_MAX_PASSES];
+    uint32_t passCount;
+    GraphResource resources[GRAPH_MAX_RESOURCES];
+    uint32_t resourceCount;
+    VkImageMemoryBarrier barriers[GRAPH_MAX_BARRIERS];
+    uint32_t barrierCount;
+    int compiled;
+
+    // Transitions back to the state each imported resource is expected in next frame.
+    VkPipelineStageFlags finalSrcStages;
+    VkPipelineStageFlags finalDstStages;
+    uint32_t firstFinalBarrier;
+    uint32_t finalBarrierCount;
+
+    GraphTransient transients[GRAPH_MAX_RESOURCES];
+    uint32_t transientCount;
+    GraphBlock blocks[GRAPH_MAX_RESOURCES];
+    uint32_t blockCount;
+
+    RenderPassKey renderPassKeys[GRAPH_MAX_RENDER_PASSES];
+    VkRenderPass renderPasses[GRAPH_MAX_RENDER_PASSES];
+    uint32_t renderPassCount;
+    FramebufferKey framebufferKeys[GRAPH_MAX_FRAMEBUFFERS];
+    VkFramebuffer framebuffers[GRAPH_MAX_FRAMEBUFFERS];
+    uint64_t framebufferFrames[GRAPH_MAX_FRAMEBUFFERS];  // frame index of the last use
+    uint32_t framebufferCount;
+
+    uint64_t stats[GRAPH_STAT_COUNT];
+};
+
+void createRenderGraph(Engine* engine) {
+    RenderGraph* graph = (RenderGraph*)calloc(1, sizeof(RenderGraph));
+    if (!graph) {
+        fprintf(stderr, "Failed to allocate memory for render graph\n");
+        return;
+    }
+    engine->graph = graph;
+}
+
+static void destroyTransients(Engine* engine, RenderGraph* graph) {
+    for (uint32_t i = 0; i < graph->transientCount; i++) {
+        GraphTransient* transient = &graph->transients[i];
+        if (transient->view) vkDestroyImageView(engine->device, transient->view, NULL);
+        if (transient->image) vkDestroyImage(engine->device, transient->image, NULL);
+    }
+    for (uint32_t i = 0; i < graph->blockCount; i++) {
+        if (graph->blocks[i].memory) vkFreeMemory(engine->device, graph->blocks[i].memory, NULL);
+    }
+    memset(graph->transients, 0, sizeof(graph->transients));
+    memset(graph->blocks, 0, sizeof(graph->blocks));
+    graph->transientCount = 0;
+    graph->blockCount = 0;
+}
+
+// Framebuffers reference image views, so they have to go whenever a swapchain is recreated.
+void graphInvalidate(Engine* engine) {
+    RenderGraph* graph = engine->graph;
+    if (!graph) return;
+
+    for (uint32_t i = 0; i < graph->framebufferCount; i++) {
+        vkDestroyFramebuffer(engine->device, graph->framebuffers[i], NULL);
+    }
+    graph->framebufferCount = 0;
+}
+
+void destroyRenderGraph(Engine* engine) {
+    RenderGraph* graph = engine->graph;
+    if (!graph) return;
+
+    graphInvalidate(engine);
+    destroyTransients(engine, graph);
+    for (uint32_t i = 0; i < graph->renderPassCount; i++) {
+        vkDestroyRenderPass(engine->device, graph->renderPasses[i], NULL);
+    }
+    free(graph);
+    engine->graph = NULL;
+}
+
+void graphBegin(RenderGraph* graph) {
+    graph->passCount = 0;
+    graph->resourceCount = 0;
+    graph->barrierCount = 0;
+    graph->compiled = 0;
+}
+
+static uint32_t addResource(RenderGraph* graph, const char* name) {
+    if (graph->resourceCount == GRAPH_MAX_RESOURCES) {
+        fprintf(stderr, "Render graph: too many resources, max is %d\n", GRAPH_MAX_RESOURCES);
+        return GRAPH_NONE;
+    }
+    GraphResource* resource = &graph->resources[graph->resourceCount];
+    memset(resource, 0, sizeof(GraphResource));
+    resource->name = name;
+    resource->firstPass = UINT32_MAX;
+    resource->transient = UINT32_MAX;
+    return graph->resourceCount++;
+}
+
+static VkImageAspectFlags formatAspect(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+// `initial` is the state the image is in when the frame starts (NONE: contents are not needed),
+// `final` the state it must be left in (NONE: nothing after the frame reads it). Passes writing
+// an image with a final state are never culled.
+uint32_t graphImportImage(RenderGraph* graph, const char* name, VkImage image, VkImageView view, VkFormat format,
+                          VkExtent2D extent, GraphAccess initial, GraphAccess final) {
+    uint32_t index = addResource(graph, name);
+    if (index == GRAPH_NONE) return GRAPH_NONE;
+
+    GraphResource* resource = &graph->resources[index];
+    resource->isImage = 1;
+    resource->imported = 1;
+    resource->image = image;
+    resource->view = view;
+    resource->format = format;
+    resource->extent = extent;
+    resource->aspect = formatAspect(format);
+    resource->initial = initial;
+    resource->final = final;
+    return index;
+}
+
+// Buffers are synchronised with global memory barriers, so they are tracked without a handle.
+uint32_t graphImportBuffer(RenderGraph* graph, const char* name, GraphAccess initial, GraphAccess final) {
+    uint32_t index = addResource(graph, name);
+    if (index == GRAPH_NONE) return GRAPH_NONE;
+
+    GraphResource* resource = &graph->resources[index];
+    resource->imported = 1;
+    resource->initial = initial;
+    resource->final = final;
+    return index;
+}
+
+// A frame-local image. Its usage flags follow from the passes using it, its contents never survive
+// the frame and its memory is shared with other transients whose lifetimes don't overlap.
+uint32_t graphCreateImage(RenderGraph* graph, const char* name, VkFormat format, VkExtent2D extent) {
+    uint32_t index = addResource(graph, name);
+    if (index == GRAPH_NONE) return GRAPH_NONE;
+
+    GraphResource* resource = &graph->resources[index];
+    resource->isImage = 1;
+    resource->format = format;
+    resource->extent = extent;
+    resource->aspect = formatAspect(format);
+    return index;
+}
+
+uint32_t graphAddPass(RenderGraph* graph, const char* name, GraphPassType type, GraphRecordFn record, void* userData) {
+    if (graph->passCount == GRAPH_MAX_PASSES) {
+        fprintf(stderr, "Render graph: too many passes, max is %d\n", GRAPH_MAX_PASSES);
+        return GRAPH_NONE;
+    }
+    GraphPass* pass = &graph->passes[graph->passCount];
+    memset(pass, 0, sizeof(GraphPass));
+    pass->name = name;
+    pass->type = type;
+    pass->record = record;
+    pass->userData = userData;
+    return graph->passCount++;
+}
+
+void graphUse(RenderGraph* graph, uint32_t pass, uint32_t resource, GraphAccess access) {
+    if (pass >= graph->passCount || resource >= graph->resourceCount) return;
+    GraphPass* graphPass = &graph->passes[pass];
+    if (graphPass->useCount == GRAPH_MAX_PASS_USES) {
+        fprintf(stderr, "Render graph: pass %s uses too many resources\n", graphPass->name);
+        return;
+    }
+    graphPass->uses[graphPass->useCount++] = (GraphUse){resource, access, 0, {{{0}}}};
+    graph->resources[resource].usage |= accessInfo[access].usage;
+}
+
+// Attaches and clears: the previous contents of the resource are not needed by this pass.
+void graphClear(RenderGraph* graph, uint32_t pass, uint32_t resource, GraphAccess access, VkClearValue value) {
+    graphUse(graph, pass, resource, access);
+    if (pass >= graph->passCount || resource >= graph->resourceCount) return;
+    GraphPass* graphPass = &graph->passes[pass];
+    GraphUse* use = &graphPass->uses[graphPass->useCount - 1];
+    if (use->resource != resource) return;
+    use->clear = 1;
+    use->clearValue = value;
+}
+
+// The pass does work the graph cannot see (host readback, uploads with their own barriers).
+void graphSideEffects(RenderGraph* graph, uint32_t pass) {
+    if (pass < graph->passCount) graph->passes[pass].sideEffects = 1;
+}
+
+// Restricts a graphics pass to the top-left `area` of its attachments; the rest keeps its contents.
+void graphRenderArea(RenderGraph* graph, uint32_t pass, VkExtent2D area) {
+    if (pass < graph->passCount) graph->passes[pass].renderArea = area;
+}
+
+VkImage graphImage(RenderGraph* graph, uint32_t resource) {
+    if (!graph->compiled || resource >= graph->resourceCount) return VK_NULL_HANDLE;
+    return graph->resources[resource].image;
+}
+
+VkImageView graphImageView(RenderGraph* graph, uint32_t resource) {
+    if (!graph->compiled || resource >= graph->resourceCount) return VK_NULL_HANDLE;
+    return graph->resources[resource].view;
+}
+
+static int isAttachment(GraphAccess access) {
+    return access == GRAPH_ACCESS_COLOR_ATTACHMENT || access == GRAPH_ACCESS_DEPTH_ATTACHMENT;
+}
+
+// Walks the passes backwards: a pass is kept when it has side effects or writes something that is
+// exported or needed by a kept pass after it. A clear ends the dependency on earlier writers.
+static void cullPasses(RenderGraph* graph) {
+    int needed[GRAPH_MAX_RESOURCES];
+    for (uint32_t r = 0; r < graph->resourceCount; r++) {
+        const GraphResource* resource = &graph->resources[r];
+        needed[r] = resource->imported && resource->final != GRAPH_ACCESS_NONE;
+    }
+
+    for (uint32_t p = graph->passCount; p-- > 0;) {
+        GraphPass* pass = &graph->passes[p];
+        pass->needed = pass->sideEffects;
+        for (uint32_t u = 0; u < pass->useCount && !pass->needed; u++) {
+            const GraphUse* use = &pass->uses[u];
+            if (accessInfo[use->access].write && needed[use->resource]) pass->needed = 1;
+        }
+        if (!pass->needed) continue;
+
+        for (uint32_t u = 0; u < pass->useCount; u++) {
+            const GraphUse* use = &pass->uses[u];
+            needed[use->resource] = !use->clear;
+        }
+    }
+}
+
+// Images are created first so their real requirements are known, then packed greedily (largest
+// first) into blocks of one memory type where no two members are alive in the same pass.
+static int allocateTransients(Engine* engine, RenderGraph* graph, const GraphTransientDesc* descs, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        GraphTransient* transient = &graph->transients[i];
+        transient->desc = descs[i];
+        graph->transientCount = i + 1;
+
+        VkImageUsageFlags attachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        int lazy = (descs[i].usage & ~attachmentUsage) == 0;
+        VkImageCreateInfo imageInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = descs[i].format,
+            .extent = {descs[i].extent.width, descs[i].extent.height, 1},
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = descs[i].usage | (lazy ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0),
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+        };
+
+        if (vkCreateImage(engine->device, &imageInfo, NULL, &transient->image) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to create transient image\n");
+            return 0;
+        }
+        vkGetImageMemoryRequirements(engine->device, transient->image, &transient->requirements);
+
+        // Attachment-only images never need to be backed on tilers that can keep them on chip.
+        transient->memoryType = UINT32_MAX;
+        if (lazy) {
+            transient->memoryType = findMemoryType(engine, transient->requirements.memoryTypeBits,
+                                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+        }
+        transient->lazy = transient->memoryType != UINT32_MAX;
+        if (!transient->lazy) {
+            transient->memoryType = findMemoryType(engine, transient->requirements.memoryTypeBits,
+                                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
+        if (transient->memoryType == UINT32_MAX) {
+            fprintf(stderr, "No memory type for transient image\n");
+            return 0;
+        }
+    }
+
+    uint32_t order[GRAPH_MAX_RESOURCES];
+    for (uint32_t i = 0; i < count; i++) order[i] = i;
+    for (uint32_t i = 1; i < count; i++) {
+        uint32_t value = order[i];
+        uint32_t j = i;
+        while (j > 0 && graph->transients[order[j - 1]].requirements.size < graph->transients[value].requirements.size) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = value;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        GraphTransient* transient = &graph->transients[order[i]];
+        uint32_t block = UINT32_MAX;
+        for (uint32_t b = 0; b < graph->blockCount && block == UINT32_MAX; b++) {
+            if (graph->blocks[b].memoryType != transient->memoryType) continue;
+            int overlaps = 0;
+            for (uint32_t j = 0; j < i && !overlaps; j++) {
+                const GraphTransient* other = &graph->transients[order[j]];
+                overlaps = other->block == b && other->desc.firstPass <= transient->desc.lastPass &&
+                           transient->desc.firstPass <= other->desc.lastPass;
+            }
+            if (!overlaps) block = b;
+        }
+        if (block == UINT32_MAX) {
+            block = graph->blockCount++;
+            graph->blocks[block].memoryType = transient->memoryType;
+            graph->blocks[block].lazy = transient->lazy;
+        }
+
+        // Every member is bound at offset 0, so the block takes the largest size and alignment.
+        GraphBlock* graphBlock = &graph->blocks[block];
+        if (transient->requirements.size > graphBlock->size) graphBlock->size = transient->requirements.size;
+        transient->block = block;
+    }
+
+    for (uint32_t b = 0; b < graph->blockCount; b++) {
+        VkMemoryAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .allocationSize = graph->blocks[b].size,
+            .memoryTypeIndex = graph->blocks[b].memoryType
+        };
+        if (vkAllocateMemory(engine->device, &allocInfo, NULL, &graph->blocks[b].memory) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to allocate transient memory\n");
+            return 0;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        GraphTransient* transient = &graph->transients[i];
+        vkBindImageMemory(engine->device, transient->image, graph->blocks[transient->block].memory, 0);
+
+        VkImageViewCreateInfo viewInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = transient->image,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = transient->desc.format,
+            .subresourceRange.aspectMask = formatAspect(transient->desc.format) & ~VK_IMAGE_ASPECT_STENCIL_BIT,
+            .subresourceRange.baseMipLevel = 0,
+            .subresourceRange.levelCount = 1,
+            .subresourceRange.baseArrayLayer = 0,
+            .subresourceRange.layerCount = 1
+        };
+        if (vkCreateImageView(engine->device, &viewInfo, NULL, &transient->view) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to create transient image view\n");
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int prepareTransients(Engine* engine, RenderGraph* graph) {
+    GraphTransientDesc descs[GRAPH_MAX_RESOURCES];
+    uint32_t count = 0;
+    for (uint32_t r = 0; r < graph->resourceCount; r++) {
+        GraphResource* resource = &graph->resources[r];
+        if (resource->imported || resource->firstPass == UINT32_MAX) continue;
+        memset(&descs[count], 0, sizeof(GraphTransientDesc));
+        descs[count].format = resource->format;
+        descs[count].extent = resource->extent;
+        descs[count].usage = resource->usage;
+        descs[count].firstPass = resource->firstPass;
+        descs[count].lastPass = resource->lastPass;
+        resource->transient = count++;
+    }
+
+    int reuse = count == graph->transientCount;
+    for (uint32_t i = 0; i < count && reuse; i++) {
+        reuse = memcmp(&descs[i], &graph->transients[i].desc, sizeof(GraphTransientDesc)) == 0;
+    }
+
+    if (!reuse) {
+        // Relies on the previous frame having finished, as engine_run waits for the queue.
+        graphInvalidate(engine);
+        destroyTransients(engine, graph);
+        if (!allocateTransients(engine, graph, descs, count)) {
+            destroyTransients(engine, graph);
+            return 0;
+        }
+    }
+
+    graph->stats[GRAPH_STAT_TRANSIENT_BYTES] = 0;
+    graph->stats[GRAPH_STAT_ALLOCATED_BYTES] = 0;
+    graph->stats[GRAPH_STAT_LAZY_BYTES] = 0;
+    for (uint32_t i = 0; i < graph->transientCount; i++) {
+        graph->stats[GRAPH_STAT_TRANSIENT_BYTES] += graph->transients[i].requirements.size;
+    }
+    for (uint32_t b = 0; b < graph->blockCount; b++) {
+        graph->stats[GRAPH_STAT_ALLOCATED_BYTES] += graph->blocks[b].size;
+        if (graph->blocks[b].lazy) graph->stats[GRAPH_STAT_LAZY_BYTES] += graph->blocks[b].size;
+    }
+
+    for (uint32_t r = 0; r < graph->resourceCount; r++) {
+        GraphResource* resource = &graph->resources[r];
+        if (resource->transient == UINT32_MAX) continue;
+        resource->image = graph->transients[resource->transient].image;
+        resource->view = graph->transients[resource->transient].view;
+    }
+    return 1;
+}
+
+static void setInitialState(GraphResource* resource) {
+    const AccessInfo* info = &accessInfo[resource->initial];
+    resource->layout = resource->isImage ? info->layout : VK_IMAGE_LAYOUT_UNDEFINED;
+    resource->hasContent = resource->initial != GRAPH_ACCESS_NONE;
+    resource->writeStages = info->write ? info->stages : 0;
+    resource->writeAccess = info->write ? info->access : 0;
+    resource->readStages = info->write ? 0 : info->stages;
+    resource->visibleStages = 0;
+    resource->visibleAccess = 0;
+}
+
+// A transient sharing memory with one that ended earlier in the frame has to wait for the
+// previous occupant's last access before it is overwritten.
+static void aliasPredecessor(RenderGraph* graph, const GraphResource* resource, VkPipelineStageFlags* stages,
+                             VkAccessFlags* access) {
+    const GraphTransient* transient = &graph->transients[resource->transient];
+    const GraphResource* previous = NULL;
+    for (uint32_t r = 0; r < graph->resourceCount; r++) {
+        const GraphResource* other = &graph->resources[r];
+        if (other->transient == UINT32_MAX || other == resource) continue;
+        const GraphTransient* otherTransient = &graph->transients[other->transient];
+        if (otherTransient->block != transient->block || other->lastPass >= resource->firstPass) continue;
+        if (!previous || other->lastPass > previous->lastPass) previous = other;
+    }
+    if (!previous) return;
+    *stages |= previous->writeStages | previous->readStages;
+    *access |= previous->writeAccess;
+}
+
+static int addImageBarrier(RenderGraph* graph, const GraphResource* resource, VkAccessFlags srcAccess,
+                           VkAccessFlags dstAccess, VkImageLayout oldLayout, VkImageLayout newLayout) {
+    if (graph->barrierCount == GRAPH_MAX_BARRIERS) {
+        fprintf(stderr, "Render graph: too many barriers\n");
+        return 0;
+    }
+    graph->barriers[graph->barrierCount++] = (VkImageMemoryBarrier){
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = srcAccess,
+        .dstAccessMask = dstAccess,
+        .oldLayout = oldLayout,
+        .newLayout = newLayout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = resource->image,
+        .subresourceRange.aspectMask = resource->aspect,
+        .subresourceRange.baseMipLevel = 0,
+        .subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS,
+        .subresourceRange.baseArrayLayer = 0,
+        .subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS
+    };
+    return 1;
+}
+
+// Emits what one use needs on top of the resource's current state: nothing for a read that is
+// already visible, an execution and memory dependency otherwise, plus a layout transition when
+// the layout changes (from UNDEFINED when the old contents are not needed).
+static int synchronizeUse(RenderGraph* graph, GraphPass* pass, uint32_t passIndex, const GraphUse* use) {
+    GraphResource* resource = &graph->resources[use->resource];
+    const AccessInfo* info = &accessInfo[use->access];
+    int layoutChange = resource->isImage && info->layout != VK_IMAGE_LAYOUT_UNDEFINED && info->layout != resource->layout;
+    int discard = use->clear || !resource->hasContent;
+
+    VkPipelineStageFlags srcStages = 0;
+    VkAccessFlags srcAccess = 0;
+    int barrier = 0;
+    if (layoutChange || info->write) {
+        srcStages = resource->writeStages | resource->readStages;
+        srcAccess = resource->writeAccess;
+        if (resource->transient != UINT32_MAX && passIndex == resource->firstPass) {
+            aliasPredecessor(graph, resource, &srcStages, &srcAccess);
+        }
+        barrier = layoutChange || srcStages != 0;
+    } else if (resource->writeStages &&
+               ((resource->visibleStages & info->stages) != info->stages ||
+                (resource->visibleAccess & info->access) != info->access)) {
+        srcStages = resource->writeStages;
+        srcAccess = resource->writeAccess;
+        barrier = 1;
+    }
+
+    if (barrier) {
+        // With nothing to wait for, the transition waits on its own stages, which chains it after
+        // a semaphore wait there (swapchain images are acquired for the color output stage).
+        pass->srcStages |= srcStages ? srcStages : info->stages;
+        pass->dstStages |= info->stages;
+        if (layoutChange) {
+            VkImageLayout oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : resource->layout;
+            if (!addImageBarrier(graph, resource, srcAccess, info->access, oldLayout, info->layout)) return 0;
+            pass->barrierCount++;
+        } else {
+            pass->memorySrcAccess |= srcAccess;
+            pass->memoryDstAccess |= info->access;
+        }
+    }
+
+    if (layoutChange) resource->layout = info->layout;
+    if (info->write) {
+        resource->writeStages = info->stages;
+        resource->writeAccess = info->access & (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+        resource->readStages = 0;
+        resource->visibleStages = info->stages;
+        resource->visibleAccess = info->access;
+        resource->hasContent = 1;
+    } else {
+        if (barrier && layoutChange) resource->writeStages = info->stages;
+        if (barrier) {
+            resource->visibleStages |= info->stages;
+            resource->visibleAccess |= info->access;
+        }
+        resource->readStages |= info->stages;
+    }
+    return 1;
+}
+
+static VkRenderPass findRenderPass(Engine* engine, RenderGraph* graph, const RenderPassKey* key) {
+    for (uint32_t i = 0; i < graph->renderPassCount; i++) {
+        if (memcmp(&graph->renderPassKeys[i], key, sizeof(RenderPassKey)) == 0) return graph->renderPasses[i];
+    }
+    if (graph->renderPassCount == GRAPH_MAX_RENDER_PASSES) {
+        fprintf(stderr, "Render graph: too many render pass variants\n");
+        return VK_NULL_HANDLE;
+    }
+
+    VkAttachmentDescription attachments[GRAPH_MAX_ATTACHMENTS];
+    VkAttachmentReference colorRefs[GRAPH_MAX_ATTACHMENTS];
+    VkAttachmentReference depthRef = {0};
+    uint32_t colorCount = 0;
+    int hasDepth = 0;
+    for (uint32_t i = 0; i < key->attachmentCount; i++) {
+        // Layouts never change inside the pass: the graph's barriers put attachments in place.
+        attachments[i] = (VkAttachmentDescription){
+            .format = key->formats[i],
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = key->loadOps[i],
+            .storeOp = key->storeOps[i],
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = key->layouts[i],
+            .finalLayout = key->layouts[i]
+        };
+        if (key->layouts[i] == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
+            depthRef = (VkAttachmentReference){i, key->layouts[i]};
+            hasDepth = 1;
+        } else {
+            colorRefs[colorCount++] = (VkAttachmentReference){i, key->layouts[i]};
+        }
+    }
+
+    VkSubpassDescription subpass = {
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .colorAttachmentCount = colorCount,
+        .pColorAttachments = colorRefs,
+        .pDepthStencilAttachment = hasDepth ? &depthRef : NULL
+    };
+
+    VkRenderPassCreateInfo renderPassInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = key->attachmentCount,
+        .pAttachments = attachments,
+        .subpassCount = 1,
+        .pSubpasses = &subpass
+    };
+
+    VkRenderPass renderPass;
+    if (vkCreateRenderPass(engine->device, &renderPassInfo, NULL, &renderPass) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create render graph render pass\n");
+        return VK_NULL_HANDLE;
+    }
+    graph->renderPassKeys[graph->renderPassCount] = *key;
+    graph->renderPasses[graph->renderPassCount++] = renderPass;
+    return renderPass;
+}
+
+// Makes room for one framebuffer per pass before compiling, dropping the least recently used.
+// Frames are waited for before the next one is built, so nothing from an earlier frame is in use.
+static void evictFramebuffers(Engine* engine, RenderGraph* graph) {
+    while (graph->framebufferCount > GRAPH_MAX_FRAMEBUFFERS - GRAPH_MAX_PASSES) {
+        uint32_t oldest = 0;
+        for (uint32_t i = 1; i < graph->framebufferCount; i++) {
+            if (graph->framebufferFrames[i] < graph->framebufferFrames[oldest]) oldest = i;
+        }
+        if (graph->framebufferFrames[oldest] >= engine->frameIndex) return;
+
+        vkDestroyFramebuffer(engine->device, graph->framebuffers[oldest], NULL);
+        uint32_t last = --graph->framebufferCount;
+        graph->framebufferKeys[oldest] = graph->framebufferKeys[last];
+        graph->framebuffers[oldest] = graph->framebuffers[last];
+        graph->framebufferFrames[oldest] = graph->framebufferFrames[last];
+    }
+}
+
+static VkFramebuffer findFramebuffer(Engine* engine, RenderGraph* graph, const FramebufferKey* key) {
+    for (uint32_t i = 0; i < graph->framebufferCount; i++) {
+        if (memcmp(&graph->framebufferKeys[i], key, sizeof(FramebufferKey)) == 0) {
+            graph->framebufferFrames[i] = engine->frameIndex;
+            return graph->framebuffers[i];
+        }
+    }
+    if (graph->framebufferCount == GRAPH_MAX_FRAMEBUFFERS) {
+        fprintf(stderr, "Render graph: too many framebuffers in use, max is %d\n", GRAPH_MAX_FRAMEBUFFERS);
+        return VK_NULL_HANDLE;
+    }
+
+    VkFramebufferCreateInfo framebufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .renderPass = key->renderPass,
+        .attachmentCount = key->attachmentCount,
+        .pAttachments = key->views,
+        .width = key->extent.width,
+        .height = key->extent.height,
+        .layers = 1
+    };
+
+    VkFramebuffer framebuffer;
+    if (vkCreateFramebuffer(engine->device, &framebufferInfo, NULL, &framebuffer) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create render graph framebuffer\n");
+        return VK_NULL_HANDLE;
+    }
+    graph->framebufferKeys[graph->framebufferCount] = *key;
+    graph->framebufferFrames[graph->framebufferCount] = engine->frameIndex;
+    graph->framebuffers[graph->framebufferCount++] = framebuffer;
+    return framebuffer;
+}
+
+// Attachments load only what an earlier pass (or the previous frame) left, and store only what a
+// later pass or the next frame reads.
+static int compileRenderPass(Engine* engine, RenderGraph* graph, GraphPass* pass, uint32_t passIndex) {
+    RenderPassKey key;
+    FramebufferKey framebufferKey;
+    memset(&key, 0, sizeof(key));
+    memset(&framebufferKey, 0, sizeof(framebufferKey));
+
+    for (uint32_t u = 0; u < pass->useCount; u++) {
+        const GraphUse* use = &pass->uses[u];
+        if (!isAttachment(use->access)) continue;
+        if (key.attachmentCount == GRAPH_MAX_ATTACHMENTS) {
+            fprintf(stderr, "Render graph: pass %s has too many attachments\n", pass->name);
+            return 0;
+        }
+
+        const GraphResource* resource = &graph->resources[use->resource];
+        int exported = resource->imported && resource->final != GRAPH_ACCESS_NONE;
+        uint32_t i = key.attachmentCount++;
+        key.formats[i] = resource->format;
+        key.layouts[i] = accessInfo[use->access].layout;
+        key.loadOps[i] = use->clear ? VK_ATTACHMENT_LOAD_OP_CLEAR
+                                    : resource->hasContent ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        key.storeOps[i] = exported || resource->lastPass > passIndex ? VK_ATTACHMENT_STORE_OP_STORE
+                                                                     : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        framebufferKey.views[i] = resource->view;
+        pass->clearValues[i] = use->clearValue;
+        if (i == 0) pass->extent = resource->extent;
+    }
+
+    pass->attachmentCount = key.attachmentCount;
+    pass->renderPass = findRenderPass(engine, graph, &key);
+    if (pass->renderPass == VK_NULL_HANDLE) return 0;
+
+    framebufferKey.renderPass = pass->renderPass;
+    framebufferKey.attachmentCount = key.attachmentCount;
+    framebufferKey.extent = pass->extent;
+    pass->framebuffer = findFramebuffer(engine, graph, &framebufferKey);
+    return pass->framebuffer != VK_NULL_HANDLE;
+}
+
+// Culls, allocates transients and works out every barrier and render pass for the declared frame.
+int graphCompile(Engine* engine, RenderGraph* graph) {
+    graph->compiled = 0;
+    graph->barrierCount = 0;
+    cullPasses(graph);
+
+    uint32_t culled = 0;
+    for (uint32_t p = 0; p < graph->passCount; p++) {
+        const GraphPass* pass = &graph->passes[p];
+        if (!pass->needed) {
+            culled++;
+            continue;
+        }
+        for (uint32_t u = 0; u < pass->useCount; u++) {
+            GraphResource* resource = &graph->resources[pass->uses[u].resource];
+            if (resource->firstPass == UINT32_MAX) resource->firstPass = p;
+            resource->lastPass = p;
+        }
+    }
+
+    if (!prepareTransients(engine, graph)) return 0;
+    evictFramebuffers(engine, graph);
+    for (uint32_t r = 0; r < graph->resourceCount; r++) setInitialState(&graph->resources[r]);
+
+    uint32_t barrierBatches = 0;
+    for (uint32_t p = 0; p < graph->passCount; p++) {
+        GraphPass* pass = &graph->passes[p];
+        if (!pass->needed) continue;
+
+        pass->firstBarrier = graph->barrierCount;
+        // Attachment load ops depend on the state before the pass, so the render pass is built first.
+        if (pass->type == GRAPH_PASS_GRAPHICS && !compileRenderPass(engine, graph, pass, p)) return 0;
+        for (uint32_t u = 0; u < pass->useCount; u++) {
+            if (!synchronizeUse(graph, pass, p, &pass->uses[u])) return 0;
+        }
+        if (pass->srcStages) barrierBatches++;
+    }
+
+    graph->firstFinalBarrier = graph->barrierCount;
+    graph->finalBarrierCount = 0;
+    graph->finalSrcStages = 0;
+    graph->finalDstStages = 0;
+    for (uint32_t r = 0; r < graph->resourceCount; r++) {
+        GraphResource* resource = &graph->resources[r];
+        if (!resource->isImage || !resource->imported || resource->final == GRAPH_ACCESS_NONE) continue;
+        const AccessInfo* info = &accessInfo[resource->final];
+        if (info->layout == resource->layout) continue;
+
+        VkPipelineStageFlags srcStages = resource->writeStages | resource->readStages;
+        graph->finalSrcStages |= srcStages ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        graph->finalDstStages |= info->stages ? info->stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        VkImageLayout oldLayout = resource->hasContent ? resource->layout : VK_IMAGE_LAYOUT_UNDEFINED;
+        if (!addImageBarrier(graph, resource, resource->writeAccess, info->access, oldLayout, info->layout)) return 0;
+        graph->finalBarrierCount++;
+    }
+    if (graph->finalBarrierCount > 0) barrierBatches++;
+
+    graph->stats[GRAPH_STAT_PASSES] = graph->passCount - culled;
+    graph->stats[GRAPH_STAT_CULLED] = culled;
+    graph->stats[GRAPH_STAT_BARRIERS] = barrierBatches;
+    graph->compiled = 1;
+    return 1;
+}
+
+void graphExecute(Engine* engine, RenderGraph* graph, VkCommandBuffer commandBuffer) {
+    if (!graph->compiled) return;
+
+    for (uint32_t p = 0; p < graph->passCount; p++) {
+        GraphPass* pass = &graph->passes[p];
+        if (!pass->needed) continue;
+
+        if (pass->srcStages) {
+            VkMemoryBarrier memoryBarrier = {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .srcAccessMask = pass->memorySrcAccess,
+                .dstAccessMask = pass->memoryDstAccess
+            };
+            uint32_t memoryBarrierCount = pass->memorySrcAccess || pass->memoryDstAccess ? 1 : 0;
+            vkCmdPipelineBarrier(commandBuffer, pass->srcStages, pass->dstStages, 0, memoryBarrierCount, &memoryBarrier,
+                                 0, NULL, pass->barrierCount, graph->barriers + pass->firstBarrier);
+        }
+
+        TRACE_ZONE_BEGIN(passZone, pass->name);
+        uint32_t gpuZone = gpuZoneBegin(engine, commandBuffer, pass->name);
+        if (pass->type == GRAPH_PASS_GRAPHICS) {
+            VkRenderPassBeginInfo renderPassInfo = {
+                .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+                .renderPass = pass->renderPass,
+                .framebuffer = pass->framebuffer,
+                .renderArea.offset = {0, 0},
+                .renderArea.extent = pass->renderArea.width ? pass->renderArea : pass->extent,
+                .clearValueCount = pass->attachmentCount,
+                .pClearValues = pass->clearValues
+            };
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            if (pass->record) pass->record(engine, commandBuffer, pass->userData);
+            vkCmdEndRenderPass(commandBuffer);
+        } else if (pass->record) {
+            pass->record(engine, commandBuffer, pass->userData);
+        }
+        gpuZoneEnd(engine, commandBuffer, gpuZone);
+        TRACE_ZONE_END(passZone);
+    }
+
+    if (graph->finalBarrierCount > 0) {
+        vkCmdPipelineBarrier(commandBuffer, graph->finalSrcStages, graph->finalDstStages, 0, 0, NULL, 0, NULL,
+                             graph->finalBarrierCount, graph->barriers + graph->firstFinalBarrier);
+    }
+}
+
+// [passes executed, passes culled, barrier batches, transient bytes, allocated bytes, lazily
+// allocated bytes] for the last frame.
+EXPORT void engine_render_graph_stats(Engine* engine, uint64_t* stats) {
+    for (uint32_t i = 0; i < GRAPH_STAT_COUNT; i++) {
+        stats[i] = engine->graph ? engine->graph->stats[i] : 0;
+    }
+}
@@ -1,16 +1,59 @@
 #include "engine.h"
 #include <stdio.h>
 
+// Depth has to be sampleable for the Hi-Z build; D32 is preferred, combined formats are a fallback.
+static void chooseDepthFormat(Engine* engine) {
+    VkFormat candidates[] = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT};
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
+
+    engine->depthFormat = VK_FORMAT_UNDEFINED;
+    engine->depthSampled = 0;
+    for (uint32_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(engine->physicalDevice, candidates[i], &properties);
+        if ((properties.optimalTilingFeatures & required) != required) continue;
+
+        int sampled = (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+        if (engine->depthFormat == VK_FORMAT_UNDEFINED || (sampled && !engine->depthSampled)) {
+            engine->depthFormat = candidates[i];
+            engine->depthSampled = sampled;
+        }
+        if (sampled) break;
+    }
+}
+
+// Pipelines are created against this pass only. The render passes the frame actually runs are
+// built by the render graph with their own load/store ops and layouts, but with the same
+// attachment formats and a single subpass, so they are all compatible with it. The colour format
+// is picked before the swapchain exists so pipelines can compile while the window is created.
 void createRenderPass(Engine* engine) {
-    VkAttachmentDescription colorAttachment = {
-        .format = engine->swapchainImageFormat,
-        .samples = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+    if (engine->depthFormat == VK_FORMAT_UNDEFINED) chooseDepthFormat(engine);
+    if (engine->depthFormat == VK_FORMAT_UNDEFINED) {
+        fprintf(stderr, "No supported depth format\n");
+        return;
+    }
+
+    VkAttachmentDescription attachments[] = {
+        {
+            .format = engine->renderPassFormat,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+        },
+        {
+            .format = engine->depthFormat,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+        }
     };
 
     VkAttachmentReference colorAttachmentRef = {
@@ -18,16 +61,22 @@ void createRenderPass(Engine* engine) {
         .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
     };
 
+    VkAttachmentReference depthAttachmentRef = {
+        .attachment = 1,
+        .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+    };
+
     VkSubpassDescription subpass = {
         .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
         .colorAttachmentCount = 1,
-        .pColorAttachments = &colorAttachmentRef
+        .pColorAttachments = &colorAttachmentRef,
+        .pDepthStencilAttachment = &depthAttachmentRef
     };
 
     VkRenderPassCreateInfo renderPassInfo = {
         .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-        .attachmentCount = 1,
-        .pAttachments = &colorAttachment,
+        .attachmentCount = 2,
+        .pAttachments = attachments,
         .subpassCount = 1,
         .pSubpasses = &subpass
     };
@@ -35,4 +84,4 @@ void createRenderPass(Engine* engine) {
     if (vkCreateRenderPass(engine->device, &renderPassInfo, NULL, &engine->renderPass) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create render pass\n");
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,220 @@
+#include "engine.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define RESOLUTION_WINDOW 8          // frames averaged before the scale is changed
+#define RESOLUTION_DEADBAND 0.05f    // relative distance from the target that is left alone
+#define RESOLUTION_MAX_RAISE 0.05f   // scale steps; dropping is faster than recovering
+#define RESOLUTION_MAX_DROP 0.1f
+
+// The scene is drawn into the top-left part of a transient colour target that always has the
+// swapchain's size, so the graph keeps reusing the same image while the scale moves, and is then
+// blitted to the swapchain. The scale is picked from the GPU time of whole frames, measured with
+// two timestamps of its own so it works without tracing.
+struct DynamicResolution {
+    VkQueryPool queryPool;
+    double nanosecondsPerTick;
+    uint64_t timestampMask;
+    float targetMilliseconds;  // 0: disabled
+    float minScale;
+    float scale;
+    float gpuMilliseconds;     // last measured frame
+    float windowSum;
+    uint32_t windowFrames;
+    int written;
+    uint32_t scene;            // graph resources of the current frame's upscale
+    uint32_t target;
+};
+
+void createDynamicResolution(Engine* engine) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(engine->physicalDevice, &properties);
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(engine->physicalDevice, &familyCount, NULL);
+    VkQueueFamilyProperties* families = (VkQueueFamilyProperties*)malloc(sizeof(VkQueueFamilyProperties) * familyCount);
+    if (!families) return;
+    vkGetPhysicalDeviceQueueFamilyProperties(engine->physicalDevice, &familyCount, families);
+    uint32_t validBits = familyCount > 0 ? families[0].timestampValidBits : 0;
+    free(families);
+
+    if (validBits == 0 || properties.limits.timestampPeriod <= 0.0f) {
+        fprintf(stderr, "GPU timestamps are not supported, dynamic resolution disabled\n");
+        return;
+    }
+
+    // Linear blits from and to the colour format, and a swapchain that can be blitted to.
+    VkFormatFeatureFlags blit = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(engine->physicalDevice, engine->swapchainImageFormat, &formatProperties);
+    if ((formatProperties.optimalTilingFeatures & blit) != blit) {
+        fprintf(stderr, "Colour format cannot be blitted, dynamic resolution disabled\n");
+        return;
+    }
+    if (engine->surface) {
+        VkSurfaceCapabilitiesKHR capabilities;
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(engine->physicalDevice, engine->surface, &capabilities);
+        if (!(capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+            fprintf(stderr, "Swapchain images cannot be blitted to, dynamic resolution disabled\n");
+            return;
+        }
+    }
+
+    DynamicResolution* resolution = (DynamicResolution*)calloc(1, sizeof(DynamicResolution));
+    if (!resolution) {
+        fprintf(stderr, "Failed to allocate memory for dynamic resolution\n");
+        return;
+    }
+    resolution->nanosecondsPerTick = properties.limits.timestampPeriod;
+    resolution->timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+    resolution->scale = 1.0f;
+
+    VkQueryPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = 2
+    };
+
+    if (vkCreateQueryPool(engine->device, &poolInfo, NULL, &resolution->queryPool) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create dynamic resolution query pool\n");
+        free(resolution);
+        return;
+    }
+    engine->resolution = resolution;
+}
+
+void destroyDynamicResolution(Engine* engine) {
+    DynamicResolution* resolution = engine->resolution;
+    if (!resolution) return;
+
+    if (resolution->queryPool) vkDestroyQueryPool(engine->device, resolution->queryPool, NULL);
+    free(resolution);
+    engine->resolution = NULL;
+}
+
+// Sets engine->renderExtent for the frame about to be recorded. Returns 1 when the scene goes
+// through the offscreen target, even at full scale, so the graph does not change shape.
+int updateRenderExtent(Engine* engine) {
+    DynamicResolution* resolution = engine->resolution;
+    engine->renderExtent = engine->swapchainExtent;
+    if (!resolution || resolution->targetMilliseconds <= 0.0f) return 0;
+
+    uint32_t width = (uint32_t)((float)engine->swapchainExtent.width * resolution->scale + 0.5f);
+    uint32_t height = (uint32_t)((float)engine->swapchainExtent.height * resolution->scale + 0.5f);
+    if (width > 0 && width < engine->renderExtent.width) engine->renderExtent.width = width;
+    if (height > 0 && height < engine->renderExtent.height) engine->renderExtent.height = height;
+    return 1;
+}
+
+// Must be recorded outside a render pass, before everything else in the frame.
+void resolutionFrameBegin(Engine* engine, VkCommandBuffer commandBuffer) {
+    DynamicResolution* resolution = engine->resolution;
+    if (!resolution || resolution->targetMilliseconds <= 0.0f) return;
+
+    vkCmdResetQueryPool(commandBuffer, resolution->queryPool, 0, 2);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, resolution->queryPool, 0);
+}
+
+void resolutionFrameEnd(Engine* engine, VkCommandBuffer commandBuffer) {
+    DynamicResolution* resolution = engine->resolution;
+    if (!resolution || resolution->targetMilliseconds <= 0.0f) return;
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, resolution->queryPool, 1);
+    resolution->written = 1;
+}
+
+// Called once the frame has finished executing. Cost follows the pixel count, so the scale moves
+// by the square root of the budget ratio; a deadband and capped steps keep it from oscillating.
+void resolutionCollect(Engine* engine) {
+    DynamicResolution* resolution = engine->resolution;
+    if (!resolution || !resolution->written) return;
+    resolution->written = 0;
+
+    uint64_t timestamps[2];
+    if (vkGetQueryPoolResults(engine->device, resolution->queryPool, 0, 2, sizeof(timestamps), timestamps,
+                              sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return;
+    }
+    uint64_t begin = timestamps[0] & resolution->timestampMask;
+    uint64_t end = timestamps[1] & resolution->timestampMask;
+    if (end < begin) return;
+
+    resolution->gpuMilliseconds = (float)((double)(end - begin) * resolution->nanosecondsPerTick / 1e6);
+    resolution->windowSum += resolution->gpuMilliseconds;
+    if (++resolution->windowFrames < RESOLUTION_WINDOW) return;
+
+    float average = resolution->windowSum / (float)resolution->windowFrames;
+    resolution->windowSum = 0.0f;
+    resolution->windowFrames = 0;
+    if (average <= 0.0f || fabsf(average - resolution->targetMilliseconds) < resolution->targetMilliseconds * RESOLUTION_DEADBAND) {
+        return;
+    }
+
+    float scale = resolution->scale * sqrtf(resolution->targetMilliseconds / average);
+    if (scale > resolution->scale + RESOLUTION_MAX_RAISE) scale = resolution->scale + RESOLUTION_MAX_RAISE;
+    if (scale < resolution->scale - RESOLUTION_MAX_DROP) scale = resolution->scale - RESOLUTION_MAX_DROP;
+    if (scale < resolution->minScale) scale = resolution->minScale;
+    if (scale > 1.0f) scale = 1.0f;
+    resolution->scale = scale;
+}
+
+static void recordUpscale(Engine* engine, VkCommandBuffer commandBuffer, void* userData) {
+    DynamicResolution* resolution = (DynamicResolution*)userData;
+    VkImageBlit region = {
+        .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .srcOffsets = {{0, 0, 0}, {(int32_t)engine->renderExtent.width, (int32_t)engine->renderExtent.height, 1}},
+        .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .dstOffsets = {{0, 0, 0}, {(int32_t)engine->swapchainExtent.width, (int32_t)engine->swapchainExtent.height, 1}}
+    };
+    vkCmdBlitImage(commandBuffer, graphImage(engine->graph, resolution->scene), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   graphImage(engine->graph, resolution->target), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   1, &region, VK_FILTER_LINEAR);
+}
+
+// Stretches the rendered part of `scene` over all of `target`.
+void addUpscalePass(Engine* engine, RenderGraph* graph, uint32_t scene, uint32_t target) {
+    DynamicResolution* resolution = engine->resolution;
+    if (!resolution) return;
+
+    resolution->scene = scene;
+    resolution->target = target;
+    uint32_t pass = graphAddPass(graph, "upscale", GRAPH_PASS_TRANSFER, recordUpscale, resolution);
+    graphUse(graph, pass, scene, GRAPH_ACCESS_TRANSFER_READ);
+    graphUse(graph, pass, target, GRAPH_ACCESS_TRANSFER_WRITE);
+}
+
+// Renders the scene at a scale picked to keep GPU frame time near targetMilliseconds, never below
+// minScale of the window size. Sprites stay at full resolution. A target of 0 turns it off.
+EXPORT void engine_set_dynamic_resolution(Engine* engine, float targetMilliseconds, float minScale) {
+    if (engine->capture) {
+        captureCall(engine, CAPTURE_SET_DYNAMIC_RESOLUTION,
+                    (CaptureWord[]){{.f = targetMilliseconds}, {.f = minScale}}, 2, NULL, 0);
+    }
+    if (targetMilliseconds > 0.0f && !engine->resolution) {
+        createLazily(engine, "dynamic resolution", createDynamicResolution);
+    }
+    DynamicResolution* resolution = engine->resolution;
+    if (!resolution) return;
+
+    if (minScale < 0.1f) minScale = 0.1f;
+    if (minScale > 1.0f) minScale = 1.0f;
+    resolution->targetMilliseconds = targetMilliseconds > 0.0f ? targetMilliseconds : 0.0f;
+    resolution->minScale = minScale;
+    if (resolution->scale < minScale || resolution->targetMilliseconds == 0.0f) resolution->scale = 1.0f;
+    resolution->windowSum = 0.0f;
+    resolution->windowFrames = 0;
+    resolution->gpuMilliseconds = 0.0f;
+}
+
+// Fraction of the window size the scene was last rendered at.
+EXPORT float engine_render_scale(Engine* engine) {
+    DynamicResolution* resolution = engine->resolution;
+    return resolution && resolution->targetMilliseconds > 0.0f ? resolution->scale : 1.0f;
+}
+
+// GPU time of the last frame in milliseconds; only measured while dynamic resolution is on.
+EXPORT float engine_gpu_frame_time(Engine* engine) {
+    return engine->resolution ? engine->resolution->gpuMilliseconds : 0.0f;
+}
@@ -0,0 +1,220 @@
+#include "engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+    uint16_t texture;
+} SpriteRun;
+
+typedef struct {
+    float scale[2];
+    float offset[2];
+    uint32_t texture;
+    uint32_t textured;
+} SpritePushConstants;
+
+struct SpriteBatch {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    SpriteInstance* mapped;
+    uint32_t count;
+    uint32_t* sortBuffers;  // keys, order and their scratch copies; the sort swaps the four pointers
+    uint32_t* keys;
+    uint32_t* order;
+    uint32_t* scratchKeys;
+    uint32_t* scratchOrder;
+    SpriteRun* runs;
+    uint32_t runCount;
+};
+
+void createSpriteBatch(Engine* engine) {
+    SpriteBatch* batch = (SpriteBatch*)calloc(1, sizeof(SpriteBatch));
+    if (!batch) {
+        fprintf(stderr, "Failed to allocate memory for sprite batch\n");
+        return;
+    }
+
+    batch->sortBuffers = (uint32_t*)malloc(MAX_SPRITES * sizeof(uint32_t) * 4);
+    batch->runs = (SpriteRun*)malloc(MAX_SPRITES * sizeof(SpriteRun));
+    if (!batch->sortBuffers || !batch->runs) {
+        fprintf(stderr, "Failed to allocate sprite sort buffers\n");
+        free(batch->sortBuffers);
+        free(batch->runs);
+        free(batch);
+        return;
+    }
+    batch->keys = batch->sortBuffers;
+    batch->order = batch->keys + MAX_SPRITES;
+    batch->scratchKeys = batch->order + MAX_SPRITES;
+    batch->scratchOrder = batch->scratchKeys + MAX_SPRITES;
+
+    if (createBuffer(engine, sizeof(SpriteInstance) * MAX_SPRITES, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     &batch->buffer, &batch->memory) != VK_SUCCESS) {
+        free(batch->sortBuffers);
+        free(batch->runs);
+        free(batch);
+        return;
+    }
+
+    void* data;
+    if (vkMapMemory(engine->device, batch->memory, 0, sizeof(SpriteInstance) * MAX_SPRITES, 0, &data) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to map sprite buffer memory\n");
+        vkFreeMemory(engine->device, batch->memory, NULL);
+        vkDestroyBuffer(engine->device, batch->buffer, NULL);
+        free(batch->sortBuffers);
+        free(batch->runs);
+        free(batch);
+        return;
+    }
+    batch->mapped = (SpriteInstance*)data;
+    engine->sprites = batch;
+}
+
+void destroySpriteBatch(Engine* engine) {
+    SpriteBatch* batch = engine->sprites;
+    if (!batch) return;
+
+    vkUnmapMemory(engine->device, batch->memory);
+    vkFreeMemory(engine->device, batch->memory, NULL);
+    vkDestroyBuffer(engine->device, batch->buffer, NULL);
+    free(batch->sortBuffers);
+    free(batch->runs);
+    free(batch);
+    engine->sprites = NULL;
+}
+
+// Stable LSD radix sort on (layer << 16 | texture), skipping bytes that are equal for every sprite.
+static void sortSprites(SpriteBatch* batch, const SpriteInstance* sprites, uint32_t count) {
+    uint32_t histograms[4][256];
+    memset(histograms, 0, sizeof(histograms));
+
+    int sorted = 1;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t key = ((uint32_t)sprites[i].layer << 16) | sprites[i].texture;
+        batch->keys[i] = key;
+        batch->order[i] = i;
+        if (i > 0 && key < batch->keys[i - 1]) sorted = 0;
+        histograms[0][key & 0xFF]++;
+        histograms[1][(key >> 8) & 0xFF]++;
+        histograms[2][(key >> 16) & 0xFF]++;
+        histograms[3][key >> 24]++;
+    }
+    if (sorted) return;
+
+    for (uint32_t pass = 0; pass < 4; pass++) {
+        uint32_t shift = pass * 8;
+        uint32_t* histogram = histograms[pass];
+        if (histogram[(batch->keys[0] >> shift) & 0xFF] == count) continue;
+
+        uint32_t sum = 0;
+        for (uint32_t b = 0; b < 256; b++) {
+            uint32_t c = histogram[b];
+            histogram[b] = sum;
+            sum += c;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t key = batch->keys[i];
+            uint32_t dst = histogram[(key >> shift) & 0xFF]++;
+            batch->scratchKeys[dst] = key;
+            batch->scratchOrder[dst] = batch->order[i];
+        }
+
+        uint32_t* t = batch->keys;
+        batch->keys = batch->scratchKeys;
+        batch->scratchKeys = t;
+        t = batch->order;
+        batch->order = batch->scratchOrder;
+        batch->scratchOrder = t;
+    }
+}
+
+EXPORT void engine_set_sprites(Engine* engine, const SpriteInstance* sprites, uint32_t spriteCount) {
+    if (engine->capture) {
+        captureCall(engine, CAPTURE_SET_SPRITES, (CaptureWord[]){{.u = spriteCount}}, 1,
+                    (CaptureData[]){{sprites, (uint32_t)(sizeof(SpriteInstance) * spriteCount)}}, 1);
+    }
+    // The sprite shader samples the texture array, so it needs the fallback texture bound.
+    if (!engine->sprites && spriteCount > 0) {
+        if (!engine->textures) createLazily(engine, "texture system", createTextureSystem);
+        createLazily(engine, "sprite batch", createSpriteBatch);
+    }
+    SpriteBatch* batch = engine->sprites;
+    if (!batch) {
+        if (spriteCount == 0) return;
+        fprintf(stderr, "Sprite batch not initialized\n");
+        return;
+    }
+    if (spriteCount > MAX_SPRITES) {
+        fprintf(stderr, "Too many sprites, max is %d\n", MAX_SPRITES);
+        spriteCount = MAX_SPRITES;
+    }
+
+    batch->count = spriteCount;
+    batch->runCount = 0;
+    if (spriteCount == 0) return;
+
+    TRACE_ZONE_BEGIN(uploadZone, "engine_set_sprites");
+    sortSprites(batch, sprites, spriteCount);
+
+    // Sequential writes into the mapped buffer; one draw per run of equal texture.
+    SpriteRun* run = NULL;
+    for (uint32_t i = 0; i < spriteCount; i++) {
+        const SpriteInstance* sprite = &sprites[batch->order[i]];
+        batch->mapped[i] = *sprite;
+        if (!run || run->texture != sprite->texture) {
+            run = &batch->runs[batch->runCount++];
+            run->firstInstance = i;
+            run->instanceCount = 0;
+            run->texture = sprite->texture;
+        }
+        run->instanceCount++;
+    }
+    TRACE_ZONE_END(uploadZone);
+}
+
+void recordSprites(Engine* engine, VkCommandBuffer commandBuffer) {
+    SpriteBatch* batch = engine->sprites;
+    if (!batch || batch->count == 0 || engine->spritePipeline == VK_NULL_HANDLE) return;
+
+    VkViewport viewport = {
+        .x = 0.0f,
+        .y = 0.0f,
+        .width = (float)engine->swapchainExtent.width,
+        .height = (float)engine->swapchainExtent.height,
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f
+    };
+    VkRect2D scissor = {
+        .offset = {0, 0},
+        .extent = engine->swapchainExtent
+    };
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, engine->spritePipeline);
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &batch->buffer, &offset);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            engine->spritePipelineLayout, 0, 1, &engine->descriptorSet, 0, NULL);
+
+    // Pixel coordinates with the origin in the top-left corner.
+    SpritePushConstants push = {
+        .scale = {2.0f / viewport.width, 2.0f / viewport.height},
+        .offset = {-1.0f, -1.0f}
+    };
+
+    for (uint32_t i = 0; i < batch->runCount; i++) {
+        const SpriteRun* run = &batch->runs[i];
+        push.textured = run->texture != SPRITE_NO_TEXTURE && run->texture < MAX_TEXTURES;
+        push.texture = push.textured ? run->texture : 0;
+        if (push.textured) touchTexture(engine, run->texture);
+        vkCmdPushConstants(commandBuffer, engine->spritePipelineLayout,
+                           VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push), &push);
+        vkCmdDraw(commandBuffer, 6, run->instanceCount, 0, run->firstInstance);
+    }
+}
@@ -8,7 +8,7 @@ static uint32_t clamp(uint32_t value, uint32_t min, uint32_t max) {
 
 static VkSurfaceFormatKHR chooseSwapSurfaceFormat(VkSurfaceFormatKHR* formats, uint32_t formatCount) {
     for (uint32_t i = 0; i < formatCount; i++) {
-        if (formats[i].format == VK_FORMAT_B8G8R8A8_SRGB &&
+        if (formats[i].format == PREFERRED_SURFACE_FORMAT &&
             formats[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
             return formats[i];
         }
@@ -44,23 +44,27 @@ static VkExtent2D chooseSwapExtent(GLFWwindow* window, const VkSurfaceCapabiliti
     return extent;
 }
 
-void createSwapChain(Engine* engine) {
+// Shared by the engine's own window and every extra window: all of them render with the same
+// pipelines, so the caller checks the surface format matches.
+int createSurfaceSwapchain(Engine* engine, GLFWwindow* window, VkSurfaceKHR surface, SurfaceSwapchain* out) {
     VkSurfaceCapabilitiesKHR capabilities;
-    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(engine->physicalDevice, engine->surface, &capabilities);
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(engine->physicalDevice, surface, &capabilities);
 
     uint32_t formatCount;
-    vkGetPhysicalDeviceSurfaceFormatsKHR(engine->physicalDevice, engine->surface, &formatCount, NULL);
+    vkGetPhysicalDeviceSurfaceFormatsKHR(engine->physicalDevice, surface, &formatCount, NULL);
     VkSurfaceFormatKHR* formats = (VkSurfaceFormatKHR*)malloc(formatCount * sizeof(VkSurfaceFormatKHR));
-    vkGetPhysicalDeviceSurfaceFormatsKHR(engine->physicalDevice, engine->surface, &formatCount, formats);
+    vkGetPhysicalDeviceSurfaceFormatsKHR(engine->physicalDevice, surface, &formatCount, formats);
 
     uint32_t presentModeCount;
-    vkGetPhysicalDeviceSurfacePresentModesKHR(engine->physicalDevice, engine->surface, &presentModeCount, NULL);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(engine->physicalDevice, surface, &presentModeCount, NULL);
     VkPresentModeKHR* presentModes = (VkPresentModeKHR*)malloc(presentModeCount * sizeof(VkPresentModeKHR));
-    vkGetPhysicalDeviceSurfacePresentModesKHR(engine->physicalDevice, engine->surface, &presentModeCount, presentModes);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(engine->physicalDevice, surface, &presentModeCount, presentModes);
 
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(formats, formatCount);
     VkPresentModeKHR presentMode = chooseSwapPresentMode(presentModes, presentModeCount);
-    VkExtent2D extent = chooseSwapExtent(engine->window, &capabilities);
+    VkExtent2D extent = chooseSwapExtent(window, &capabilities);
+    free(formats);
+    free(presentModes);
 
     uint32_t imageCount = capabilities.minImageCount + 1;
     if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
@@ -69,13 +73,14 @@ void createSwapChain(Engine* engine) {
 
     VkSwapchainCreateInfoKHR createInfo = {
         .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
-        .surface = engine->surface,
+        .surface = surface,
         .minImageCount = imageCount,
         .imageFormat = surfaceFormat.format,
         .imageColorSpace = surfaceFormat.colorSpace,
         .imageExtent = extent,
         .imageArrayLayers = 1,
-        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        // Blit target of the dynamic resolution upscale.
+        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT),
         .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
         .preTransform = capabilities.currentTransform,
         .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
@@ -84,24 +89,26 @@ void createSwapChain(Engine* engine) {
         .oldSwapchain = VK_NULL_HANDLE
     };
 
-    if (vkCreateSwapchainKHR(engine->device, &createInfo, NULL, &engine->swapchain) != VK_SUCCESS) {
+    *out = (SurfaceSwapchain){0};
+    if (vkCreateSwapchainKHR(engine->device, &createInfo, NULL, &out->swapchain) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create swap chain\n");
+        return 0;
     }
 
-    vkGetSwapchainImagesKHR(engine->device, engine->swapchain, &engine->swapchainImageCount, NULL);
-    engine->swapchainImages = (VkImage*)malloc(engine->swapchainImageCount * sizeof(VkImage));
-    vkGetSwapchainImagesKHR(engine->device, engine->swapchain, &engine->swapchainImageCount, engine->swapchainImages);
+    vkGetSwapchainImagesKHR(engine->device, out->swapchain, &out->imageCount, NULL);
+    out->images = (VkImage*)malloc(out->imageCount * sizeof(VkImage));
+    vkGetSwapchainImagesKHR(engine->device, out->swapchain, &out->imageCount, out->images);
 
-    engine->swapchainImageFormat = surfaceFormat.format;
-    engine->swapchainExtent = extent;
+    out->format = surfaceFormat.format;
+    out->extent = extent;
 
-    engine->swapchainImageViews = (VkImageView*)malloc(engine->swapchainImageCount * sizeof(VkImageView));
-    for (uint32_t i = 0; i < engine->swapchainImageCount; i++) {
+    out->imageViews = (VkImageView*)calloc(out->imageCount, sizeof(VkImageView));
+    for (uint32_t i = 0; i < out->imageCount; i++) {
         VkImageViewCreateInfo viewInfo = {
             .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-            .image = engine->swapchainImages[i],
+            .image = out->images[i],
             .viewType = VK_IMAGE_VIEW_TYPE_2D,
-            .format = engine->swapchainImageFormat,
+            .format = out->format,
             .components.r = VK_COMPONENT_SWIZZLE_IDENTITY,
             .components.g = VK_COMPONENT_SWIZZLE_IDENTITY,
             .components.b = VK_COMPONENT_SWIZZLE_IDENTITY,
@@ -112,11 +119,94 @@ void createSwapChain(Engine* engine) {
             .subresourceRange.baseArrayLayer = 0,
             .subresourceRange.layerCount = 1
         };
-        if (vkCreateImageView(engine->device, &viewInfo, NULL, &engine->swapchainImageViews[i]) != VK_SUCCESS) {
+        if (vkCreateImageView(engine->device, &viewInfo, NULL, &out->imageViews[i]) != VK_SUCCESS) {
             fprintf(stderr, "Failed to create image view %d\n", i);
         }
     }
+    return 1;
+}
 
-    free(formats);
-    free(presentModes);
-}
\ No newline at end of file
+void destroySurfaceSwapchain(Engine* engine, SurfaceSwapchain* swapchain) {
+    if (swapchain->imageViews) {
+        for (uint32_t i = 0; i < swapchain->imageCount; i++) {
+            if (swapchain->imageViews[i]) vkDestroyImageView(engine->device, swapchain->imageViews[i], NULL);
+        }
+    }
+    free(swapchain->imageViews);
+    free(swapchain->images);
+    if (swapchain->swapchain) vkDestroySwapchainKHR(engine->device, swapchain->swapchain, NULL);
+    *swapchain = (SurfaceSwapchain){0};
+}
+
+// Headless engines have no surface: the frame graph draws into one device-local image of the
+// requested size, in the format a window would usually get.
+static void createOffscreenTarget(Engine* engine) {
+    VkImageCreateInfo imageInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = PREFERRED_SURFACE_FORMAT,
+        .extent = {engine->swapchainExtent.width, engine->swapchainExtent.height, 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+
+    VkImage image;
+    if (vkCreateImage(engine->device, &imageInfo, NULL, &image) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create offscreen image\n");
+        return;
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(engine->device, image, &requirements);
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = requirements.size,
+        .memoryTypeIndex = findMemoryType(engine, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+    };
+    if (vkAllocateMemory(engine->device, &allocInfo, NULL, &engine->offscreenMemory) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate offscreen image memory\n");
+        vkDestroyImage(engine->device, image, NULL);
+        return;
+    }
+    vkBindImageMemory(engine->device, image, engine->offscreenMemory, 0);
+
+    VkImageViewCreateInfo viewInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = imageInfo.format,
+        .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .subresourceRange.levelCount = 1,
+        .subresourceRange.layerCount = 1
+    };
+
+    engine->swapchainImages = (VkImage*)malloc(sizeof(VkImage));
+    engine->swapchainImageViews = (VkImageView*)calloc(1, sizeof(VkImageView));
+    engine->swapchainImages[0] = image;
+    engine->swapchainImageCount = 1;
+    engine->swapchainImageFormat = imageInfo.format;
+    if (vkCreateImageView(engine->device, &viewInfo, NULL, &engine->swapchainImageViews[0]) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create offscreen image view\n");
+    }
+}
+
+void createSwapChain(Engine* engine) {
+    if (!engine->surface) {
+        createOffscreenTarget(engine);
+        return;
+    }
+
+    SurfaceSwapchain swapchain;
+    createSurfaceSwapchain(engine, engine->window, engine->surface, &swapchain);
+    engine->swapchain = swapchain.swapchain;
+    engine->swapchainImages = swapchain.images;
+    engine->swapchainImageCount = swapchain.imageCount;
+    engine->swapchainImageViews = swapchain.imageViews;
+    engine->swapchainImageFormat = swapchain.format;
+    engine->swapchainExtent = swapchain.extent;
+}
@@ -0,0 +1,615 @@
+#include "engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_TEXTURE_PACKS 16
+#define TEXTURE_STAGING_RING_SIZE (32ull * 1024ull * 1024ull)
+// Half the ring per frame, so a wrap never overwrites data recorded earlier in the same frame.
+#define TEXTURE_STAGING_FRAME_LIMIT (TEXTURE_STAGING_RING_SIZE / 2)
+#define TEXTURE_DEFAULT_BUDGET (256ull * 1024ull * 1024ull)
+#define TEXTURE_TAIL_DIMENSION 64
+#define TEXTURE_KEEP_FRAMES 120
+
+typedef struct {
+    const TexturePackEntry* entry;
+    const uint8_t* data;
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+    uint32_t residentMip;  // mipCount while nothing is resident
+    uint32_t targetMip;
+    uint32_t tailMip;      // mips from here down are never evicted
+    uint64_t lastUsedFrame;
+    int failed;            // the device cannot sample its format; it stays on the fallback
+} StreamedTexture;
+
+typedef struct {
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+} RetiredImage;
+
+struct TextureSystem {
+    MappedFile packs[MAX_TEXTURE_PACKS];
+    uint32_t packCount;
+    StreamedTexture textures[MAX_TEXTURES];
+    uint32_t textureCount;
+    VkSampler sampler;
+    VkImage fallbackImage;
+    VkDeviceMemory fallbackMemory;
+    VkImageView fallbackView;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+    uint8_t* stagingMapped;
+    VkDeviceSize stagingHead;
+    VkDeviceSize budget;
+    VkDeviceSize residentBytes;
+    RetiredImage retired[MAX_TEXTURES];
+    uint32_t retiredCount;
+};
+
+static uint32_t formatBlockBytes(VkFormat format, uint32_t* blockDim) {
+    *blockDim = 4;
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            return 8;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return 16;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            *blockDim = 1;
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+static uint32_t mipDimension(uint32_t size, uint32_t mip) {
+    uint32_t d = size >> mip;
+    return d ? d : 1;
+}
+
+static VkDeviceSize mipDataSize(const TexturePackEntry* entry, uint32_t mip) {
+    uint32_t blockDim;
+    uint32_t blockBytes = formatBlockBytes((VkFormat)entry->format, &blockDim);
+    uint32_t w = (mipDimension(entry->width, mip) + blockDim - 1) / blockDim;
+    uint32_t h = (mipDimension(entry->height, mip) + blockDim - 1) / blockDim;
+    return (VkDeviceSize)w * h * blockBytes;
+}
+
+static VkDeviceSize residentDataSize(const StreamedTexture* texture, uint32_t firstMip) {
+    VkDeviceSize size = 0;
+    for (uint32_t mip = firstMip; mip < texture->entry->mipCount; mip++) {
+        size += mipDataSize(texture->entry, mip);
+    }
+    return size;
+}
+
+static void writeTextureDescriptor(Engine* engine, uint32_t slot, VkImageView view) {
+    VkDescriptorImageInfo imageInfo = {
+        .imageView = view,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    };
+
+    VkWriteDescriptorSet descriptorWrite = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = engine->descriptorSet,
+        .dstBinding = 2,
+        .dstArrayElement = slot,
+        .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+        .descriptorCount = 1,
+        .pImageInfo = &imageInfo
+    };
+
+    vkUpdateDescriptorSets(engine->device, 1, &descriptorWrite, 0, NULL);
+}
+
+static VkResult createTextureImage(Engine* engine, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels,
+                                   VkImage* image, VkDeviceMemory* memory, VkImageView* view) {
+    VkImageCreateInfo imageInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = format,
+        .extent = {width, height, 1},
+        .mipLevels = mipLevels,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+
+    VkResult result = vkCreateImage(engine->device, &imageInfo, NULL, image);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create texture image: %d\n", result);
+        return result;
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(engine->device, *image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memRequirements.size,
+        .memoryTypeIndex = findMemoryType(engine, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+    };
+    if (allocInfo.memoryTypeIndex == UINT32_MAX) {
+        fprintf(stderr, "No device-local memory type for texture image\n");
+        vkDestroyImage(engine->device, *image, NULL);
+        *image = VK_NULL_HANDLE;
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+
+    result = vkAllocateMemory(engine->device, &allocInfo, NULL, memory);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate texture memory: %d\n", result);
+        vkDestroyImage(engine->device, *image, NULL);
+        *image = VK_NULL_HANDLE;
+        return result;
+    }
+    vkBindImageMemory(engine->device, *image, *memory, 0);
+
+    VkImageViewCreateInfo viewInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = *image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = format,
+        .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .subresourceRange.baseMipLevel = 0,
+        .subresourceRange.levelCount = mipLevels,
+        .subresourceRange.baseArrayLayer = 0,
+        .subresourceRange.layerCount = 1
+    };
+
+    result = vkCreateImageView(engine->device, &viewInfo, NULL, view);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create texture image view: %d\n", result);
+        vkFreeMemory(engine->device, *memory, NULL);
+        vkDestroyImage(engine->device, *image, NULL);
+        *memory = VK_NULL_HANDLE;
+        *image = VK_NULL_HANDLE;
+    }
+    return result;
+}
+
+static void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, uint32_t baseMip, uint32_t mipCount,
+                         VkImageLayout oldLayout, VkImageLayout newLayout,
+                         VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+                         VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = srcAccess,
+        .dstAccessMask = dstAccess,
+        .oldLayout = oldLayout,
+        .newLayout = newLayout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .subresourceRange.baseMipLevel = baseMip,
+        .subresourceRange.levelCount = mipCount,
+        .subresourceRange.baseArrayLayer = 0,
+        .subresourceRange.layerCount = 1
+    };
+
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+static VkDeviceSize stagingAlloc(TextureSystem* system, VkDeviceSize size) {
+    size = (size + 15) & ~(VkDeviceSize)15;
+    if (system->stagingHead + size > TEXTURE_STAGING_RING_SIZE) {
+        system->stagingHead = 0;
+    }
+    VkDeviceSize offset = system->stagingHead;
+    system->stagingHead += size;
+    return offset;
+}
+
+static void createFallbackTexture(Engine* engine, TextureSystem* system) {
+    if (createTextureImage(engine, VK_FORMAT_R8G8B8A8_UNORM, 1, 1, 1,
+                           &system->fallbackImage, &system->fallbackMemory, &system->fallbackView) != VK_SUCCESS) {
+        return;
+    }
+
+    const uint32_t white = 0xFFFFFFFFu;
+    VkDeviceSize offset = stagingAlloc(system, sizeof(white));
+    memcpy(system->stagingMapped + offset, &white, sizeof(white));
+
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands(engine);
+    if (commandBuffer == VK_NULL_HANDLE) return;
+
+    imageBarrier(commandBuffer, system->fallbackImage, 0, 1,
+                 VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                 VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkBufferImageCopy region = {
+        .bufferOffset = offset,
+        .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .imageExtent = {1, 1, 1}
+    };
+    vkCmdCopyBufferToImage(commandBuffer, system->stagingBuffer, system->fallbackImage,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    imageBarrier(commandBuffer, system->fallbackImage, 0, 1,
+                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                 VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+    endSingleTimeCommands(engine, commandBuffer);
+}
+
+void createTextureSystem(Engine* engine) {
+    TextureSystem* system = (TextureSystem*)calloc(1, sizeof(TextureSystem));
+    if (!system) {
+        fprintf(stderr, "Failed to allocate memory for texture system\n");
+        return;
+    }
+    system->budget = TEXTURE_DEFAULT_BUDGET;
+
+    if (createBuffer(engine, TEXTURE_STAGING_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     &system->stagingBuffer, &system->stagingMemory) != VK_SUCCESS) {
+        free(system);
+        return;
+    }
+
+    void* mapped;
+    if (vkMapMemory(engine->device, system->stagingMemory, 0, TEXTURE_STAGING_RING_SIZE, 0, &mapped) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to map texture staging ring\n");
+        vkFreeMemory(engine->device, system->stagingMemory, NULL);
+        vkDestroyBuffer(engine->device, system->stagingBuffer, NULL);
+        free(system);
+        return;
+    }
+    system->stagingMapped = (uint8_t*)mapped;
+
+    VkSamplerCreateInfo samplerInfo = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+        .minLod = 0.0f,
+        .maxLod = (float)TEXTURE_MAX_MIPS
+    };
+
+    if (vkCreateSampler(engine->device, &samplerInfo, NULL, &system->sampler) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create texture sampler\n");
+    }
+
+    engine->textures = system;
+    createFallbackTexture(engine, system);
+
+    VkDescriptorImageInfo samplerDescriptor = {
+        .sampler = system->sampler
+    };
+
+    VkWriteDescriptorSet samplerWrite = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = engine->descriptorSet,
+        .dstBinding = 1,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
+        .descriptorCount = 1,
+        .pImageInfo = &samplerDescriptor
+    };
+    vkUpdateDescriptorSets(engine->device, 1, &samplerWrite, 0, NULL);
+
+    for (uint32_t i = 0; i < MAX_TEXTURES; i++) {
+        writeTextureDescriptor(engine, i, system->fallbackView);
+    }
+}
+
+static void destroyRetiredImages(Engine* engine, TextureSystem* system) {
+    for (uint32_t i = 0; i < system->retiredCount; i++) {
+        vkDestroyImageView(engine->device, system->retired[i].view, NULL);
+        vkDestroyImage(engine->device, system->retired[i].image, NULL);
+        vkFreeMemory(engine->device, system->retired[i].memory, NULL);
+    }
+    system->retiredCount = 0;
+}
+
+void destroyTextureSystem(Engine* engine) {
+    TextureSystem* system = engine->textures;
+    if (!system) return;
+
+    destroyRetiredImages(engine, system);
+    for (uint32_t i = 0; i < system->textureCount; i++) {
+        StreamedTexture* texture = &system->textures[i];
+        if (texture->view) vkDestroyImageView(engine->device, texture->view, NULL);
+        if (texture->image) vkDestroyImage(engine->device, texture->image, NULL);
+        if (texture->memory) vkFreeMemory(engine->device, texture->memory, NULL);
+    }
+    if (system->fallbackView) vkDestroyImageView(engine->device, system->fallbackView, NULL);
+    if (system->fallbackImage) vkDestroyImage(engine->device, system->fallbackImage, NULL);
+    if (system->fallbackMemory) vkFreeMemory(engine->device, system->fallbackMemory, NULL);
+    if (system->sampler) vkDestroySampler(engine->device, system->sampler, NULL);
+    if (system->stagingMemory) {
+        vkUnmapMemory(engine->device, system->stagingMemory);
+        vkFreeMemory(engine->device, system->stagingMemory, NULL);
+    }
+    if (system->stagingBuffer) vkDestroyBuffer(engine->device, system->stagingBuffer, NULL);
+    for (uint32_t i = 0; i < system->packCount; i++) {
+        unmapFile(&system->packs[i]);
+    }
+    free(system);
+    engine->textures = NULL;
+}
+
+static int validatePackEntry(const TexturePackEntry* entry, size_t fileSize) {
+    uint32_t blockDim;
+    if (formatBlockBytes((VkFormat)entry->format, &blockDim) == 0) return 0;
+    if (entry->width == 0 || entry->height == 0 || entry->mipCount == 0 || entry->mipCount > TEXTURE_MAX_MIPS) return 0;
+
+    // A full chain ends at 1x1: floor(log2(max(width, height))) + 1 levels.
+    uint32_t fullChain = 1;
+    for (uint32_t size = entry->width > entry->height ? entry->width : entry->height; size > 1; size >>= 1) fullChain++;
+    if (entry->mipCount > fullChain) return 0;
+
+    for (uint32_t mip = 0; mip < entry->mipCount; mip++) {
+        const TexturePackMip* m = &entry->mips[mip];
+        if (m->size != mipDataSize(entry, mip)) return 0;
+        if (m->offset > fileSize || m->size > fileSize - m->offset) return 0;
+        if (m->size > TEXTURE_STAGING_FRAME_LIMIT) return 0;
+    }
+    return 1;
+}
+
+EXPORT int32_t engine_texture_pack_open(Engine* engine, const char* path, uint32_t* textureCount) {
+    if (engine->capture && path) {
+        captureCall(engine, CAPTURE_TEXTURE_PACK_OPEN, NULL, 0, (CaptureData[]){{path, (uint32_t)strlen(path) + 1}}, 1);
+    }
+    if (!engine->textures) createLazily(engine, "texture system", createTextureSystem);
+    TextureSystem* system = engine->textures;
+    if (textureCount) *textureCount = 0;
+    if (!system) {
+        fprintf(stderr, "Texture system not initialized\n");
+        return -1;
+    }
+    if (system->packCount == MAX_TEXTURE_PACKS) {
+        fprintf(stderr, "Too many texture packs, max is %d\n", MAX_TEXTURE_PACKS);
+        return -1;
+    }
+
+    MappedFile* pack = &system->packs[system->packCount];
+    if (!mapFile(path, pack)) return -1;
+
+    const TexturePackHeader* header = (const TexturePackHeader*)pack->data;
+    if (pack->size < sizeof(TexturePackHeader) || memcmp(header->magic, "DFTP", 4) != 0 || header->version != 1) {
+        fprintf(stderr, "Invalid texture pack: %s\n", path);
+        unmapFile(pack);
+        return -1;
+    }
+    if (header->textureCount > MAX_TEXTURES - system->textureCount ||
+        header->textureCount > (pack->size - sizeof(TexturePackHeader)) / sizeof(TexturePackEntry)) {
+        fprintf(stderr, "Texture pack %s does not fit, %u textures\n", path, header->textureCount);
+        unmapFile(pack);
+        return -1;
+    }
+
+    const TexturePackEntry* entries = (const TexturePackEntry*)(pack->data + sizeof(TexturePackHeader));
+    for (uint32_t i = 0; i < header->textureCount; i++) {
+        if (!validatePackEntry(&entries[i], pack->size)) {
+            fprintf(stderr, "Invalid texture %u in pack %s\n", i, path);
+            unmapFile(pack);
+            return -1;
+        }
+    }
+
+    uint32_t first = system->textureCount;
+    for (uint32_t i = 0; i < header->textureCount; i++) {
+        StreamedTexture* texture = &system->textures[first + i];
+        memset(texture, 0, sizeof(*texture));
+        texture->entry = &entries[i];
+
+        // Block compression is optional in Vulkan; such textures are reported once and never streamed.
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(engine->physicalDevice, (VkFormat)entries[i].format, &formatProperties);
+        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+            fprintf(stderr, "Texture %u in pack %s: format %u is not supported by the device\n", i, path, entries[i].format);
+            texture->failed = 1;
+        }
+        texture->data = pack->data;
+        texture->residentMip = entries[i].mipCount;
+        texture->targetMip = entries[i].mipCount;
+        texture->tailMip = entries[i].mipCount - 1;
+        while (texture->tailMip > 0 &&
+               mipDimension(entries[i].width, texture->tailMip - 1) <= TEXTURE_TAIL_DIMENSION &&
+               mipDimension(entries[i].height, texture->tailMip - 1) <= TEXTURE_TAIL_DIMENSION) {
+            texture->tailMip--;
+        }
+        texture->lastUsedFrame = engine->frameIndex;
+    }
+
+    system->packCount++;
+    system->textureCount += header->textureCount;
+    if (textureCount) *textureCount = header->textureCount;
+    return (int32_t)first;
+}
+
+// Marks a texture as used this frame; the engine's own draws call this, so they are not captured.
+void touchTexture(Engine* engine, uint32_t texture) {
+    if (!engine->textures || texture >= engine->textures->textureCount) return;
+    engine->textures->textures[texture].lastUsedFrame = engine->frameIndex;
+}
+
+EXPORT void engine_texture_touch(Engine* engine, uint32_t texture) {
+    if (engine->capture) captureCall(engine, CAPTURE_TEXTURE_TOUCH, (CaptureWord[]){{.u = texture}}, 1, NULL, 0);
+    touchTexture(engine, texture);
+}
+
+EXPORT void engine_texture_set_budget(Engine* engine, uint64_t bytes) {
+    if (engine->capture) {
+        captureCall(engine, CAPTURE_TEXTURE_SET_BUDGET, (CaptureWord[]){{.u = (uint32_t)bytes}, {.u = (uint32_t)(bytes >> 32)}}, 2, NULL, 0);
+    }
+    if (!engine->textures) createLazily(engine, "texture system", createTextureSystem);
+    if (engine->textures) engine->textures->budget = bytes;
+}
+
+EXPORT uint64_t engine_texture_resident_bytes(Engine* engine) {
+    return engine->textures ? engine->textures->residentBytes : 0;
+}
+
+static int isWanted(const StreamedTexture* texture, uint64_t frameIndex) {
+    if (texture->failed) return 0;
+    return texture->targetMip > texture->tailMip || texture->lastUsedFrame + TEXTURE_KEEP_FRAMES >= frameIndex;
+}
+
+// Drops the top mip of the least recently used texture that is colder than the requester, or of
+// any texture when the requester is UINT32_MAX.
+static int evictOneMip(TextureSystem* system, uint32_t requester, VkDeviceSize* planned) {
+    uint64_t requesterFrame = requester < system->textureCount ? system->textures[requester].lastUsedFrame : UINT64_MAX;
+    int victim = -1;
+    for (uint32_t i = 0; i < system->textureCount; i++) {
+        const StreamedTexture* texture = &system->textures[i];
+        if (i == requester || texture->targetMip >= texture->tailMip || texture->targetMip < texture->residentMip) continue;
+        if (texture->lastUsedFrame >= requesterFrame) continue;
+        if (victim < 0 || texture->lastUsedFrame < system->textures[victim].lastUsedFrame) victim = (int)i;
+    }
+    if (victim < 0) return 0;
+
+    StreamedTexture* texture = &system->textures[victim];
+    *planned -= mipDataSize(texture->entry, texture->targetMip);
+    texture->targetMip++;
+    return 1;
+}
+
+static void rebuildTexture(Engine* engine, TextureSystem* system, uint32_t slot, VkCommandBuffer commandBuffer) {
+    StreamedTexture* texture = &system->textures[slot];
+    const TexturePackEntry* entry = texture->entry;
+    uint32_t first = texture->targetMip;
+    uint32_t levels = entry->mipCount - first;
+
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+    VkResult result = createTextureImage(engine, (VkFormat)entry->format, mipDimension(entry->width, first),
+                                         mipDimension(entry->height, first), levels, &image, &memory, &view);
+    if (result != VK_SUCCESS) {
+        texture->targetMip = texture->residentMip;
+        if (result == VK_ERROR_FORMAT_NOT_SUPPORTED) texture->failed = 1;
+        return;
+    }
+
+    imageBarrier(commandBuffer, image, 0, levels,
+                 VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                 VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    uint32_t oldFirst = texture->residentMip;
+    if (texture->image) {
+        uint32_t copyFirst = first > oldFirst ? first : oldFirst;
+        uint32_t copyCount = entry->mipCount - copyFirst;
+
+        imageBarrier(commandBuffer, texture->image, copyFirst - oldFirst, copyCount,
+                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                     VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        VkImageCopy regions[TEXTURE_MAX_MIPS];
+        for (uint32_t i = 0; i < copyCount; i++) {
+            uint32_t mip = copyFirst + i;
+            regions[i] = (VkImageCopy){
+                .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - oldFirst, 0, 1},
+                .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - first, 0, 1},
+                .extent = {mipDimension(entry->width, mip), mipDimension(entry->height, mip), 1}
+            };
+        }
+        vkCmdCopyImage(commandBuffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copyCount, regions);
+
+        system->retired[system->retiredCount++] = (RetiredImage){texture->image, texture->memory, texture->view};
+    }
+
+    // Lowest mips first, so a texture never samples a higher level than it has finished.
+    for (uint32_t mip = oldFirst; mip-- > first;) {
+        const TexturePackMip* source = &entry->mips[mip];
+        VkDeviceSize offset = stagingAlloc(system, source->size);
+        memcpy(system->stagingMapped + offset, texture->data + source->offset, (size_t)source->size);
+
+        VkBufferImageCopy region = {
+            .bufferOffset = offset,
+            .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - first, 0, 1},
+            .imageExtent = {mipDimension(entry->width, mip), mipDimension(entry->height, mip), 1}
+        };
+        vkCmdCopyBufferToImage(commandBuffer, system->stagingBuffer, image,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    }
+
+    imageBarrier(commandBuffer, image, 0, levels,
+                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                 VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+    system->residentBytes -= residentDataSize(texture, oldFirst);
+    system->residentBytes += residentDataSize(texture, first);
+    texture->image = image;
+    texture->memory = memory;
+    texture->view = view;
+    texture->residentMip = first;
+    writeTextureDescriptor(engine, slot, view);
+}
+
+void updateTextureStreaming(Engine* engine, VkCommandBuffer commandBuffer) {
+    TextureSystem* system = engine->textures;
+    if (!system) return;
+
+    // The previous frame has finished on the GPU, so its retired images and staging space are free.
+    destroyRetiredImages(engine, system);
+
+    // A lowered budget, or one exceeded while nothing asks for more, still has to be met.
+    VkDeviceSize planned = system->residentBytes;
+    while (planned > system->budget) {
+        if (!evictOneMip(system, UINT32_MAX, &planned)) break;
+    }
+
+    VkDeviceSize frameStaging = 0;
+    for (;;) {
+        int best = -1;
+        VkDeviceSize bestSize = 0;
+        for (uint32_t i = 0; i < system->textureCount; i++) {
+            const StreamedTexture* texture = &system->textures[i];
+            if (texture->targetMip == 0 || !isWanted(texture, engine->frameIndex)) continue;
+            VkDeviceSize size = mipDataSize(texture->entry, texture->targetMip - 1);
+            if (best < 0 || size < bestSize ||
+                (size == bestSize && texture->lastUsedFrame > system->textures[best].lastUsedFrame)) {
+                best = (int)i;
+                bestSize = size;
+            }
+        }
+        if (best < 0) break;
+
+        VkDeviceSize stagingSize = (bestSize + 15) & ~(VkDeviceSize)15;
+        if (frameStaging + stagingSize > TEXTURE_STAGING_FRAME_LIMIT) break;
+
+        // Tail mips are always kept; anything above them has to fit the budget.
+        StreamedTexture* texture = &system->textures[best];
+        int isTail = texture->targetMip > texture->tailMip;
+        while (!isTail && planned + bestSize > system->budget) {
+            if (!evictOneMip(system, (uint32_t)best, &planned)) break;
+        }
+        if (!isTail && planned + bestSize > system->budget) break;
+
+        texture->targetMip--;
+        planned += bestSize;
+        frameStaging += stagingSize;
+    }
+
+    for (uint32_t i = 0; i < system->textureCount && system->retiredCount < MAX_TEXTURES; i++) {
+        if (system->textures[i].targetMip != system->textures[i].residentMip) {
+            TRACE_CALL(rebuildTexture(engine, system, i, commandBuffer));
+        }
+    }
+}
@@ -0,0 +1,242 @@
+#include "engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#include <time.h>
+#define TRACE_THREAD_LOCAL _Thread_local
+#endif
+
+#define TRACE_BUFFER_EVENTS 65536
+
+typedef struct {
+    const char* name;
+    uint64_t start;
+    uint64_t duration;
+    uint32_t track;
+    uint32_t reserved;
+} TraceEvent;
+
+// Owned and written by one thread. `count` is published with release semantics so the thread
+// that ends the capture can read a consistent prefix while the owner keeps recording.
+typedef struct TraceBuffer {
+    struct TraceBuffer* next;
+    volatile uint32_t session;
+    volatile uint32_t count;
+    uint32_t dropped;
+    uint32_t thread;
+    const char* name;
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+} TraceBuffer;
+
+volatile uint32_t traceEnabled = 0;
+
+static volatile uint32_t traceSession = 0;
+static volatile uint32_t traceThreadCount = 0;
+static TraceBuffer* volatile traceBuffers = NULL;
+static char* tracePath = NULL;
+static uint64_t traceStart = 0;
+
+static TRACE_THREAD_LOCAL TraceBuffer* threadBuffer = NULL;
+static TRACE_THREAD_LOCAL const char* threadName = NULL;
+
+#ifdef _WIN32
+static uint32_t loadAcquire(volatile uint32_t* value) {
+    uint32_t result = *value;
+    MemoryBarrier();
+    return result;
+}
+
+static void storeRelease(volatile uint32_t* value, uint32_t desired) {
+    MemoryBarrier();
+    *value = desired;
+}
+
+static uint32_t fetchAdd(volatile uint32_t* value, uint32_t add) {
+    return (uint32_t)InterlockedExchangeAdd((volatile LONG*)value, (LONG)add);
+}
+
+static void* loadPointer(void* volatile* target) {
+    void* result = *target;
+    MemoryBarrier();
+    return result;
+}
+
+static int compareExchangePointer(void* volatile* target, void* expected, void* desired) {
+    return InterlockedCompareExchangePointer(target, desired, expected) == expected;
+}
+
+uint64_t traceNow(void) {
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ull +
+           (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ull / (uint64_t)frequency.QuadPart;
+}
+#else
+static uint32_t loadAcquire(volatile uint32_t* value) {
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+static void storeRelease(volatile uint32_t* value, uint32_t desired) {
+    __atomic_store_n(value, desired, __ATOMIC_RELEASE);
+}
+
+static uint32_t fetchAdd(volatile uint32_t* value, uint32_t add) {
+    return __atomic_fetch_add(value, add, __ATOMIC_RELAXED);
+}
+
+static void* loadPointer(void* volatile* target) {
+    return __atomic_load_n(target, __ATOMIC_ACQUIRE);
+}
+
+static int compareExchangePointer(void* volatile* target, void* expected, void* desired) {
+    return __atomic_compare_exchange_n(target, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+uint64_t traceNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+#endif
+
+// Buffers are created on a thread's first event and live for the rest of the process, since the
+// owner may still hold its pointer after a capture ends.
+static TraceBuffer* acquireThreadBuffer(void) {
+    if (threadBuffer) return threadBuffer;
+
+    TraceBuffer* buffer = (TraceBuffer*)calloc(1, sizeof(TraceBuffer));
+    if (!buffer) return NULL;
+    buffer->thread = fetchAdd(&traceThreadCount, 1) + TRACE_TRACK_GPU + 1;
+    buffer->name = threadName;
+    buffer->session = loadAcquire(&traceSession);
+
+    TraceBuffer* head;
+    do {
+        head = (TraceBuffer*)loadPointer((void* volatile*)&traceBuffers);
+        buffer->next = head;
+    } while (!compareExchangePointer((void* volatile*)&traceBuffers, head, buffer));
+
+    threadBuffer = buffer;
+    return buffer;
+}
+
+void traceThreadName(const char* name) {
+    threadName = name;
+    if (threadBuffer) threadBuffer->name = name;
+}
+
+void traceEmit(const char* name, uint64_t start, uint64_t duration, uint32_t track) {
+    if (!traceEnabled) return;
+    TraceBuffer* buffer = acquireThreadBuffer();
+    if (!buffer) return;
+
+    uint32_t session = loadAcquire(&traceSession);
+    if (buffer->session != session) {
+        buffer->dropped = 0;
+        storeRelease(&buffer->count, 0);
+        storeRelease(&buffer->session, session);
+    }
+
+    uint32_t count = buffer->count;
+    if (count == TRACE_BUFFER_EVENTS) {
+        buffer->dropped++;
+        return;
+    }
+    buffer->events[count] = (TraceEvent){name, start, duration, track != TRACE_TRACK_THREAD ? track : buffer->thread, 0};
+    storeRelease(&buffer->count, count + 1);
+}
+
+static void writeJsonString(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') fputc('\\', file);
+        if ((unsigned char)*c >= 0x20) fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+static void writeThreadName(FILE* file, uint32_t track, const char* name) {
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", track);
+    writeJsonString(file, name);
+    fputs("}},\n", file);
+}
+
+// Starts a capture. Begin and end are expected to be called from one controlling thread.
+EXPORT int engine_trace_begin(const char* path) {
+    if (traceEnabled) {
+        fprintf(stderr, "engine_trace_begin: a trace is already being recorded\n");
+        return 0;
+    }
+
+    size_t length = strlen(path);
+    char* copy = (char*)malloc(length + 1);
+    if (!copy) {
+        fprintf(stderr, "Failed to allocate memory for trace path\n");
+        return 0;
+    }
+    memcpy(copy, path, length + 1);
+    free(tracePath);
+    tracePath = copy;
+
+    traceStart = traceNow();
+    storeRelease(&traceSession, traceSession + 1);
+    storeRelease(&traceEnabled, 1);
+    return 1;
+}
+
+// Stops the capture and writes it out. Returns the number of events written, or -1.
+EXPORT int64_t engine_trace_end(void) {
+    if (!traceEnabled) return -1;
+    storeRelease(&traceEnabled, 0);
+
+    FILE* file = fopen(tracePath, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open trace file: %s\n", tracePath);
+        return -1;
+    }
+
+    uint32_t session = loadAcquire(&traceSession);
+    int64_t written = 0;
+    uint32_t dropped = 0;
+    char name[32];
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+    writeThreadName(file, TRACE_TRACK_GPU, "GPU");
+    TraceBuffer* buffers = (TraceBuffer*)loadPointer((void* volatile*)&traceBuffers);
+    for (TraceBuffer* buffer = buffers; buffer; buffer = buffer->next) {
+        if (loadAcquire(&buffer->session) != session) continue;
+
+        if (buffer->name) {
+            writeThreadName(file, buffer->thread, buffer->name);
+        } else {
+            snprintf(name, sizeof(name), "Thread %u", buffer->thread);
+            writeThreadName(file, buffer->thread, name);
+        }
+
+        uint32_t count = loadAcquire(&buffer->count);
+        dropped += buffer->dropped;
+        for (uint32_t i = 0; i < count; i++) {
+            const TraceEvent* event = &buffer->events[i];
+            // Events recorded before the capture started (GPU ranges mapped back in time) are clamped.
+            uint64_t start = event->start > traceStart ? event->start - traceStart : 0;
+            fputs("{\"name\":", file);
+            writeJsonString(file, event->name);
+            fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f},\n",
+                    event->track == TRACE_TRACK_GPU ? "gpu" : "cpu", event->track,
+                    (double)start / 1000.0, (double)event->duration / 1000.0);
+            written++;
+        }
+    }
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"df_engine\"}}\n]}\n");
+    fclose(file);
+
+    if (dropped > 0) fprintf(stderr, "Trace buffers were full, %u events dropped\n", dropped);
+    return written;
+}
@@ -0,0 +1,33 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Timeline capture written as Chrome trace event JSON (chrome://tracing, ui.perfetto.dev).
+// Every thread appends to its own buffer, so recording takes no locks. Zone names must be
+// string literals or otherwise outlive the capture.
+
+#define TRACE_TRACK_THREAD 0  // the calling thread's own track
+#define TRACE_TRACK_GPU 1     // GPU ranges; CPU threads are numbered from 2
+
+extern volatile uint32_t traceEnabled;
+
+uint64_t traceNow(void);  // monotonic nanoseconds
+void traceEmit(const char* name, uint64_t start, uint64_t duration, uint32_t track);
+void traceThreadName(const char* name);
+
+typedef struct {
+    const char* name;
+    uint64_t start;
+} TraceZone;
+
+// A zone whose end is never reached (early return, continue) is simply not recorded.
+#define TRACE_ZONE_BEGIN(zone, zoneName) \
+    TraceZone zone = traceEnabled ? (TraceZone){(zoneName), traceNow()} : (TraceZone){NULL, 0}
+#define TRACE_ZONE_END(zone) \
+    do { if ((zone).name) traceEmit((zone).name, (zone).start, traceNow() - (zone).start, TRACE_TRACK_THREAD); } while (0)
+
+#define TRACE_CALL(call) \
+    do { TRACE_ZONE_BEGIN(traceCallZone, #call); call; TRACE_ZONE_END(traceCallZone); } while (0)
+
+#endif
@@ -0,0 +1,95 @@
+#include "vertexcodec.h"
+#include <string.h>
+
+#define FLOAT_VERTEX_SIZE (sizeof(float) * 6)
+
+uint32_t vertexLayoutStride(uint32_t layout) {
+    switch (layout) {
+        case MESH_LAYOUT_POSITION_COLOR:
+            return FLOAT_VERTEX_SIZE;
+        case MESH_LAYOUT_HALF_POSITION:
+        case MESH_LAYOUT_SNORM16_POSITION:
+            return sizeof(QuantizedVertex);
+        default:
+            return 0;
+    }
+}
+
+// Round to nearest even, including into the subnormal range; inputs are normalized to [-1, 1].
+static uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (exponent >= 31) return (uint16_t)(sign | 0x7C00);
+    if (exponent <= 0) {
+        if (exponent < -10) return (uint16_t)sign;
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) half++;
+        return (uint16_t)(sign | half);
+    }
+
+    // A carry out of the mantissa correctly bumps the exponent.
+    uint32_t half = (uint32_t)exponent << 10 | mantissa >> 13;
+    uint32_t rest = mantissa & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++;
+    return (uint16_t)(sign | half);
+}
+
+static uint16_t floatToSnorm16(float value) {
+    if (value < -1.0f) value = -1.0f;
+    if (value > 1.0f) value = 1.0f;
+    float scaled = value * 32767.0f;
+    return (uint16_t)(int16_t)(scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f);
+}
+
+static uint8_t floatToUnorm8(float value) {
+    if (value < 0.0f) value = 0.0f;
+    if (value > 1.0f) value = 1.0f;
+    return (uint8_t)(value * 255.0f + 0.5f);
+}
+
+void encodeVertices(void* destination, uint32_t layout, const float* vertices, uint32_t vertexCount,
+                    size_t stride, VertexDequantize* dequantize) {
+    const uint8_t* source = (const uint8_t*)vertices;
+    if (layout == MESH_LAYOUT_POSITION_COLOR) {
+        for (uint32_t i = 0; i < vertexCount; i++) {
+            memmove((uint8_t*)destination + FLOAT_VERTEX_SIZE * i, source + stride * i, FLOAT_VERTEX_SIZE);
+        }
+        *dequantize = (VertexDequantize){{1.0f, 1.0f, 1.0f}, {0.0f, 0.0f, 0.0f}};
+        return;
+    }
+
+    float min[3], max[3];
+    memcpy(min, vertices, sizeof(min));
+    memcpy(max, vertices, sizeof(max));
+    for (uint32_t i = 1; i < vertexCount; i++) {
+        const float* p = (const float*)(source + stride * i);
+        for (int c = 0; c < 3; c++) {
+            if (p[c] < min[c]) min[c] = p[c];
+            if (p[c] > max[c]) max[c] = p[c];
+        }
+    }
+    for (int c = 0; c < 3; c++) {
+        dequantize->offset[c] = (min[c] + max[c]) * 0.5f;
+        dequantize->scale[c] = (max[c] - min[c]) * 0.5f;
+        if (dequantize->scale[c] <= 0.0f) dequantize->scale[c] = 1.0f;  // flat along this axis
+    }
+
+    QuantizedVertex* out = (QuantizedVertex*)destination;
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        const float* v = (const float*)(source + stride * i);
+        uint16_t position[3];
+        for (int c = 0; c < 3; c++) {
+            float normalized = (v[c] - dequantize->offset[c]) / dequantize->scale[c];
+            position[c] = layout == MESH_LAYOUT_HALF_POSITION ? floatToHalf(normalized) : floatToSnorm16(normalized);
+        }
+        out[i] = (QuantizedVertex){position[0], position[1], position[2], 0,
+                                   floatToUnorm8(v[3]), floatToUnorm8(v[4]), floatToUnorm8(v[5]), 255};
+    }
+}
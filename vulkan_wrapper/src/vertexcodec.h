@@ -0,0 +1,37 @@
+#ifndef VERTEXCODEC_H
+#define VERTEXCODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Vertex layouts a mesh can be stored in; shared by the engine and the offline tools. Values are
+// part of the mesh pack format.
+// The quantized layouts keep positions normalized to the mesh AABB; the engine folds the
+// dequantization into each instance matrix, so every layout runs the same vertex shader.
+enum {
+    MESH_LAYOUT_POSITION_COLOR,    // float xyz + float rgb, the Vertex3D layout (24 bytes)
+    MESH_LAYOUT_HALF_POSITION,     // half xyz + pad, RGBA8 colour (12 bytes)
+    MESH_LAYOUT_SNORM16_POSITION,  // snorm16 xyz + pad, RGBA8 colour (12 bytes)
+    MESH_LAYOUT_COUNT
+};
+
+typedef struct {
+    uint16_t x, y, z, w;
+    uint8_t r, g, b, a;
+} QuantizedVertex;
+
+// Object-space position = stored * scale + offset, per axis. Identity for the float layout.
+typedef struct {
+    float scale[3];
+    float offset[3];
+} VertexDequantize;
+
+uint32_t vertexLayoutStride(uint32_t layout);
+
+// Encodes vertexCount xyz + rgb float vertices, stride bytes apart, into layout and returns the
+// transform that recovers their positions. Snorm16 is uniformly precise across the AABB; half
+// spends its precision near the center.
+void encodeVertices(void* destination, uint32_t layout, const float* vertices, uint32_t vertexCount,
+                    size_t stride, VertexDequantize* dequantize);
+
+#endif
@@ -0,0 +1,224 @@
+#include "vmath.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(VMATH_SSE)
+#include <xmmintrin.h>
+#elif defined(VMATH_NEON)
+#include <arm_neon.h>
+#endif
+
+EXPORT void engine_mat4_identity(float* out) {
+    memset(out, 0, sizeof(float) * 16);
+    out[0] = out[5] = out[10] = out[15] = 1.0f;
+}
+
+EXPORT void engine_mat4_multiply(float* out, const float* a, const float* b) {
+#if defined(VMATH_SSE)
+    __m128 a0 = _mm_loadu_ps(a);
+    __m128 a1 = _mm_loadu_ps(a + 4);
+    __m128 a2 = _mm_loadu_ps(a + 8);
+    __m128 a3 = _mm_loadu_ps(a + 12);
+    __m128 col[4];
+    for (int j = 0; j < 4; j++) {
+        const float* bj = b + j * 4;
+        __m128 r = _mm_mul_ps(a0, _mm_set1_ps(bj[0]));
+        r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(bj[1])));
+        r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(bj[2])));
+        r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(bj[3])));
+        col[j] = r;
+    }
+    for (int j = 0; j < 4; j++) {
+        _mm_storeu_ps(out + j * 4, col[j]);
+    }
+#elif defined(VMATH_NEON)
+    float32x4_t a0 = vld1q_f32(a);
+    float32x4_t a1 = vld1q_f32(a + 4);
+    float32x4_t a2 = vld1q_f32(a + 8);
+    float32x4_t a3 = vld1q_f32(a + 12);
+    float32x4_t col[4];
+    for (int j = 0; j < 4; j++) {
+        float32x4_t bj = vld1q_f32(b + j * 4);
+        float32x4_t r = vmulq_lane_f32(a0, vget_low_f32(bj), 0);
+        r = vmlaq_lane_f32(r, a1, vget_low_f32(bj), 1);
+        r = vmlaq_lane_f32(r, a2, vget_high_f32(bj), 0);
+        r = vmlaq_lane_f32(r, a3, vget_high_f32(bj), 1);
+        col[j] = r;
+    }
+    for (int j = 0; j < 4; j++) {
+        vst1q_f32(out + j * 4, col[j]);
+    }
+#else
+    float r[16];
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            r[j * 4 + i] = a[i] * b[j * 4] + a[4 + i] * b[j * 4 + 1] + a[8 + i] * b[j * 4 + 2] + a[12 + i] * b[j * 4 + 3];
+        }
+    }
+    memcpy(out, r, sizeof(r));
+#endif
+}
+
+EXPORT void engine_mat4_multiply_batch(float* out, const float* a, const float* b, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        engine_mat4_multiply(out + i * 16, a, b + i * 16);
+    }
+}
+
+EXPORT int engine_mat4_inverse(float* out, const float* m) {
+    float inv[16];
+    inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+    inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+    inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+    inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+    inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+    inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+    inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+    float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+    if (det == 0.0f) return 0;
+
+    float invDet = 1.0f / det;
+    for (int i = 0; i < 16; i++) {
+        out[i] = inv[i] * invDet;
+    }
+    return 1;
+}
+
+EXPORT void engine_mat4_look_at(float* out, const float* eye, const float* target, const float* up) {
+    float f[3] = {target[0] - eye[0], target[1] - eye[1], target[2] - eye[2]};
+    float fl = sqrtf(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+    f[0] /= fl; f[1] /= fl; f[2] /= fl;
+
+    float s[3] = {f[1] * up[2] - f[2] * up[1], f[2] * up[0] - f[0] * up[2], f[0] * up[1] - f[1] * up[0]};
+    float sl = sqrtf(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]);
+    s[0] /= sl; s[1] /= sl; s[2] /= sl;
+
+    float u[3] = {s[1] * f[2] - s[2] * f[1], s[2] * f[0] - s[0] * f[2], s[0] * f[1] - s[1] * f[0]};
+
+    out[0] = s[0]; out[4] = s[1]; out[8] = s[2];
+    out[1] = u[0]; out[5] = u[1]; out[9] = u[2];
+    out[2] = -f[0]; out[6] = -f[1]; out[10] = -f[2];
+    out[3] = 0.0f; out[7] = 0.0f; out[11] = 0.0f;
+    out[12] = -(s[0] * eye[0] + s[1] * eye[1] + s[2] * eye[2]);
+    out[13] = -(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2]);
+    out[14] = f[0] * eye[0] + f[1] * eye[1] + f[2] * eye[2];
+    out[15] = 1.0f;
+}
+
+EXPORT void engine_mat4_perspective(float* out, float fovY, float aspect, float nearZ, float farZ) {
+    float f = 1.0f / tanf(fovY * 0.5f);
+    memset(out, 0, sizeof(float) * 16);
+    out[0] = f / aspect;
+    out[5] = f;
+    out[10] = farZ / (nearZ - farZ);
+    out[11] = -1.0f;
+    out[14] = nearZ * farZ / (nearZ - farZ);
+}
+
+EXPORT void engine_mat4_ortho(float* out, float left, float right, float bottom, float top, float nearZ, float farZ) {
+    memset(out, 0, sizeof(float) * 16);
+    out[0] = 2.0f / (right - left);
+    out[5] = 2.0f / (top - bottom);
+    out[10] = -1.0f / (farZ - nearZ);
+    out[12] = -(right + left) / (right - left);
+    out[13] = -(top + bottom) / (top - bottom);
+    out[14] = -nearZ / (farZ - nearZ);
+    out[15] = 1.0f;
+}
+
+EXPORT void engine_mat4_from_trs(float* out, const float* translation, const float* rotation, const float* scale) {
+    float x = rotation[0], y = rotation[1], z = rotation[2], w = rotation[3];
+    float xx = x * x, yy = y * y, zz = z * z;
+    float xy = x * y, xz = x * z, yz = y * z;
+    float wx = w * x, wy = w * y, wz = w * z;
+
+    out[0] = (1.0f - 2.0f * (yy + zz)) * scale[0];
+    out[1] = 2.0f * (xy + wz) * scale[0];
+    out[2] = 2.0f * (xz - wy) * scale[0];
+    out[3] = 0.0f;
+    out[4] = 2.0f * (xy - wz) * scale[1];
+    out[5] = (1.0f - 2.0f * (xx + zz)) * scale[1];
+    out[6] = 2.0f * (yz + wx) * scale[1];
+    out[7] = 0.0f;
+    out[8] = 2.0f * (xz + wy) * scale[2];
+    out[9] = 2.0f * (yz - wx) * scale[2];
+    out[10] = (1.0f - 2.0f * (xx + yy)) * scale[2];
+    out[11] = 0.0f;
+    out[12] = translation[0];
+    out[13] = translation[1];
+    out[14] = translation[2];
+    out[15] = 1.0f;
+}
+
+EXPORT void engine_frustum_planes(float* out, const float* m) {
+    // Rows of the column-major matrix.
+    float r0[4] = {m[0], m[4], m[8], m[12]};
+    float r1[4] = {m[1], m[5], m[9], m[13]};
+    float r2[4] = {m[2], m[6], m[10], m[14]};
+    float r3[4] = {m[3], m[7], m[11], m[15]};
+
+    for (int i = 0; i < 4; i++) {
+        out[0 + i] = r3[i] + r0[i];
+        out[4 + i] = r3[i] - r0[i];
+        out[8 + i] = r3[i] + r1[i];
+        out[12 + i] = r3[i] - r1[i];
+        out[16 + i] = r2[i];
+        out[20 + i] = r3[i] - r2[i];
+    }
+
+    for (int p = 0; p < 6; p++) {
+        float* plane = out + p * 4;
+        float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.0f) {
+            float inv = 1.0f / length;
+            plane[0] *= inv; plane[1] *= inv; plane[2] *= inv; plane[3] *= inv;
+        }
+    }
+}
+
+EXPORT void engine_transform_points(float* out, const float* m, const float* in, uint32_t count) {
+#if defined(VMATH_SSE)
+    __m128 c0 = _mm_loadu_ps(m);
+    __m128 c1 = _mm_loadu_ps(m + 4);
+    __m128 c2 = _mm_loadu_ps(m + 8);
+    __m128 c3 = _mm_loadu_ps(m + 12);
+    for (uint32_t i = 0; i < count; i++) {
+        const float* p = in + i * 4;
+        __m128 r = _mm_add_ps(c3, _mm_mul_ps(c0, _mm_set1_ps(p[0])));
+        r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(p[1])));
+        r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(p[2])));
+        _mm_storeu_ps(out + i * 4, r);
+    }
+#elif defined(VMATH_NEON)
+    float32x4_t c0 = vld1q_f32(m);
+    float32x4_t c1 = vld1q_f32(m + 4);
+    float32x4_t c2 = vld1q_f32(m + 8);
+    float32x4_t c3 = vld1q_f32(m + 12);
+    for (uint32_t i = 0; i < count; i++) {
+        float32x4_t p = vld1q_f32(in + i * 4);
+        float32x4_t r = vmlaq_lane_f32(c3, c0, vget_low_f32(p), 0);
+        r = vmlaq_lane_f32(r, c1, vget_low_f32(p), 1);
+        r = vmlaq_lane_f32(r, c2, vget_high_f32(p), 0);
+        vst1q_f32(out + i * 4, r);
+    }
+#else
+    for (uint32_t i = 0; i < count; i++) {
+        const float* p = in + i * 4;
+        float r[4];
+        for (int k = 0; k < 4; k++) {
+            r[k] = m[k] * p[0] + m[4 + k] * p[1] + m[8 + k] * p[2] + m[12 + k];
+        }
+        memcpy(out + i * 4, r, sizeof(r));
+    }
+#endif
+}
@@ -0,0 +1,48 @@
+#ifndef VMATH_H
+#define VMATH_H
+
+#include <stdint.h>
+
+#ifndef EXPORT
+#ifdef _WIN32
+#define EXPORT __declspec(dllexport)
+#else
+#define EXPORT
+#endif
+#endif
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define VMATH_SSE 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define VMATH_NEON 1
+#endif
+
+#ifdef _MSC_VER
+#define VMATH_ALIGN16 __declspec(align(16))
+#else
+#define VMATH_ALIGN16 __attribute__((aligned(16)))
+#endif
+
+// Matrices are 16 floats, column-major (GLSL layout), preferably 16-byte aligned.
+// Vectors in batch functions are 4 floats each. Every function writes into a caller-provided
+// buffer and never allocates; output may alias an input unless noted.
+typedef struct {
+    VMATH_ALIGN16 float m[16];
+} Mat4;
+
+EXPORT void engine_mat4_identity(float* out);
+EXPORT void engine_mat4_multiply(float* out, const float* a, const float* b);
+EXPORT int engine_mat4_inverse(float* out, const float* m);
+EXPORT void engine_mat4_look_at(float* out, const float* eye, const float* target, const float* up);
+// Right-handed, Vulkan clip space: depth 0 at near, 1 at far.
+EXPORT void engine_mat4_perspective(float* out, float fovY, float aspect, float nearZ, float farZ);
+EXPORT void engine_mat4_ortho(float* out, float left, float right, float bottom, float top, float nearZ, float farZ);
+EXPORT void engine_mat4_from_trs(float* out, const float* translation, const float* rotation, const float* scale);
+// Six normalized planes (left, right, bottom, top, near, far), 4 floats each: dot(n, p) + d >= 0 is inside.
+EXPORT void engine_frustum_planes(float* out, const float* viewProj);
+// out[i] = m * (in[i].xyz, 1)
+EXPORT void engine_transform_points(float* out, const float* m, const float* in, uint32_t count);
+// out[i] = a * b[i]; out must not alias a.
+EXPORT void engine_mat4_multiply_batch(float* out, const float* a, const float* b, uint32_t count);
+
+#endif
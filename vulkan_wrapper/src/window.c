@@ -0,0 +1,338 @@
+#include "engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Per-window view matrices share one uniform buffer; 256 is the largest offset alignment the
+// spec allows, so it is valid everywhere.
+#define WINDOW_UNIFORM_STRIDE 256
+
+// An extra window of the engine: its own surface and swapchain, everything else (pipelines,
+// meshes, textures) shared with the main window. Every window is a pass of the main frame graph,
+// with a transient depth buffer, and all of them are presented with one vkQueuePresentKHR.
+typedef struct {
+    GLFWwindow* window;
+    VkSurfaceKHR surface;
+    SurfaceSwapchain swapchain;
+    VkSemaphore imageAvailable;
+    float viewProj[16];
+    uint32_t imageIndex;
+    int acquired;
+    int outOfDate;
+} WindowTarget;
+
+struct WindowSystem {
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet descriptorSets[MAX_WINDOWS];
+    VkBuffer uniformBuffer;
+    VkDeviceMemory uniformMemory;
+    uint8_t* uniformMapped;
+    WindowTarget targets[MAX_WINDOWS];
+};
+
+static int createWindowSystem(Engine* engine) {
+    WindowSystem* windows = (WindowSystem*)calloc(1, sizeof(WindowSystem));
+    if (!windows) {
+        fprintf(stderr, "Failed to allocate memory for window system\n");
+        return 0;
+    }
+    engine->windows = windows;
+
+    VkDeviceSize uniformSize = (VkDeviceSize)WINDOW_UNIFORM_STRIDE * MAX_WINDOWS;
+    if (createBuffer(engine, uniformSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     &windows->uniformBuffer, &windows->uniformMemory) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create window uniform buffer\n");
+        return 0;
+    }
+
+    void* data;
+    if (vkMapMemory(engine->device, windows->uniformMemory, 0, uniformSize, 0, &data) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to map window uniform buffer\n");
+        return 0;
+    }
+    windows->uniformMapped = (uint8_t*)data;
+
+    // The sets use the engine's layout so the existing pipelines bind them; only the view matrix
+    // is written, the 3D shaders never read the texture bindings.
+    VkDescriptorPoolSize poolSizes[] = {
+        { .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = MAX_WINDOWS },
+        { .type = VK_DESCRIPTOR_TYPE_SAMPLER, .descriptorCount = MAX_WINDOWS },
+        { .type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, .descriptorCount = MAX_TEXTURES * MAX_WINDOWS }
+    };
+
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .poolSizeCount = 3,
+        .pPoolSizes = poolSizes,
+        .maxSets = MAX_WINDOWS
+    };
+
+    if (vkCreateDescriptorPool(engine->device, &poolInfo, NULL, &windows->descriptorPool) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create window descriptor pool\n");
+        return 0;
+    }
+
+    VkDescriptorSetLayout layouts[MAX_WINDOWS];
+    for (uint32_t i = 0; i < MAX_WINDOWS; i++) layouts[i] = engine->descriptorSetLayout;
+    VkDescriptorSetAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = windows->descriptorPool,
+        .descriptorSetCount = MAX_WINDOWS,
+        .pSetLayouts = layouts
+    };
+
+    if (vkAllocateDescriptorSets(engine->device, &allocInfo, windows->descriptorSets) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate window descriptor sets\n");
+        return 0;
+    }
+
+    VkDescriptorBufferInfo bufferInfos[MAX_WINDOWS];
+    VkWriteDescriptorSet writes[MAX_WINDOWS];
+    for (uint32_t i = 0; i < MAX_WINDOWS; i++) {
+        bufferInfos[i] = (VkDescriptorBufferInfo){windows->uniformBuffer, (VkDeviceSize)i * WINDOW_UNIFORM_STRIDE, sizeof(float) * 16};
+        writes[i] = (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = windows->descriptorSets[i],
+            .dstBinding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorCount = 1,
+            .pBufferInfo = &bufferInfos[i]
+        };
+    }
+    vkUpdateDescriptorSets(engine->device, MAX_WINDOWS, writes, 0, NULL);
+    return 1;
+}
+
+static void destroyTargetSwapchain(Engine* engine, WindowTarget* target) {
+    if (target->swapchain.swapchain) graphInvalidate(engine);
+    destroySurfaceSwapchain(engine, &target->swapchain);
+}
+
+static int createTargetSwapchain(Engine* engine, WindowTarget* target) {
+    if (!createSurfaceSwapchain(engine, target->window, target->surface, &target->swapchain)) return 0;
+
+    // Pipelines are built once against the main window's format.
+    if (target->swapchain.format != engine->swapchainImageFormat) {
+        fprintf(stderr, "Window surface format %d differs from the main window (%d)\n",
+                target->swapchain.format, engine->swapchainImageFormat);
+        destroyTargetSwapchain(engine, target);
+        return 0;
+    }
+    target->outOfDate = 0;
+    return 1;
+}
+
+static void destroyTarget(Engine* engine, WindowTarget* target) {
+    destroyTargetSwapchain(engine, target);
+    if (target->imageAvailable) vkDestroySemaphore(engine->device, target->imageAvailable, NULL);
+    if (target->surface) vkDestroySurfaceKHR(engine->instance, target->surface, NULL);
+    if (target->window) glfwDestroyWindow(target->window);
+    memset(target, 0, sizeof(WindowTarget));
+}
+
+void destroyWindowSystem(Engine* engine) {
+    WindowSystem* windows = engine->windows;
+    if (!windows) return;
+
+    for (uint32_t i = 0; i < MAX_WINDOWS; i++) {
+        if (windows->targets[i].window) destroyTarget(engine, &windows->targets[i]);
+    }
+    if (windows->descriptorPool) vkDestroyDescriptorPool(engine->device, windows->descriptorPool, NULL);
+    if (windows->uniformMapped) vkUnmapMemory(engine->device, windows->uniformMemory);
+    if (windows->uniformMemory) vkFreeMemory(engine->device, windows->uniformMemory, NULL);
+    if (windows->uniformBuffer) vkDestroyBuffer(engine->device, windows->uniformBuffer, NULL);
+    free(windows);
+    engine->windows = NULL;
+}
+
+static WindowTarget* findTarget(Engine* engine, int32_t window) {
+    if (!engine->windows || window < 1 || window > MAX_WINDOWS) return NULL;
+    WindowTarget* target = &engine->windows->targets[window - 1];
+    return target->window ? target : NULL;
+}
+
+// Opens another window rendering the engine's scene from its own camera. Returns its id (the
+// main window is 0), or -1.
+EXPORT int32_t engine_window_create(Engine* engine, int width, int height, const char* title) {
+    if (!engine->window) {
+        fprintf(stderr, "Headless engines cannot open windows\n");
+        return -1;
+    }
+    if (!engine->windows && !createWindowSystem(engine)) {
+        destroyWindowSystem(engine);
+        return -1;
+    }
+
+    WindowSystem* windows = engine->windows;
+    int32_t slot = -1;
+    for (int32_t i = 0; i < MAX_WINDOWS && slot < 0; i++) {
+        if (!windows->targets[i].window) slot = i;
+    }
+    if (slot < 0) {
+        fprintf(stderr, "Too many windows, max is %d\n", MAX_WINDOWS);
+        return -1;
+    }
+
+    WindowTarget* target = &windows->targets[slot];
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    target->window = glfwCreateWindow(width, height, title, NULL, NULL);
+    if (!target->window) {
+        fprintf(stderr, "Failed to create GLFW window\n");
+        return -1;
+    }
+
+    VkResult result = glfwCreateWindowSurface(engine->instance, target->window, NULL, &target->surface);
+    if (result != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create window surface: %d\n", result);
+        destroyTarget(engine, target);
+        return -1;
+    }
+
+    VkBool32 supported = VK_FALSE;
+    vkGetPhysicalDeviceSurfaceSupportKHR(engine->physicalDevice, 0, target->surface, &supported);
+    if (!supported) {
+        fprintf(stderr, "Window surface cannot be presented from the graphics queue\n");
+        destroyTarget(engine, target);
+        return -1;
+    }
+
+    VkSemaphoreCreateInfo semaphoreInfo = {.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    if (vkCreateSemaphore(engine->device, &semaphoreInfo, NULL, &target->imageAvailable) != VK_SUCCESS ||
+        !createTargetSwapchain(engine, target)) {
+        fprintf(stderr, "Failed to create window render target\n");
+        destroyTarget(engine, target);
+        return -1;
+    }
+
+    // Starts out looking through the main camera.
+    memcpy(target->viewProj, engine->viewProj, sizeof(target->viewProj));
+    memcpy(windows->uniformMapped + (size_t)slot * WINDOW_UNIFORM_STRIDE, engine->viewProj, sizeof(float) * 16);
+    return slot + 1;
+}
+
+EXPORT void engine_window_destroy(Engine* engine, int32_t window) {
+    WindowTarget* target = findTarget(engine, window);
+    if (!target) return;
+    vkQueueWaitIdle(engine->graphicsQueue);
+    destroyTarget(engine, target);
+}
+
+EXPORT int engine_window_is_open(Engine* engine, int32_t window) {
+    return findTarget(engine, window) != NULL;
+}
+
+EXPORT void engine_window_set_view_matrix(Engine* engine, int32_t window, const float* matrix) {
+    WindowTarget* target = findTarget(engine, window);
+    if (!target) {
+        fprintf(stderr, "engine_window_set_view_matrix: invalid window %d\n", window);
+        return;
+    }
+    memcpy(target->viewProj, matrix, sizeof(target->viewProj));
+    memcpy(engine->windows->uniformMapped + (size_t)(window - 1) * WINDOW_UNIFORM_STRIDE, matrix, sizeof(float) * 16);
+}
+
+// Called once the main image is acquired and the queue is idle. Appends the wait semaphore,
+// swapchain and image of every window that renders this frame; closed windows are destroyed,
+// minimised and out-of-date ones sit the frame out.
+uint32_t acquireWindows(Engine* engine, VkSemaphore* waitSemaphores, VkSwapchainKHR* swapchains, uint32_t* imageIndices) {
+    WindowSystem* windows = engine->windows;
+    if (!windows) return 0;
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < MAX_WINDOWS; i++) {
+        WindowTarget* target = &windows->targets[i];
+        target->acquired = 0;
+        if (!target->window) continue;
+        if (glfwWindowShouldClose(target->window)) {
+            destroyTarget(engine, target);
+            continue;
+        }
+
+        int width, height;
+        glfwGetFramebufferSize(target->window, &width, &height);
+        if (width <= 0 || height <= 0) continue;
+
+        if (target->outOfDate || !target->swapchain.swapchain) {
+            destroyTargetSwapchain(engine, target);
+            if (!createTargetSwapchain(engine, target)) continue;
+        }
+
+        VkResult result = vkAcquireNextImageKHR(engine->device, target->swapchain.swapchain, UINT64_MAX,
+                                                target->imageAvailable, VK_NULL_HANDLE, &target->imageIndex);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            target->outOfDate = 1;
+            continue;
+        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+            fprintf(stderr, "Failed to acquire window image: %d\n", result);
+            continue;
+        }
+
+        target->acquired = 1;
+        waitSemaphores[count] = target->imageAvailable;
+        swapchains[count] = target->swapchain.swapchain;
+        imageIndices[count++] = target->imageIndex;
+    }
+    return count;
+}
+
+static void recordWindow(Engine* engine, VkCommandBuffer commandBuffer, void* userData) {
+    WindowTarget* target = (WindowTarget*)userData;
+    VkDescriptorSet descriptorSet = engine->windows->descriptorSets[target - engine->windows->targets];
+    recordVertices(engine, commandBuffer, target->swapchain.extent, descriptorSet);
+    recordMeshesView(engine, commandBuffer, target->viewProj, target->swapchain.extent, descriptorSet);
+}
+
+// Each window is a single pass declared after the main view, whose mesh scratch it reuses; there
+// is no occlusion culling or sprite overlay outside the main window. The depth buffers only live
+// for their pass, so they share memory with each other and with the main view's.
+void addWindowPasses(Engine* engine, RenderGraph* graph) {
+    WindowSystem* windows = engine->windows;
+    if (!windows) return;
+
+    VkClearValue clearColor = {.color = {{engine->clearColor[0], engine->clearColor[1], engine->clearColor[2], engine->clearColor[3]}}};
+    VkClearValue clearDepth = {.depthStencil = {1.0f, 0}};
+    for (uint32_t i = 0; i < MAX_WINDOWS; i++) {
+        WindowTarget* target = &windows->targets[i];
+        if (!target->acquired) continue;
+
+        SurfaceSwapchain* swapchain = &target->swapchain;
+        uint32_t color = graphImportImage(graph, "window", swapchain->images[target->imageIndex],
+                                          swapchain->imageViews[target->imageIndex], swapchain->format, swapchain->extent,
+                                          GRAPH_ACCESS_NONE, GRAPH_ACCESS_PRESENT);
+        uint32_t depth = graphCreateImage(graph, "window depth", engine->depthFormat, swapchain->extent);
+        uint32_t pass = graphAddPass(graph, "window", GRAPH_PASS_GRAPHICS, recordWindow, target);
+        graphClear(graph, pass, color, GRAPH_ACCESS_COLOR_ATTACHMENT, clearColor);
+        graphClear(graph, pass, depth, GRAPH_ACCESS_DEPTH_ATTACHMENT, clearDepth);
+    }
+}
+
+// `results` follows the order acquireWindows reported the swapchains in.
+void windowsPresented(Engine* engine, const VkResult* results) {
+    WindowSystem* windows = engine->windows;
+    if (!windows) return;
+
+    uint32_t index = 0;
+    for (uint32_t i = 0; i < MAX_WINDOWS; i++) {
+        WindowTarget* target = &windows->targets[i];
+        if (!target->acquired) continue;
+        VkResult result = results[index++];
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+            target->outOfDate = 1;
+        } else if (result != VK_SUCCESS) {
+            fprintf(stderr, "Failed to present window: %d\n", result);
+        }
+    }
+}
+
+// The acquired images of a frame that was never submitted; the swapchains are rebuilt next frame.
+void windowsAbandoned(Engine* engine) {
+    WindowSystem* windows = engine->windows;
+    if (!windows) return;
+
+    for (uint32_t i = 0; i < MAX_WINDOWS; i++) {
+        WindowTarget* target = &windows->targets[i];
+        if (target->acquired) target->outOfDate = 1;
+        target->acquired = 0;
+    }
+}
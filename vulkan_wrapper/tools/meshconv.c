@@ -0,0 +1,351 @@
+#include "filemap.h"
+#include "meshpack.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Offline converter from Wavefront OBJ to the DFMP mesh pack.
+//   meshconv [--lod-error E] [--layout float|half|snorm16] output.dfmp input.obj [input.obj ...]
+//   meshconv --bench pack.dfmp input.obj [input.obj ...]
+// OBJ vertices may carry a colour ("v x y z r g b"); only positions and colours are kept.
+// half and snorm16 store 12-byte quantized vertices instead of 24-byte floats.
+
+#define DEFAULT_LOD_ERROR 0.01f
+#define BENCH_RUNS 3
+
+typedef struct {
+    float x, y, z;
+    float r, g, b;
+} PackVertex;
+
+typedef struct {
+    PackVertex* vertices;
+    uint32_t vertexCount;
+    uint32_t vertexCapacity;
+    uint32_t* indices;
+    uint32_t indexCount;
+    uint32_t indexCapacity;
+} ObjMesh;
+
+static double now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int reserve(void** array, uint32_t* capacity, uint32_t needed, size_t elementSize) {
+    if (needed <= *capacity) return 1;
+    uint32_t newCapacity = *capacity ? *capacity * 2 : 4096;
+    while (newCapacity < needed) newCapacity *= 2;
+    void* p = realloc(*array, elementSize * newCapacity);
+    if (!p) return 0;
+    *array = p;
+    *capacity = newCapacity;
+    return 1;
+}
+
+static void freeObj(ObjMesh* mesh) {
+    free(mesh->vertices);
+    free(mesh->indices);
+    memset(mesh, 0, sizeof(ObjMesh));
+}
+
+static char* readText(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open file: %s\n", path);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* text = length >= 0 ? (char*)malloc((size_t)length + 1) : NULL;
+    if (!text || fread(text, 1, (size_t)length, file) != (size_t)length) {
+        fprintf(stderr, "Failed to read file: %s\n", path);
+        free(text);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    text[length] = '\0';
+    *size = (size_t)length;
+    return text;
+}
+
+static int parseObj(const char* path, ObjMesh* mesh, size_t* bytes) {
+    memset(mesh, 0, sizeof(ObjMesh));
+    size_t size;
+    char* text = readText(path, &size);
+    if (!text) return 0;
+    if (bytes) *bytes = size;
+
+    int ok = 1;
+    char* line = text;
+    while (ok && *line) {
+        char* end = line + strcspn(line, "\r\n");
+        char next = *end;
+        *end = '\0';
+
+        if (line[0] == 'v' && line[1] == ' ') {
+            ok = reserve((void**)&mesh->vertices, &mesh->vertexCapacity, mesh->vertexCount + 1, sizeof(PackVertex));
+            if (ok) {
+                PackVertex* v = &mesh->vertices[mesh->vertexCount++];
+                char* p = line + 2;
+                v->x = strtof(p, &p);
+                v->y = strtof(p, &p);
+                v->z = strtof(p, &p);
+                char* colour = p;
+                v->r = strtof(p, &p);
+                if (p == colour) {
+                    v->r = v->g = v->b = 1.0f;
+                } else {
+                    v->g = strtof(p, &p);
+                    v->b = strtof(p, &p);
+                }
+            }
+        } else if (line[0] == 'f' && line[1] == ' ') {
+            // Polygons are triangulated as a fan; only the position index of "v/vt/vn" is used.
+            uint32_t corners[3];
+            uint32_t cornerCount = 0;
+            char* p = line + 2;
+            for (;;) {
+                char* start = p;
+                long index = strtol(p, &p, 10);
+                if (p == start) break;
+                while (*p && *p != ' ' && *p != '\t') p++;
+                index = index < 0 ? (long)mesh->vertexCount + index : index - 1;
+                if (index < 0 || index >= (long)mesh->vertexCount) {
+                    fprintf(stderr, "Invalid face index in %s\n", path);
+                    ok = 0;
+                    break;
+                }
+                if (cornerCount < 2) {
+                    corners[cornerCount++] = (uint32_t)index;
+                    continue;
+                }
+                corners[2] = (uint32_t)index;
+                if (!reserve((void**)&mesh->indices, &mesh->indexCapacity, mesh->indexCount + 3, sizeof(uint32_t))) {
+                    ok = 0;
+                    break;
+                }
+                memcpy(mesh->indices + mesh->indexCount, corners, sizeof(corners));
+                mesh->indexCount += 3;
+                corners[1] = corners[2];
+            }
+        }
+
+        line = next ? end + 1 : end;
+    }
+
+    free(text);
+    if (ok && (mesh->vertexCount == 0 || mesh->indexCount == 0)) {
+        fprintf(stderr, "No geometry in %s\n", path);
+        ok = 0;
+    }
+    if (!ok) freeObj(mesh);
+    return ok;
+}
+
+static int writeSection(FILE* file, const void* data, uint64_t size, uint64_t* offset, MeshPackSection* section) {
+    static const uint8_t padding[MESH_PACK_ALIGNMENT] = {0};
+    uint64_t aligned = (*offset + MESH_PACK_ALIGNMENT - 1) & ~(uint64_t)(MESH_PACK_ALIGNMENT - 1);
+    if (aligned != *offset && fwrite(padding, 1, (size_t)(aligned - *offset), file) != aligned - *offset) return 0;
+    if (fwrite(data, 1, (size_t)size, file) != size) return 0;
+    section->offset = aligned;
+    section->size = size;
+    *offset = aligned + size;
+    return 1;
+}
+
+static const char* const layoutNames[MESH_LAYOUT_COUNT] = {"float", "half", "snorm16"};
+
+static int convert(const char* output, char** inputs, int inputCount, float lodError, uint32_t layout) {
+    FILE* file = fopen(output, "wb");
+    MeshPackEntry* entries = (MeshPackEntry*)calloc((size_t)inputCount, sizeof(MeshPackEntry));
+    if (!file || !entries) {
+        fprintf(stderr, "Failed to create %s\n", output);
+        if (file) fclose(file);
+        free(entries);
+        return 0;
+    }
+
+    MeshPackHeader header = {{'D', 'F', 'M', 'P'}, MESH_PACK_VERSION, (uint32_t)inputCount, 0};
+    uint64_t offset = sizeof(header) + sizeof(MeshPackEntry) * (uint64_t)inputCount;
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(entries, sizeof(MeshPackEntry), (size_t)inputCount, file) == (size_t)inputCount;
+
+    for (int i = 0; ok && i < inputCount; i++) {
+        ObjMesh mesh;
+        if (!parseObj(inputs[i], &mesh, NULL)) {
+            ok = 0;
+            break;
+        }
+
+        float bounds[4];
+        computeMeshBounds(bounds, &mesh.vertices[0].x, mesh.vertexCount, sizeof(PackVertex));
+        uint32_t capacity = mesh.indexCount * 3;
+        uint32_t* chain = (uint32_t*)malloc(sizeof(uint32_t) * capacity);
+        MeshLod lods[MESH_MAX_LODS];
+        uint32_t lodCount = chain ? buildLodChain(chain, capacity, lods, mesh.indices, mesh.indexCount,
+                                                  &mesh.vertices[0].x, mesh.vertexCount, sizeof(PackVertex),
+                                                  lodError * bounds[3]) : 0;
+        if (lodCount == 0) {
+            fprintf(stderr, "Failed to build LOD chain for %s\n", inputs[i]);
+            free(chain);
+            freeObj(&mesh);
+            ok = 0;
+            break;
+        }
+
+        // Encoded in place: no layout is larger than PackVertex.
+        VertexDequantize dequantize;
+        encodeVertices(mesh.vertices, layout, &mesh.vertices[0].x, mesh.vertexCount, sizeof(PackVertex), &dequantize);
+
+        MeshPackEntry* entry = &entries[i];
+        entry->vertexLayout = layout;
+        entry->vertexCount = mesh.vertexCount;
+        entry->indexCount = lods[lodCount - 1].firstIndex + lods[lodCount - 1].indexCount;
+        entry->lodCount = lodCount;
+        ok = writeSection(file, mesh.vertices, (uint64_t)vertexLayoutStride(layout) * mesh.vertexCount, &offset,
+                          &entry->sections[MESH_SECTION_VERTICES]) &&
+             writeSection(file, chain, sizeof(uint32_t) * (uint64_t)entry->indexCount, &offset,
+                          &entry->sections[MESH_SECTION_INDICES]) &&
+             writeSection(file, bounds, sizeof(bounds), &offset, &entry->sections[MESH_SECTION_BOUNDS]) &&
+             writeSection(file, lods, sizeof(MeshLod) * lodCount, &offset, &entry->sections[MESH_SECTION_LODS]) &&
+             writeSection(file, &dequantize, sizeof(dequantize), &offset, &entry->sections[MESH_SECTION_DEQUANTIZE]);
+
+        printf("%s: %u vertices, %u triangles, %u LODs (coarsest %u triangles, error %g)\n", inputs[i],
+               mesh.vertexCount, mesh.indexCount / 3, lodCount, lods[lodCount - 1].indexCount / 3,
+               lods[lodCount - 1].error);
+        free(chain);
+        freeObj(&mesh);
+    }
+
+    if (ok) {
+        ok = fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(entries, sizeof(MeshPackEntry), (size_t)inputCount, file) == (size_t)inputCount;
+    }
+    if (fclose(file) != 0) ok = 0;
+    free(entries);
+    if (!ok) {
+        fprintf(stderr, "Failed to write %s\n", output);
+        remove(output);
+    }
+    return ok;
+}
+
+// Mirrors engine_mesh_pack_open on the CPU side: map the pack and copy every vertex and index
+// section into a staging-sized buffer.
+static int loadPack(const char* path, uint8_t* staging, size_t stagingSize, uint64_t* bytes) {
+    MappedFile file;
+    if (!mapFile(path, &file)) return 0;
+
+    const MeshPackHeader* header = (const MeshPackHeader*)file.data;
+    if (file.size < sizeof(MeshPackHeader) || memcmp(header->magic, "DFMP", 4) != 0 ||
+        header->version != MESH_PACK_VERSION ||
+        header->meshCount > (file.size - sizeof(MeshPackHeader)) / sizeof(MeshPackEntry)) {
+        fprintf(stderr, "Invalid mesh pack: %s\n", path);
+        unmapFile(&file);
+        return 0;
+    }
+
+    const MeshPackEntry* entries = (const MeshPackEntry*)(file.data + sizeof(MeshPackHeader));
+    *bytes = 0;
+    for (uint32_t i = 0; i < header->meshCount; i++) {
+        for (int s = MESH_SECTION_VERTICES; s <= MESH_SECTION_INDICES; s++) {
+            const MeshPackSection* section = &entries[i].sections[s];
+            if (section->offset > file.size || section->size > file.size - section->offset) {
+                fprintf(stderr, "Invalid section in mesh pack: %s\n", path);
+                unmapFile(&file);
+                return 0;
+            }
+            for (uint64_t done = 0; done < section->size; done += stagingSize) {
+                uint64_t chunk = section->size - done < stagingSize ? section->size - done : stagingSize;
+                memcpy(staging, file.data + section->offset + done, (size_t)chunk);
+            }
+            *bytes += section->size;
+        }
+    }
+
+    unmapFile(&file);
+    return 1;
+}
+
+static int bench(const char* pack, char** inputs, int inputCount) {
+    size_t stagingSize = 16u * 1024 * 1024;
+    uint8_t* staging = (uint8_t*)malloc(stagingSize);
+    if (!staging) return 0;
+
+    double textBest = 0.0, packBest = 0.0;
+    uint64_t textBytes = 0, packBytes = 0;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        double start = now();
+        textBytes = 0;
+        for (int i = 0; i < inputCount; i++) {
+            ObjMesh mesh;
+            size_t size;
+            if (!parseObj(inputs[i], &mesh, &size)) {
+                free(staging);
+                return 0;
+            }
+            textBytes += size;
+            freeObj(&mesh);
+        }
+        double text = now() - start;
+
+        start = now();
+        if (!loadPack(pack, staging, stagingSize, &packBytes)) {
+            free(staging);
+            return 0;
+        }
+        double binary = now() - start;
+
+        if (run == 0 || text < textBest) textBest = text;
+        if (run == 0 || binary < packBest) packBest = binary;
+    }
+    free(staging);
+
+    printf("OBJ text:  %8.2f ms  %8.1f MB  %8.1f MB/s (excludes LOD generation)\n",
+           textBest * 1000.0, textBytes / 1048576.0, textBytes / 1048576.0 / textBest);
+    printf("DFMP pack: %8.2f ms  %8.1f MB  %8.1f MB/s\n",
+           packBest * 1000.0, packBytes / 1048576.0, packBytes / 1048576.0 / packBest);
+    printf("Speedup:   %8.1fx\n", textBest / packBest);
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    float lodError = DEFAULT_LOD_ERROR;
+    uint32_t layout = MESH_LAYOUT_POSITION_COLOR;
+    int benchMode = 0;
+    int arg = 1;
+    while (arg < argc && strncmp(argv[arg], "--", 2) == 0) {
+        if (strcmp(argv[arg], "--bench") == 0) {
+            benchMode = 1;
+            arg++;
+        } else if (strcmp(argv[arg], "--lod-error") == 0 && arg + 1 < argc) {
+            lodError = strtof(argv[arg + 1], NULL);
+            arg += 2;
+        } else if (strcmp(argv[arg], "--layout") == 0 && arg + 1 < argc) {
+            for (layout = 0; layout < MESH_LAYOUT_COUNT && strcmp(argv[arg + 1], layoutNames[layout]) != 0; layout++) {}
+            if (layout == MESH_LAYOUT_COUNT) {
+                fprintf(stderr, "Unknown vertex layout: %s\n", argv[arg + 1]);
+                return 1;
+            }
+            arg += 2;
+        } else {
+            break;
+        }
+    }
+
+    if (argc - arg < 2) {
+        fprintf(stderr, "Usage: %s [--lod-error E] [--layout float|half|snorm16] output.dfmp input.obj [input.obj ...]\n",
+                argv[0]);
+        fprintf(stderr, "       %s --bench pack.dfmp input.obj [input.obj ...]\n", argv[0]);
+        return 1;
+    }
+
+    int ok = benchMode ? bench(argv[arg], argv + arg + 1, argc - arg - 1)
+                       : convert(argv[arg], argv + arg + 1, argc - arg - 1, lodError, layout);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+#include "capture.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Replays a DFCP capture against a headless engine as fast as the GPU allows and reports
+// per-frame timings.
+//   replay [--csv frames.csv] capture.dfcp
+
+// Declared here rather than through engine.h, which exports it instead of importing it.
+int64_t engine_replay(const char* path, ReplayFrameCallback callback, void* userData);
+
+typedef struct {
+    uint64_t* cpu;
+    uint64_t* total;
+    uint32_t count;
+    uint32_t capacity;
+    FILE* csv;
+} FrameTimes;
+
+static void onFrame(uint32_t frame, uint64_t cpuNanoseconds, uint64_t totalNanoseconds, void* userData) {
+    FrameTimes* times = (FrameTimes*)userData;
+    if (times->csv) {
+        fprintf(times->csv, "%u,%.3f,%.3f\n", frame, cpuNanoseconds * 1e-6, totalNanoseconds * 1e-6);
+    }
+
+    if (times->count == times->capacity) {
+        uint32_t capacity = times->capacity ? times->capacity * 2 : 1024;
+        uint64_t* cpu = (uint64_t*)realloc(times->cpu, sizeof(uint64_t) * capacity);
+        if (!cpu) return;
+        times->cpu = cpu;
+        uint64_t* total = (uint64_t*)realloc(times->total, sizeof(uint64_t) * capacity);
+        if (!total) return;
+        times->total = total;
+        times->capacity = capacity;
+    }
+    times->cpu[times->count] = cpuNanoseconds;
+    times->total[times->count] = totalNanoseconds;
+    times->count++;
+}
+
+static int compareTimes(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void report(const char* label, uint64_t* values, uint32_t count) {
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < count; i++) sum += values[i];
+    qsort(values, count, sizeof(uint64_t), compareTimes);
+#define PERCENTILE(p) (values[(uint32_t)((count - 1) * (p) / 100)] * 1e-6)
+    printf("%-6s min %8.3f  avg %8.3f  p50 %8.3f  p95 %8.3f  p99 %8.3f  max %8.3f ms\n", label,
+           values[0] * 1e-6, (double)sum / count * 1e-6, PERCENTILE(50), PERCENTILE(95), PERCENTILE(99),
+           values[count - 1] * 1e-6);
+#undef PERCENTILE
+}
+
+int main(int argc, char** argv) {
+    const char* csvPath = NULL;
+    int arg = 1;
+    if (arg + 1 < argc && strcmp(argv[arg], "--csv") == 0) {
+        csvPath = argv[arg + 1];
+        arg += 2;
+    }
+    if (argc - arg != 1) {
+        fprintf(stderr, "Usage: %s [--csv frames.csv] capture.dfcp\n", argv[0]);
+        return 1;
+    }
+
+    FrameTimes times = {0};
+    if (csvPath) {
+        times.csv = fopen(csvPath, "w");
+        if (!times.csv) {
+            fprintf(stderr, "Failed to open %s\n", csvPath);
+            return 1;
+        }
+        fprintf(times.csv, "frame,cpu_ms,total_ms\n");
+    }
+
+    int64_t frames = engine_replay(argv[arg], onFrame, &times);
+    if (times.csv) fclose(times.csv);
+    if (frames < 0) {
+        fprintf(stderr, "Replay failed\n");
+        free(times.cpu);
+        free(times.total);
+        return 1;
+    }
+
+    printf("%lld frames\n", (long long)frames);
+    if (times.count > 0) {
+        report("cpu", times.cpu, times.count);
+        report("total", times.total, times.count);
+    }
+    free(times.cpu);
+    free(times.total);
+    return 0;
+}